@@ -1,4 +1,4 @@
-QT += core qml quick
+QT += core qml quick concurrent
 
 # Убираем widgets, если не используем QWidget
 # QT += widgets  # ← убираем, если не нужен
@@ -11,18 +11,43 @@ TEMPLATE = app
 # Исходные файлы
 SOURCES += \
     src/main.cpp \
-    src/controller/BankController.cpp
+    src/controller/BankController.cpp \
+    src/controller/VariantListModel.cpp
 
 # Заголовочные файлы
 HEADERS += \
     src/controller/BankController.h \
+    src/controller/VariantListModel.h \
+    src/controller/VariantSchema.h \
     src/models/Account.h \
     src/models/Card.h \
     src/models/FavoritePayment.h \
     src/models/Payment.h \
+    src/models/ScheduledPayment.h \
+    src/models/Schema.h \
     src/models/Transaction.h \
     src/models/User.h \
+    src/storage/AnalyticsStore.h \
+    src/storage/BalanceTable.h \
+    src/storage/BulkImporter.h \
+    src/storage/HistoryArchive.h \
+    src/storage/HistoryIndex.h \
+    src/storage/IdAllocator.h \
+    src/storage/IdempotencyStore.h \
+    src/storage/MappedFile.h \
+    src/storage/NotificationStore.h \
+    src/storage/PostingLedger.h \
+    src/storage/RatesTable.h \
+    src/storage/Reconciler.h \
+    src/storage/ScheduleStore.h \
+    src/storage/TransferQuery.h \
+    src/storage/TransferSearch.h \
+    src/storage/UserRepository.h \
     src/storage/UserStorage.h \
+    src/storage/UsernameIndex.h \
+    src/storage/UserScan.h \
+    src/storage/VelocityRules.h \
+    src/utils/BloomFilter.h \
     src/utils/Exceptions.h \
     src/utils/Utils.h
 
@@ -55,6 +55,13 @@ Window {  // можно оставить Window — без padding в корне
             property var receiptData: ({})
             property string cancelTxId: ""
             property string adminCancelTxId: ""
+            property bool historyFiltered: false
+            property string historyCursor: ""
+            property int adminSearchGeneration: 0
+            property int bulkMatched: 0
+            // ключ идемпотентности заполненной формы: повторное нажатие не переводит деньги дважды
+            property string transferKey: ""
+            property string depositKey: ""
             width: stack.width
             height: stack.height
             
@@ -63,6 +70,8 @@ Window {  // можно оставить Window — без padding в корне
             ListModel { id: recipientCardsModel }
             ListModel { id: recipientAccountsModel }
             ListModel { id: expenseListModel }
+            ListModel { id: historyPageModel }
+            ListModel { id: adminTransfersModel }
             
             // Functions
             function accRefresh() {
@@ -70,8 +79,8 @@ Window {  // можно оставить Window — без padding в корне
                 const a = bank.listAccounts()
                 for (let i=0;i<a.length;i++) accModel.append({ text: a[i].accountNumber + " (" + a[i].currency + ")", value: a[i].accountNumber })
             }
-            function favRefresh() {
-                if (typeof favoritesList !== 'undefined') favoritesList.model = bank.listFavorites()
+            function requestKey() {
+                return Date.now().toString(36) + "-" + Math.floor(Math.random() * 0x7fffffff).toString(36)
             }
             function checkCardExpiry(expiry) {
                 // Функция использует исключения внутри C++ кода
@@ -118,6 +127,71 @@ Window {  // можно оставить Window — без padding в корне
                     transferStatus.text = "Чек недоступен"
                 }
             }
+            // Данные вкладки запрашиваются при ее показе; контроллер отдает кэш, если вид уже подгружен в простое
+            function loadView(index) {
+                if (index === 4 && !bank.admin) updateExpenseChart()
+                else if (index === 6 && bank.admin) searchAdminTransfers()
+                else if (index === 7 && bank.admin) adminUsersList.model = bank.viewData("adminUsers", adminUsersSortValue())
+            }
+            // Отфильтрованная история постранично; без фильтров список показывает bank.historyModel
+            function queryHistory(reset) {
+                if (reset) {
+                    historyPageModel.clear()
+                    historyCursor = ""
+                }
+                const filter = { order: historyOrder.currentIndex === 1 ? "oldest" : "newest", cursor: historyCursor, limit: 50 }
+                const days = [0, 1, 7, 30, 365][historyPeriod.currentIndex]
+                if (days > 0) filter.fromTs = Math.floor(Date.now() / 1000) - days * 86400
+                if (historyCategory.currentIndex > 0) filter.category = historyCategory.model.get(historyCategory.currentIndex).value
+                if (historyStatus.currentIndex > 0) filter.status = historyStatus.currentIndex === 1 ? "completed" : "cancelled"
+                if (historyCounterparty.text.length) filter.counterparty = historyCounterparty.text
+                if (historyMinAmount.text.length) filter.minCents = Math.round(parseFloat(historyMinAmount.text) * 100)
+                if (historyMaxAmount.text.length) filter.maxCents = Math.round(parseFloat(historyMaxAmount.text) * 100)
+                historyFiltered = days > 0 || historyCategory.currentIndex > 0 || historyStatus.currentIndex > 0 || historyOrder.currentIndex > 0
+                        || historyCounterparty.text.length > 0 || historyMinAmount.text.length > 0 || historyMaxAmount.text.length > 0
+                if (!historyFiltered) return
+                const page = bank.queryHistory(filter)
+                for (let i = 0; i < page.items.length; i++) historyPageModel.append(page.items[i])
+                historyCursor = page.nextCursor
+            }
+            // Строки поиска приходят порциями через onTransferSearchRows; чужие поколения отбрасываются
+            function searchAdminTransfers() {
+                adminTransfersModel.clear()
+                adminSearchGeneration = bank.searchTransfers(adminSearchField.text)
+            }
+            function runAdminQuery() {
+                const result = bank.queryTransfers(adminQueryField.text, adminQueryOrder.currentText, 200)
+                if (result.items === undefined) { adminQueryResult.text = ""; return }
+                adminSearchGeneration = 0  // запоздавшие порции поиска не смешиваются с результатом запроса
+                adminTransfersModel.clear()
+                for (let i = 0; i < result.items.length; i++) adminTransfersModel.append(result.items[i])
+                adminQueryResult.text = "Найдено: " + result.count + ", сумма: " + (result.sumCents / 100).toFixed(2)
+            }
+            // Даты — сутки UTC, правая граница включительно
+            function bulkCancelFilter() {
+                const filter = {}
+                if (bulkToCard.text.length) filter.toCard = bulkToCard.text
+                if (bulkFromAccount.text.length) filter.fromAccount = bulkFromAccount.text
+                if (bulkIds.text.trim().length) filter.ids = bulkIds.text.split(",").map(s => s.trim()).filter(s => s.length)
+                if (bulkFromDate.text.length) filter.fromTs = Math.floor(Date.parse(bulkFromDate.text + "T00:00:00Z") / 1000)
+                if (bulkToDate.text.length) filter.toTs = Math.floor(Date.parse(bulkToDate.text + "T00:00:00Z") / 1000) + 86400
+                return filter
+            }
+            function previewBulkCancel() {
+                const result = bank.cancelTransfers(bulkCancelFilter(), "", true)
+                bulkMatched = result.matched || 0
+                if (result.items === undefined) { bulkCancelResult.text = ""; return }
+                adminSearchGeneration = 0
+                adminTransfersModel.clear()
+                for (let i = 0; i < result.items.length; i++) adminTransfersModel.append(result.items[i])
+                bulkCancelResult.text = "К отмене: " + result.matched + " на " + (result.matchedCents / 100).toFixed(2) + ", пользователей: " + result.users
+            }
+            function adminUsersSortValue() {
+                if (adminUsersSort.currentText === "По количеству счетов") return "accounts"
+                if (adminUsersSort.currentText === "По количеству карт") return "cards"
+                if (adminUsersSort.currentText === "По количеству транзакций") return "transactions"
+                return ""
+            }
             function downloadReceipt() {
                 if (!receiptData || !receiptData.id) return
                 receiptFileDialog.open()
@@ -128,7 +202,7 @@ Window {  // можно оставить Window — без padding в корне
                 }
                 
                 expenseListModel.clear()
-                const stats = bank.getExpenseStats()
+                const stats = bank.viewData("expenseStats")
                 if (!stats) {
                     if (typeof expenseChart !== 'undefined') {
                         expenseChart.requestPaint()
@@ -298,20 +372,14 @@ Window {  // можно оставить Window — без padding в корне
                                 Layout.preferredHeight: 50; 
                                 font.pixelSize: 15; 
                                 text: "Платежи"; 
-                                onClicked: {
-                                    contentView.currentIndex = 6
-                                    if (typeof adminTransfersList !== 'undefined') adminTransfersList.model = bank.listAllTransfers("")
-                                } 
+                                onClicked: contentView.currentIndex = 6
                             }
                             Button { 
                                 Layout.fillWidth: true; 
                                 Layout.preferredHeight: 50; 
                                 font.pixelSize: 15; 
                                 text: "Пользователи"; 
-                                onClicked: {
-                                    contentView.currentIndex = 7
-                                    if (typeof adminUsersList !== 'undefined') adminUsersList.model = bank.getAllUsersInfo(adminUsersSort.currentText)
-                                } 
+                                onClicked: contentView.currentIndex = 7
                             }
                         }
                         Item { Layout.fillHeight: true }
@@ -338,11 +406,7 @@ Window {  // можно оставить Window — без padding в корне
                     id: contentView
                     Layout.fillWidth: true
                     Layout.fillHeight: true
-                    onCurrentIndexChanged: {
-                        if (currentIndex === 4 && !bank.admin && typeof updateExpenseChart !== 'undefined') {
-                            updateExpenseChart()
-                        }
-                    }
+                    onCurrentIndexChanged: loadView(currentIndex)
 
                     // Все страницы — просто Item с Layout, без padding
 
@@ -356,7 +420,7 @@ Window {  // можно оставить Window — без padding в корне
                             RowLayout {
                                 spacing: 8
                                 Button { text: "Добавить счет (RUB)"; onClicked: bank.addAccount("RUB") }
-                                Button { text: "Обновить"; onClicked: accountsList.model = bank.listAccounts() }
+                                Button { text: "Обновить"; onClicked: bank.refreshCollections() }
                                 Button { text: "Пополнить счет"; onClicked: {
                                         accRefresh()
                                         if (accModel.count === 0) { accStatus.text = "Сначала создайте счет"; return }
@@ -370,7 +434,7 @@ Window {  // можно оставить Window — без padding в корне
                                 Layout.fillHeight: true
                                 Layout.fillWidth: true
                                 id: accountsList
-                                model: bank.listAccounts()
+                                model: bank.accountsModel
                                 spacing: 8
                                 delegate: Frame {
                                     width: ListView.view.width
@@ -380,9 +444,9 @@ Window {  // можно оставить Window — без padding в корне
                                         spacing: 4
                                         RowLayout {
                                             spacing: 12
-                                            Label { text: "Счет: " + modelData.accountNumber; font.bold: true }
-                                            Label { text: "Валюта: " + modelData.currency }
-                                            Label { text: "Баланс: " + (modelData.balanceCents/100).toFixed(2) }
+                                            Label { text: "Счет: " + model.accountNumber; font.bold: true }
+                                            Label { text: "Валюта: " + model.currency }
+                                            Label { text: "Баланс: " + (model.balanceCents/100).toFixed(2) }
                                         }
                                     }
                                 }
@@ -421,8 +485,6 @@ Window {  // можно оставить Window — без padding в корне
                                         if (!cardHolder.text || cardHolder.text.length < 2) { addCardStatus.text = "Имя владельца слишком короткое"; return }
                                         if (!/^\d{2}\/\d{2}$/.test(cardExpiry.text)) { addCardStatus.text = "Срок в формате ММ/ГГ"; return }
                                         bank.addCard(cardHolder.text, cardExpiry.text, accNum)
-                                        // мгновенно обновим списки
-                                        cardsList.model = bank.listCards()
                                         accRefresh()
                                     }
                                 }
@@ -432,11 +494,11 @@ Window {  // можно оставить Window — без padding в корне
                                 Layout.fillHeight: true
                                 Layout.fillWidth: true
                                 id: cardsList
-                                model: bank.listCards()
+                                model: bank.cardsModel
                                 spacing: 8
                                 delegate: Frame {
                                     width: ListView.view.width
-                                    property bool expired: checkCardExpiry(modelData.expiry)
+                                    property bool expired: checkCardExpiry(model.expiry)
                                     ColumnLayout {
                                         anchors.fill: parent
                                         anchors.margins: 8
@@ -444,7 +506,7 @@ Window {  // можно оставить Window — без padding в корне
                                         RowLayout {
                                             Layout.fillWidth: true
                                             Label { 
-                                                text: "Карта: " + modelData.cardNumber; 
+                                                text: "Карта: " + model.cardNumber; 
                                                 font.bold: true
                                                 Layout.fillWidth: true
                                             }
@@ -455,12 +517,12 @@ Window {  // можно оставить Window — без padding в корне
                                                 font.pixelSize: 11
                                             }
                                         }
-                                        Label { text: "Владелец: " + modelData.holderName }
+                                        Label { text: "Владелец: " + model.holderName }
                                         Label { 
-                                            text: "Срок: " + modelData.expiry
+                                            text: "Срок: " + model.expiry
                                             color: expired ? "#d32f2f" : "#666"
                                         }
-                                        Label { text: "Счет: " + modelData.linkedAccount }
+                                        Label { text: "Счет: " + model.linkedAccount }
                                     }
                                 }
                             }
@@ -486,6 +548,7 @@ Window {  // можно оставить Window — без padding в корне
                                         Label { text: "Счет отправителя:"; Layout.preferredWidth: 140 }
                                         ComboBox { 
                                             id: fromAcc
+                                            onActivated: transferKey = ""
                                             Layout.fillWidth: true
                                             Layout.minimumWidth: 300
                                             textRole: "text"
@@ -497,7 +560,7 @@ Window {  // можно оставить Window — без padding в корне
                                     RowLayout {
                                         spacing: 6
                                         Label { text: "Имя получателя:"; Layout.preferredWidth: 140 }
-                                        TextField { id: recipient; Layout.fillWidth: true; placeholderText: "Имя получателя"; onTextChanged: { refreshRecipientCards(); refreshRecipientAccounts(); } }
+                                        TextField { id: recipient; Layout.fillWidth: true; placeholderText: "Имя получателя"; onTextChanged: { transferKey = ""; refreshRecipientCards(); refreshRecipientAccounts(); } }
                                         Button { text: "Найти"; onClicked: { refreshRecipientCards(); refreshRecipientAccounts(); } }
                                     }
                                     RowLayout {
@@ -505,6 +568,7 @@ Window {  // можно оставить Window — без padding в корне
                                         Label { text: "Карта получателя:"; Layout.preferredWidth: 140 }
                                         ComboBox { 
                                             id: recipientCards
+                                            onCurrentIndexChanged: transferKey = ""
                                             Layout.fillWidth: true
                                             Layout.minimumWidth: 300
                                             textRole: "text"
@@ -518,6 +582,7 @@ Window {  // можно оставить Window — без padding в корне
                                         Label { text: "Счет получателя:"; Layout.preferredWidth: 140 }
                                         ComboBox { 
                                             id: recipientAccounts
+                                            onCurrentIndexChanged: transferKey = ""
                                             Layout.fillWidth: true
                                             Layout.minimumWidth: 300
                                             textRole: "text"
@@ -529,13 +594,14 @@ Window {  // можно оставить Window — без padding в корне
                                     RowLayout {
                                         spacing: 6
                                         Label { text: "Сумма:"; Layout.preferredWidth: 140 }
-                                        SpinBox { id: amount; Layout.fillWidth: true; from: 1; to: 100000000; value: 1000; editable: true }
+                                        SpinBox { id: amount; Layout.fillWidth: true; from: 1; to: 100000000; value: 1000; editable: true; onValueModified: transferKey = "" }
                                     }
                                     RowLayout {
                                         spacing: 6
                                         Label { text: "Категория:"; Layout.preferredWidth: 140 }
                                         ComboBox {
                                             id: categoryCombo
+                                            onActivated: transferKey = ""
                                             Layout.fillWidth: true
                                             model: ListModel {
                                                 ListElement { text: "Остальное"; value: "other" }
@@ -550,7 +616,7 @@ Window {  // можно оставить Window — без padding в корне
                                     RowLayout {
                                         spacing: 6
                                         Label { text: "Примечание:"; Layout.preferredWidth: 140 }
-                                        TextField { id: note; Layout.fillWidth: true; placeholderText: "Примечание" }
+                                        TextField { id: note; Layout.fillWidth: true; placeholderText: "Примечание"; onTextEdited: transferKey = "" }
                                     }
                                     Button {
                                         text: "Отправить"
@@ -566,12 +632,64 @@ Window {  // можно оставить Window — без padding в корне
                                             if (accModel.count === 0 || fromAcc.currentIndex < 0) { transferStatus.text = "Создайте и выберите свой счет"; return }
                                             const myAcc = accModel.get(fromAcc.currentIndex).value
                                             const cat = categoryCombo.currentIndex >= 0 ? categoryCombo.model.get(categoryCombo.currentIndex).value : "other"
-                                            bank.transfer(myAcc, target, amount.value*100, note.text, cat)
+                                            if (!transferKey) transferKey = requestKey()
+                                            // перевод проведен — следующее нажатие с той же формой будет новым переводом;
+                                            // после ошибки ключ остается, и повтор не проведет деньги дважды
+                                            if (bank.transfer(myAcc, target, amount.value*100, note.text, cat, transferKey)) transferKey = ""
                                         }
                                     }
                                 }
                             }
                             Label { id: transferStatus; text: ""; color: "#666" }
+                            // History filters
+                            RowLayout {
+                                spacing: 6
+                                Layout.fillWidth: true
+                                ComboBox {
+                                    id: historyPeriod
+                                    model: ["За все время", "Сегодня", "Неделя", "Месяц", "Год"]
+                                    onActivated: queryHistory(true)
+                                }
+                                ComboBox {
+                                    id: historyCategory
+                                    textRole: "text"
+                                    model: ListModel {
+                                        ListElement { text: "Все категории"; value: "" }
+                                        ListElement { text: "Остальное"; value: "other" }
+                                        ListElement { text: "Медицина и здравоохранение"; value: "medicine" }
+                                        ListElement { text: "Спорт"; value: "sport" }
+                                        ListElement { text: "Продукты"; value: "food" }
+                                        ListElement { text: "Развлечения"; value: "entertainment" }
+                                    }
+                                    onActivated: queryHistory(true)
+                                }
+                                ComboBox {
+                                    id: historyStatus
+                                    model: ["Все статусы", "Выполнен", "Отменен"]
+                                    onActivated: queryHistory(true)
+                                }
+                                TextField { id: historyCounterparty; placeholderText: "Карта/счет"; Layout.preferredWidth: 180; onEditingFinished: queryHistory(true) }
+                                TextField { id: historyMinAmount; placeholderText: "Сумма от"; Layout.preferredWidth: 90; onEditingFinished: queryHistory(true) }
+                                TextField { id: historyMaxAmount; placeholderText: "до"; Layout.preferredWidth: 90; onEditingFinished: queryHistory(true) }
+                                ComboBox {
+                                    id: historyOrder
+                                    model: ["Сначала новые", "Сначала старые"]
+                                    onActivated: queryHistory(true)
+                                }
+                                Button {
+                                    text: "Сбросить"
+                                    onClicked: {
+                                        historyPeriod.currentIndex = 0
+                                        historyCategory.currentIndex = 0
+                                        historyStatus.currentIndex = 0
+                                        historyOrder.currentIndex = 0
+                                        historyCounterparty.text = ""
+                                        historyMinAmount.text = ""
+                                        historyMaxAmount.text = ""
+                                        queryHistory(true)
+                                    }
+                                }
+                            }
                             // History header
                             RowLayout {
                                 spacing: 12
@@ -589,22 +707,28 @@ Window {  // можно оставить Window — без padding в корне
                                 id: historyList
                                 Layout.fillWidth: true
                                 Layout.fillHeight: true
-                                model: bank.listHistory()
+                                model: historyFiltered ? historyPageModel : bank.historyModel
+                                footer: Button {
+                                    visible: historyFiltered && historyCursor.length > 0
+                                    height: visible ? implicitHeight : 0
+                                    text: "Показать еще"
+                                    onClicked: queryHistory(false)
+                                }
                                 delegate: RowLayout {
                                     width: ListView.view.width
                                     spacing: 12
                                     // columns aligned with header widths
-                                    Label { text: modelData.fromAccount; Layout.preferredWidth: 220 }
-                                    Label { text: modelData.toCard; Layout.preferredWidth: 280 }
-                                    Label { text: (modelData.cents/100).toFixed(2); Layout.preferredWidth: 120 }
-                                    Text { text: new Date(modelData.timestamp*1000).toLocaleString(); Layout.preferredWidth: 360; elide: Text.ElideRight; wrapMode: Text.WordWrap; maximumLineCount: 2 }
+                                    Label { text: model.fromAccount; Layout.preferredWidth: 220 }
+                                    Label { text: model.toCard; Layout.preferredWidth: 280 }
+                                    Label { text: (model.cents/100).toFixed(2); Layout.preferredWidth: 120 }
+                                    Text { text: new Date(model.timestamp*1000).toLocaleString(); Layout.preferredWidth: 360; elide: Text.ElideRight; wrapMode: Text.WordWrap; maximumLineCount: 2 }
                                     Label {
-                                        text: modelData.status === "cancelled" ? "Отменен" : "Выполнен"
+                                        text: model.status === "cancelled" ? "Отменен" : "Выполнен"
                                         Layout.preferredWidth: 120
-                                        color: modelData.status === "cancelled" ? "tomato" : "#18a558"
+                                        color: model.status === "cancelled" ? "tomato" : "#18a558"
                                     }
                                     Text {
-                                        text: modelData.status === "cancelled" && modelData.cancelReason.length ? modelData.note + " (" + modelData.cancelReason + ")" : modelData.note
+                                        text: model.status === "cancelled" && model.cancelReason.length ? model.note + " (" + model.cancelReason + ")" : model.note
                                         Layout.fillWidth: true
                                         elide: Text.ElideRight
                                         wrapMode: Text.WordWrap
@@ -613,7 +737,7 @@ Window {  // можно оставить Window — без padding в корне
                                     Button {
                                         text: "Чек"
                                         Layout.preferredWidth: 80
-                                        onClicked: showReceipt(modelData.id)
+                                        onClicked: showReceipt(model.id)
                                     }
                                 }
                             }
@@ -647,14 +771,13 @@ Window {  // можно оставить Window — без padding в корне
                                         if (recipientCardsModel.count === 0) { addCardStatus.text = "Укажите получателя и выберите карту"; return }
                                         const toCardNum = recipientCardsModel.get(favCard.currentIndex).value
                                         bank.addFavorite(favName.text, toCardNum, favNote.text)
-                                        favRefresh()
                                     } }
                             }
                             ListView {
                                 id: favoritesList
                                 Layout.fillHeight: true
                                 Layout.fillWidth: true
-                                model: bank.listFavorites()
+                                model: bank.favoritesModel
                                 delegate: Frame {
                                     width: ListView.view.width
                                     ColumnLayout {
@@ -663,9 +786,9 @@ Window {  // можно оставить Window — без padding в корне
                                         spacing: 6
                                         RowLayout {
                                             spacing: 12
-                                            Label { text: modelData.name; font.bold: true }
-                                            Label { text: modelData.toCard }
-                                            Label { text: modelData.note }
+                                            Label { text: model.name; font.bold: true }
+                                            Label { text: model.toCard }
+                                            Label { text: model.note }
                                         }
                                         RowLayout {
                                             spacing: 6
@@ -696,7 +819,7 @@ Window {  // можно оставить Window — без padding в корне
                                                     if (accModel.count === 0 || favFromAcc.currentIndex < 0) { addCardStatus.text = "Выберите свой счет"; return }
                                                     const myAcc = accModel.get(favFromAcc.currentIndex).value
                                                     const cat = favCategoryCombo.currentIndex >= 0 ? favCategoryCombo.model.get(favCategoryCombo.currentIndex).value : "other"
-                                                    bank.payFavorite(modelData.name, myAcc, favAmount.value*100, cat)
+                                                    bank.payFavorite(model.name, myAcc, favAmount.value*100, cat)
                                                 } }
                                         }
                                     }
@@ -740,7 +863,7 @@ Window {  // можно оставить Window — без padding в корне
                                         var ctx = getContext("2d")
                                         ctx.clearRect(0, 0, width, height)
                                         
-                                        var stats = bank.getExpenseStats()
+                                        var stats = bank.viewData("expenseStats")
                                         if (!stats || !stats.total || stats.total === 0) {
                                             ctx.fillStyle = "#999"
                                             ctx.font = "20px sans-serif"
@@ -872,8 +995,9 @@ Window {  // можно оставить Window — без padding в корне
                             spacing: 8
                             RowLayout {
                                 spacing: 8
-                                Button { text: "Обновить"; onClicked: notificationsView.model = bank.listNotifications() }
+                                Button { text: "Обновить"; onClicked: bank.refreshCollections() }
                                 Button { text: "Очистить"; onClicked: bank.clearNotifications() }
+                                Button { text: "Прочитано"; onClicked: bank.markNotificationsRead(0) }
                             }
                             ScrollView {
                                 Layout.fillWidth: true
@@ -882,7 +1006,7 @@ Window {  // можно оставить Window — без padding в корне
                                 ListView {
                                     id: notificationsView
                                     width: parent.width
-                                    model: bank.listNotifications()
+                                    model: bank.notificationsModel
                                     spacing: 8
                                     delegate: Frame {
                                         width: ListView.view.width
@@ -894,12 +1018,12 @@ Window {  // можно оставить Window — без padding в корне
                                                 Layout.preferredWidth: 8
                                                 Layout.preferredHeight: 8
                                                 radius: 4
-                                                color: "#FF9800"
+                                                color: model.unread ? "#FF9800" : "#BDBDBD"
                                             }
                                             Label {
                                                 Layout.fillWidth: true
                                                 wrapMode: Text.WordWrap
-                                                text: modelData.message
+                                                text: model.message
                                                 font.pixelSize: 13
                                             }
                                         }
@@ -928,20 +1052,40 @@ Window {  // можно оставить Window — без padding в корне
                                     id: adminSearchField
                                     placeholderText: "Поиск по пользователю, ID, счету, карте..."
                                     Layout.fillWidth: true
-                                    onTextChanged: {
-                                        if (typeof adminTransfersList !== 'undefined') {
-                                            adminTransfersList.model = bank.listAllTransfers(text)
-                                        }
-                                    }
+                                    onTextChanged: searchAdminTransfers()
                                 }
                                 Button { 
                                     text: "Обновить"; 
-                                    onClicked: {
-                                        if (typeof adminTransfersList !== 'undefined') {
-                                            adminTransfersList.model = bank.listAllTransfers(adminSearchField.text)
-                                        }
-                                    } 
+                                    onClicked: searchAdminTransfers()
+                                }
+                            }
+                            // Запрос: cents > 100000 AND status = cancelled AND timestamp >= 2026-01-01 AND user ~ "ivan"
+                            RowLayout {
+                                spacing: 8
+                                TextField {
+                                    id: adminQueryField
+                                    placeholderText: "Запрос: amount > 1000 AND status = cancelled AND user ~ \"ivan\""
+                                    Layout.fillWidth: true
+                                    onAccepted: runAdminQuery()
+                                }
+                                ComboBox {
+                                    id: adminQueryOrder
+                                    model: ["timestamp desc", "cents desc", "cents asc", "user asc"]
                                 }
+                                Button { text: "Выполнить"; onClicked: runAdminQuery() }
+                                Label { id: adminQueryResult; color: "#666" }
+                            }
+                            // Массовая отмена: сначала проверка без изменений, затем отмена с причиной
+                            RowLayout {
+                                spacing: 8
+                                TextField { id: bulkToCard; placeholderText: "Карта/счет получателя"; Layout.fillWidth: true }
+                                TextField { id: bulkFromAccount; placeholderText: "Счет отправителя"; Layout.fillWidth: true }
+                                TextField { id: bulkIds; placeholderText: "ID через запятую"; Layout.fillWidth: true }
+                                TextField { id: bulkFromDate; placeholderText: "С (ГГГГ-ММ-ДД)"; Layout.preferredWidth: 130 }
+                                TextField { id: bulkToDate; placeholderText: "По (ГГГГ-ММ-ДД)"; Layout.preferredWidth: 130 }
+                                Button { text: "Проверить"; onClicked: previewBulkCancel() }
+                                Button { text: "Отменить найденные"; enabled: bulkMatched > 0; onClicked: { bulkCancelReason.text = ""; bulkCancelDialog.open() } }
+                                Label { id: bulkCancelResult; color: "#666" }
                             }
                             // Header
                             RowLayout {
@@ -962,65 +1106,65 @@ Window {  // можно оставить Window — без padding в корне
                                 id: adminTransfersList
                                 Layout.fillWidth: true
                                 Layout.fillHeight: true
-                                model: bank.listAllTransfers("")
+                                model: adminTransfersModel
                                 spacing: 4
                                 delegate: RowLayout {
                                     width: ListView.view.width
                                     spacing: 12
                                     Label { 
-                                        text: modelData.user || ""; 
+                                        text: model.user || ""; 
                                         Layout.preferredWidth: 120 
                                     }
                                     Label { 
-                                        text: modelData.id || ""; 
+                                        text: model.id || ""; 
                                         Layout.preferredWidth: 150;
                                         font.family: "monospace"
                                         font.pixelSize: 11
                                     }
                                     Label { 
-                                        text: modelData.fromAccount || ""; 
+                                        text: model.fromAccount || ""; 
                                         Layout.preferredWidth: 150;
                                         font.family: "monospace"
                                         font.pixelSize: 11
                                     }
                                     Label { 
-                                        text: modelData.toCard || ""; 
+                                        text: model.toCard || ""; 
                                         Layout.preferredWidth: 150;
                                         font.family: "monospace"
                                         font.pixelSize: 11
                                     }
                                     Label { 
-                                        text: ((modelData.cents || 0)/100).toFixed(2) + " руб."; 
+                                        text: ((model.cents || 0)/100).toFixed(2) + " руб."; 
                                         Layout.preferredWidth: 100 
                                     }
                                     Text { 
-                                        text: modelData.timestamp ? new Date(modelData.timestamp*1000).toLocaleString() : ""; 
+                                        text: model.timestamp ? new Date(model.timestamp*1000).toLocaleString() : ""; 
                                         Layout.preferredWidth: 180; 
                                         elide: Text.ElideRight;
                                         wrapMode: Text.WordWrap;
                                         maximumLineCount: 2
                                     }
                                     Label {
-                                        text: modelData.status === "cancelled" ? "Отменен" : "Выполнен"
+                                        text: model.status === "cancelled" ? "Отменен" : "Выполнен"
                                         Layout.preferredWidth: 100
-                                        color: modelData.status === "cancelled" ? "tomato" : "#18a558"
+                                        color: model.status === "cancelled" ? "tomato" : "#18a558"
                                         font.bold: true
                                     }
                                     Text {
-                                        text: (modelData.status === "cancelled" && modelData.cancelReason ? 
-                                               (modelData.note || "") + " (Отмена: " + modelData.cancelReason + ")" : 
-                                               (modelData.note || ""))
+                                        text: (model.status === "cancelled" && model.cancelReason ? 
+                                               (model.note || "") + " (Отмена: " + model.cancelReason + ")" : 
+                                               (model.note || ""))
                                         Layout.fillWidth: true
                                         elide: Text.ElideRight
                                         wrapMode: Text.WordWrap
                                         maximumLineCount: 2
                                     }
                                     Button {
-                                        text: modelData.status === "cancelled" ? "Отменен" : "Отменить"
+                                        text: model.status === "cancelled" ? "Отменен" : "Отменить"
                                         Layout.preferredWidth: 100
-                                        enabled: modelData.status !== "cancelled"
+                                        enabled: model.status !== "cancelled"
                                         onClicked: {
-                                            adminCancelTxId = modelData.id
+                                            adminCancelTxId = model.id
                                             adminCancelReason.text = ""
                                             adminCancelDialog.open()
                                         }
@@ -1056,12 +1200,8 @@ Window {  // можно оставить Window — без padding в корне
                                         ListElement { text: "По количеству транзакций" }
                                     }
                                     onCurrentTextChanged: {
-                                        let sortValue = ""
-                                        if (currentText === "По количеству счетов") sortValue = "accounts"
-                                        else if (currentText === "По количеству карт") sortValue = "cards"
-                                        else if (currentText === "По количеству транзакций") sortValue = "transactions"
-                                        if (typeof adminUsersList !== 'undefined') {
-                                            adminUsersList.model = bank.getAllUsersInfo(sortValue)
+                                        if (typeof adminUsersList !== 'undefined' && contentView.currentIndex === 7) {
+                                            adminUsersList.model = bank.viewData("adminUsers", adminUsersSortValue())
                                         }
                                     }
                                 }
@@ -1070,11 +1210,7 @@ Window {  // можно оставить Window — без padding в корне
                                     text: "Обновить"; 
                                     onClicked: {
                                         if (typeof adminUsersList !== 'undefined') {
-                                            let sortValue = ""
-                                            if (adminUsersSort.currentText === "По количеству счетов") sortValue = "accounts"
-                                            else if (adminUsersSort.currentText === "По количеству карт") sortValue = "cards"
-                                            else if (adminUsersSort.currentText === "По количеству транзакций") sortValue = "transactions"
-                                            adminUsersList.model = bank.getAllUsersInfo(sortValue)
+                                            adminUsersList.model = bank.getAllUsersInfo(adminUsersSortValue())
                                         }
                                     } 
                                 }
@@ -1100,7 +1236,7 @@ Window {  // можно оставить Window — без padding в корне
                                 ListView {
                                     id: adminUsersList
                                     width: parent.width
-                                    model: bank.getAllUsersInfo("")
+                                    model: []
                                     spacing: 8
                                     delegate: Item {
                                         id: userItem
@@ -1248,44 +1384,30 @@ Window {  // можно оставить Window — без padding в корне
                     authStatus.text = bank.authenticated ? "Вход выполнен: " + bank.username : ""
                     if (!bank.authenticated) {
                         stack.replace(loginPage)
-                        if (typeof notificationsView !== 'undefined') notificationsView.model = []
-                        if (typeof historyList !== 'undefined') historyList.model = []
-                        if (typeof favoritesList !== 'undefined') favoritesList.model = []
                     } else {
                         accRefresh()
-                        accountsList.model = bank.listAccounts()
-                        cardsList.model = bank.listCards()
-                        if (typeof historyList !== 'undefined') historyList.model = bank.listHistory()
-                        favRefresh()
-                        if (typeof notificationsView !== 'undefined') notificationsView.model = bank.listNotifications()
-                        if (typeof updateExpenseChart !== 'undefined') updateExpenseChart()
-                        if (typeof adminTransfersList !== 'undefined' && bank.admin) {
-                            adminTransfersList.model = bank.listAllTransfers("")
-                        }
-                        if (typeof adminUsersList !== 'undefined' && bank.admin) {
-                            adminUsersList.model = bank.getAllUsersInfo("")
-                        }
                         contentView.currentIndex = 0
                     }
                 }
                 function onInfoMessage(message) {
                     accStatus.text = message; addCardStatus.text = message; transferStatus.text = message;
                     accRefresh();
-                    accountsList.model = bank.listAccounts();
-                    cardsList.model = bank.listCards();
-                    if (typeof historyList !== 'undefined') historyList.model = bank.listHistory();
-                    favRefresh();
-                    if (typeof notificationsView !== 'undefined') notificationsView.model = bank.listNotifications()
-                    if (typeof updateExpenseChart !== 'undefined') updateExpenseChart()
-                    if (typeof adminTransfersList !== 'undefined' && bank.admin) {
-                        adminTransfersList.model = bank.listAllTransfers(adminSearchField ? adminSearchField.text : "")
-                    }
+                    // открытая вкладка перечитывается сразу, остальные — при следующем показе
+                    loadView(contentView.currentIndex)
+                    if (historyFiltered) queryHistory(true)
                     authStatus.text = bank.authenticated ? "Вход выполнен: " + bank.username : ""
                 }
                 function onErrorOccured(message) {
                     accStatus.text = message; addCardStatus.text = message; transferStatus.text = message
                     authStatus.text = bank.authenticated ? "Вход выполнен: " + bank.username : ""
                 }
+                function onTransferSearchRows(generation, rows, done) {
+                    if (generation !== adminSearchGeneration) return
+                    for (let i = 0; i < rows.length; i++) adminTransfersModel.append(rows[i])
+                }
+                function onTransferSearchReset() {
+                    if (adminSearchGeneration !== 0) searchAdminTransfers()
+                }
             }
 
             Dialog {
@@ -1293,10 +1415,11 @@ Window {  // можно оставить Window — без padding в корне
                 modal: true
                 title: "Пополнение счета"
                 standardButtons: Dialog.Ok | Dialog.Cancel
+                onAboutToShow: depositKey = requestKey()
                 onAccepted: {
                     if (depositAccount.currentIndex < 0 || accModel.count === 0) { accStatus.text = "Выберите счет"; return }
                     const accNum = accModel.get(depositAccount.currentIndex).value
-                    bank.depositToAccount(accNum, depositAmount.value * 100, depositExternal.text)
+                    bank.depositToAccount(accNum, depositAmount.value * 100, depositExternal.text, depositKey)
                 }
                 ColumnLayout {
                     anchors.margins: 12
@@ -1386,9 +1509,6 @@ Window {  // можно оставить Window — без padding в корне
                     if (!adminCancelTxId) return
                     bank.cancelTransfer(adminCancelTxId, adminCancelReason.text)
                     adminCancelTxId = ""
-                    if (typeof adminTransfersList !== 'undefined') {
-                        adminTransfersList.model = bank.listAllTransfers(adminSearchField.text)
-                    }
                 }
                 ColumnLayout {
                     anchors.margins: 12
@@ -1404,9 +1524,31 @@ Window {  // можно оставить Window — без padding в корне
                     }
                 }
             }
+            Dialog {
+                id: bulkCancelDialog
+                modal: true
+                title: "Массовая отмена платежей"
+                standardButtons: Dialog.Ok | Dialog.Cancel
+                onAccepted: {
+                    const result = bank.cancelTransfers(bulkCancelFilter(), bulkCancelReason.text, false)
+                    bulkMatched = 0
+                    if (result.cancelled !== undefined) {
+                        bulkCancelResult.text = "Отменено: " + result.cancelled + " на " + (result.cancelledCents / 100).toFixed(2)
+                    }
+                }
+                ColumnLayout {
+                    anchors.margins: 12
+                    spacing: 8
+                    Label { text: "Будет отменено платежей: " + bulkMatched; font.bold: true }
+                    TextField {
+                        id: bulkCancelReason
+                        placeholderText: "Причина отмены"
+                        Layout.fillWidth: true
+                    }
+                }
+            }
             Component.onCompleted: {
                 accRefresh()
-                if (typeof notificationsView !== 'undefined') notificationsView.model = bank.listNotifications()
                 authStatus.text = bank.authenticated ? "Вход выполнен: " + bank.username : ""
             }
         }
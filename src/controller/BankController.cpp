@@ -1,19 +1,186 @@
 #include "BankController.h"
+#include "VariantSchema.h"
 
 #include <QVariantMap>
 #include <QDateTime>
 #include <QDate>
+#include <QtConcurrent/QtConcurrentRun>
+#include <functional>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <unordered_set>
+#include <utility>
 
 using namespace utils;
 using namespace storage;
 
+namespace {
+
+QVariantMap accountRow(const Account &a) { return schema::toVariantMap(a); }
+QVariantMap cardRow(const Card &c) { return schema::toVariantMap(c); }
+QVariantMap historyRow(const Transaction &t) { return schema::toVariantMap(t); }
+QVariantMap favoriteRow(const FavoritePayment &f, int index) {
+    QVariantMap m = schema::toVariantMap(f);
+    m["position"] = index;  // имена избранного могут повторяться: ключ строки — позиция
+    return m;
+}
+
+// Строка перевода для админских списков и чеков: поля операции плюс владелец
+template <typename TTransaction, typename TName>
+QVariantMap transferRow(const TName &user, const TTransaction &t) {
+    static const QString userKey = QStringLiteral("user");
+    QVariantMap m = schema::toVariantMap(t);
+    m.insert(userKey, schema::toVariant(user));
+    return m;
+}
+
+QVariantMap notificationRow(const NotificationEntry &n, long long readCursor) {
+    QVariantMap m;
+    m["id"] = static_cast<qlonglong>(n.id);
+    m["timestamp"] = static_cast<qlonglong>(n.timestamp);
+    m["message"] = QString::fromStdString(n.message);
+    m["unread"] = n.id > readCursor;
+    return m;
+}
+
+// История пользователя: его операции плюс зачисления от других, найденные в журнале по его счетам
+std::vector<Transaction> historyOf(const RegularUser &user) {
+    std::vector<Transaction> out = user.history;
+    std::unordered_set<std::string> known;
+    for (const auto &t : user.history) known.insert(t.id);
+    std::vector<std::string> numbers;
+    for (const auto &a : user.accounts) numbers.push_back(a.accountNumber);
+    std::unordered_set<std::string> mine(numbers.begin(), numbers.end());
+    std::unordered_map<std::string, std::size_t> incoming;
+    for (const auto &e : PostingLedger::instance().entriesFor(numbers)) {
+        if (known.count(e.transactionId)) continue;
+        if (e.kind == "transfer") {
+            for (const auto &leg : e.legs) {
+                if (!mine.count(leg.account) || leg.cents <= 0) continue;
+                Transaction t;
+                t.id = e.transactionId;
+                t.fromAccount = e.legs.front().account;
+                t.toCard = leg.account;
+                t.cents = leg.cents;
+                t.timestamp = e.timestamp;
+                t.note = e.note;
+                t.category = e.category.empty() ? "other" : e.category;
+                t.status = "completed";
+                t.creditedCents = leg.cents;
+                incoming[t.id] = out.size();
+                out.push_back(t);
+                break;
+            }
+        } else if (e.kind == "cancel") {
+            auto it = incoming.find(e.transactionId);
+            if (it == incoming.end()) continue;
+            out[it->second].status = "cancelled";
+            out[it->second].cancelReason = e.note;
+        }
+    }
+    std::stable_sort(out.begin(), out.end(), [](const Transaction &a, const Transaction &b){ return a.timestamp < b.timestamp; });
+    return out;
+}
+
+// Ключ сортировки пользователей в админке: размер раздела; 0 — сортировка только по имени
+std::size_t userSortKey(const UserView &u, const std::string &sort) {
+    if (sort == "accounts" || sort == "счета") return u.sizes.accounts;
+    if (sort == "cards" || sort == "карты") return u.sizes.cards;
+    if (sort == "transactions" || sort == "транзакции" || sort == "переводы") return u.sizes.history;
+    return 0;
+}
+
+template <typename TContainer, typename TRow>
+QList<QVariantMap> toRows(const TContainer &items, TRow row) {
+    QList<QVariantMap> out;
+    out.reserve(static_cast<qsizetype>(items.size()));
+    for (const auto &item : items) out.append(row(item));
+    return out;
+}
+
+QList<QVariantMap> favoriteRows(const std::vector<FavoritePayment> &items) {
+    QList<QVariantMap> out;
+    out.reserve(static_cast<qsizetype>(items.size()));
+    for (const auto &item : items) out.append(favoriteRow(item, static_cast<int>(out.size())));
+    return out;
+}
+
+// Внешние реквизиты и категория попадают в журнал проводок полями через запятую
+void requireLedgerField(const std::string &value, const std::string &what) {
+    if (value.find_first_of(",\r\n") != std::string::npos) throw ValidationError(what + " не может содержать запятую или перевод строки");
+}
+
+// Обходы читают файлы пользователей: отложенные записи сначала уходят на диск
+void syncUserFiles() {
+    UserRepository::instance().flush();
+}
+
+}
+
 BankController::BankController(QObject *parent) : QObject(parent) {
+    scheduleTimer = new QTimer(this);
+    scheduleTimer->setSingleShot(true);
+    connect(scheduleTimer, &QTimer::timeout, this, &BankController::runDueSchedules);
+    // таймер с нулевым интервалом срабатывает, когда очередь событий пуста: по одному виду за раз,
+    // сам вид считается в фоне
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, &QTimer::timeout, this, &BankController::prefetchStep);
+    prefetchWatcher = new QFutureWatcher<QVariant>(this);
+    connect(prefetchWatcher, &QFutureWatcher<QVariant>::finished, this, &BankController::prefetchDone);
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    connect(searchTimer, &QTimer::timeout, this, &BankController::searchStep);
+    // смена пользователя сбрасывает кэш видов; изменения данных сбрасывают его там, где происходят
+    connect(this, &BankController::authenticatedChanged, this, [this]() {
+        invalidateViews();
+        transferSearch.reset();
+        if (isAuthenticated()) schedulePrefetch(QString());
+    });
+    accountsRows = new VariantListModel({"accountNumber", "currency", "balanceCents"}, this);
+    cardsRows = new VariantListModel({"cardNumber", "holderName", "expiry", "linkedAccount"}, this);
+    historyRows = new VariantListModel({"id", "fromAccount", "toCard", "cents", "timestamp", "note", "category",
+                                        "status", "cancelReason", "rate", "creditedCents"}, this);
+    favoritesRows = new VariantListModel({"position", "name", "toCard", "note"}, this);
+    notificationsRows = new VariantListModel({"id", "timestamp", "message", "unread"}, this);
+    // пользователя изменила другая сессия или фоновая операция: модели перечитываются в потоке
+    // контроллера. Свои изменения модели уже показывают (см. updateShown) и пропускаются
+    repositoryListener = UserRepository::instance().subscribe([this](const std::string &name) {
+        QMetaObject::invokeMethod(this, [this, name]() {
+            if (name == currentName && current() != shown) refreshCollections();
+            if (isAdminLogin || name == currentName) invalidateViews();
+            if (isAdminLogin) searchStale = true;
+        }, Qt::QueuedConnection);
+    });
+}
+
+BankController::~BankController() {
+    prefetchWatcher->waitForFinished();
+    UserRepository::instance().unsubscribe(repositoryListener);
+    // выход из программы: отложенные записи — на диск
+    UserRepository::instance().flush();
+}
+
+// Изменение пользователя, после которого вызывающий сам дополняет модели. Если модели
+// показывали ту версию, к которой применена fn, новая версия считается показанной,
+// и слушатель хранилища ее не перечитывает; иначе он сверит модели с ней целиком
+template <typename F>
+UserSnapshot BankController::updateShown(const std::string &name, F &&fn) {
+    UserSnapshot base;
+    auto published = UserRepository::instance().update(name, [&](RegularUser &u){
+        base = UserRepository::instance().get(name);  // под мьютексом слота — версия, с которой снята копия
+        fn(u);
+    });
+    if (name == currentName && base == shown) shown = published;
+    invalidateViews();  // сразу, не дожидаясь слушателя: вид могут запросить в том же обработчике
+    return published;
 }
 
 void BankController::seedAdmin() {
     UserStorage::ensureDataDirs();
+    // просроченные за время простоя поручения исполнятся на первом витке цикла событий
+    armScheduleTimer();
 }
 
 void BankController::login(const QString &username, const QString &password) {
@@ -25,7 +192,8 @@ void BankController::login(const QString &username, const QString &password) {
         if (uname == "admin") {
             if (password == "admin") {
                 isAdminLogin = true;
-                currentUser.reset();
+                currentName.clear();
+                resetCollections();
                 emit authenticatedChanged();
                 emit infoMessage("Вход выполнен как администратор");
                 return;
@@ -34,10 +202,18 @@ void BankController::login(const QString &username, const QString &password) {
             }
         }
 
-        RegularUser u = UserStorage::loadUser(uname);
-        if (u.passwordHash != weakHash(pwd)) throw AuthError("Неверный пароль");
-        currentUser = std::move(u);
+        auto &repo = UserRepository::instance();
+        auto snapshot = repo.get(uname);
+        if (snapshot->passwordHash != weakHash(pwd)) throw AuthError("Неверный пароль");
+        // файл переписывается, только если в нем были устаревшие уведомления
+        bool legacy = !snapshot->notifications.empty();
+        repo.update(uname, [this](RegularUser &u){
+            syncLedgerBalances(u);
+            migrateLegacyNotifications(u);
+        }, legacy);
+        currentName = uname;
         isAdminLogin = false;
+        resetCollections();
         emit authenticatedChanged();
         emit infoMessage("Вход выполнен");
     } catch (const std::exception &e) {
@@ -46,8 +222,10 @@ void BankController::login(const QString &username, const QString &password) {
 }
 
 void BankController::logout() {
-    currentUser.reset();
+    UserRepository::instance().flush();
+    currentName.clear();
     isAdminLogin = false;
+    resetCollections();
     emit authenticatedChanged();
 }
 
@@ -58,6 +236,7 @@ void BankController::registerUser(const QString &username, const QString &passwo
         if (UserStorage::exists(uname)) throw ValidationError("Пользователь уже существует");
         RegularUser u(uname, weakHash(password.toStdString()));
         UserStorage::saveUser(u);
+        invalidateViews();
         emit infoMessage("Пользователь создан");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
@@ -66,28 +245,17 @@ void BankController::registerUser(const QString &username, const QString &passwo
 
 QVariantList BankController::listAccounts() const {
     QVariantList out;
-    if (!currentUser) return out;
-    for (const auto &a : currentUser->accounts) {
-        QVariantMap m;
-        m["accountNumber"] = QString::fromStdString(a.accountNumber);
-        m["currency"] = QString::fromStdString(a.currency);
-        m["balanceCents"] = static_cast<qlonglong>(a.balanceCents);
-        out.push_back(m);
-    }
+    auto user = current();
+    if (!user) return out;
+    for (const auto &item : user->accounts) out.push_back(accountRow(item));
     return out;
 }
 
 QVariantList BankController::listCards() const {
     QVariantList out;
-    if (!currentUser) return out;
-    for (const auto &c : currentUser->cards) {
-        QVariantMap m;
-        m["cardNumber"] = QString::fromStdString(c.cardNumber);
-        m["holderName"] = QString::fromStdString(c.holderName);
-        m["expiry"] = QString::fromStdString(c.expiry);
-        m["linkedAccount"] = QString::fromStdString(c.linkedAccount);
-        out.push_back(m);
-    }
+    auto user = current();
+    if (!user) return out;
+    for (const auto &item : user->cards) out.push_back(cardRow(item));
     return out;
 }
 
@@ -96,15 +264,8 @@ QVariantList BankController::listUserCards(const QString &username) const {
     try {
         auto uname = username.trimmed().toStdString();
         if (uname.empty()) return out;
-        RegularUser u = storage::UserStorage::loadUser(uname);
-        for (const auto &c : u.cards) {
-            QVariantMap m;
-            m["cardNumber"] = QString::fromStdString(c.cardNumber);
-            m["holderName"] = QString::fromStdString(c.holderName);
-            m["expiry"] = QString::fromStdString(c.expiry);
-            m["linkedAccount"] = QString::fromStdString(c.linkedAccount);
-            out.push_back(m);
-        }
+        auto u = UserRepository::instance().peek(uname);
+        for (const auto &c : u->cards) out.push_back(cardRow(c));
     } catch (...) {
         // ignore missing user
     }
@@ -116,14 +277,8 @@ QVariantList BankController::listUserAccounts(const QString &username) const {
     try {
         auto uname = username.trimmed().toStdString();
         if (uname.empty()) return out;
-        RegularUser u = storage::UserStorage::loadUser(uname);
-        for (const auto &a : u.accounts) {
-            QVariantMap m;
-            m["accountNumber"] = QString::fromStdString(a.accountNumber);
-            m["currency"] = QString::fromStdString(a.currency);
-            m["balanceCents"] = static_cast<qlonglong>(a.balanceCents);
-            out.push_back(m);
-        }
+        auto u = UserRepository::instance().peek(uname);
+        for (const auto &a : u->accounts) out.push_back(accountRow(a));
     } catch (...) {
     }
     return out;
@@ -131,44 +286,59 @@ QVariantList BankController::listUserAccounts(const QString &username) const {
 
 QVariantList BankController::listHistory() const {
     QVariantList out;
-    if (!currentUser) return out;
-    for (const auto &t : currentUser->history) {
-        QVariantMap m;
-        m["id"] = QString::fromStdString(t.id);
-        m["fromAccount"] = QString::fromStdString(t.fromAccount);
-        m["toCard"] = QString::fromStdString(t.toCard);
-        m["cents"] = static_cast<qlonglong>(t.cents);
-        m["timestamp"] = static_cast<qlonglong>(t.timestamp);
-        m["note"] = QString::fromStdString(t.note);
-        m["status"] = QString::fromStdString(t.status);
-        m["cancelReason"] = QString::fromStdString(t.cancelReason);
-        out.push_back(m);
+    auto user = current();
+    if (!user) return out;
+    for (const auto &item : historyOf(*user)) out.push_back(historyRow(item));
+    return out;
+}
+
+QVariantMap BankController::queryHistory(const QVariantMap &filter) {
+    QVariantMap out;
+    QVariantList items;
+    if (auto user = current()) {
+        if (historyIndexRevision != historyRows->revision() || historyIndexUser != user->usernameValue) {
+            historyIndex.build(historyOf(*user));
+            historyIndexRevision = historyRows->revision();
+            historyIndexUser = user->usernameValue;
+        }
+        HistoryFilter f;
+        f.fromTs = filter.value("fromTs").toLongLong();
+        f.toTs = filter.value("toTs").toLongLong();
+        f.minCents = filter.value("minCents").toLongLong();
+        f.maxCents = filter.value("maxCents").toLongLong();
+        f.category = filter.value("category").toString().toStdString();
+        f.status = filter.value("status").toString().toStdString();
+        f.counterparty = filter.value("counterparty").toString().trimmed().toStdString();
+        f.newestFirst = filter.value("order").toString() != "oldest";
+        f.cursor = filter.value("cursor").toString().toStdString();
+        f.limit = static_cast<std::size_t>(std::max(0, filter.value("limit").toInt()));
+        auto page = historyIndex.query(f);
+        for (const auto *t : page.items) items.push_back(historyRow(*t));
+        out["nextCursor"] = QString::fromStdString(page.nextCursor);
     }
+    out["items"] = items;
     return out;
 }
 
 QVariantList BankController::listFavorites() const {
     QVariantList out;
-    if (!currentUser) return out;
-    for (const auto &f : currentUser->favorites) {
-        QVariantMap m;
-        m["name"] = QString::fromStdString(f.name);
-        m["toCard"] = QString::fromStdString(f.toCard);
-        m["note"] = QString::fromStdString(f.note);
-        out.push_back(m);
-    }
+    auto user = current();
+    if (!user) return out;
+    for (const auto &item : user->favorites) out.push_back(favoriteRow(item, static_cast<int>(out.size())));
     return out;
 }
 
 void BankController::addAccount(const QString &currency) {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
         Account a;
-        a.accountNumber = generateNumericId(20);
         a.currency = currency.toStdString();
+        a.accountNumber = IdAllocator::instance().nextAccountNumber(a.currency);
         a.balanceCents = 0;
-        currentUser->accounts.push_back(a);
-        saveCurrent();
+        PostingLedger::instance().openAccount(user->usernameValue, a.accountNumber, a.currency);
+        updateShown(currentName, [&](RegularUser &u){ u.accounts.push_back(a); });
+        appendRow(accountsRows, "accounts", accountRow(a));
         emit infoMessage("Счет добавлен");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
@@ -178,18 +348,20 @@ void BankController::addAccount(const QString &currency) {
 void BankController::addCard(const QString &holderName, const QString &expiry, const QString &linkedAccount) {
     Q_UNUSED(holderName);  // Имя берется из текущего пользователя
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
-        auto it = std::find_if(currentUser->accounts.begin(), currentUser->accounts.end(), [&](const Account &a){
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        auto it = std::find_if(user->accounts.begin(), user->accounts.end(), [&](const Account &a){
             return a.accountNumber == linkedAccount.toStdString();
         });
-        if (it == currentUser->accounts.end()) throw ValidationError("Нет такого счета");
+        if (it == user->accounts.end()) throw ValidationError("Нет такого счета");
         Card c;
-        c.cardNumber = generateNumericId(16);
-        c.holderName = currentUser->usernameValue;
+        c.cardNumber = IdAllocator::instance().nextCardNumber();
+        c.holderName = user->usernameValue;
         c.expiry = expiry.toStdString();
         c.linkedAccount = linkedAccount.toStdString();
-        currentUser->cards.push_back(c);
-        saveCurrent();
+        PostingLedger::instance().linkCard(c.cardNumber, c.linkedAccount);
+        updateShown(currentName, [&](RegularUser &u){ u.cards.push_back(c); });
+        appendRow(cardsRows, "cards", cardRow(c));
         emit infoMessage("Карта добавлена");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
@@ -198,77 +370,323 @@ void BankController::addCard(const QString &holderName, const QString &expiry, c
 
 void BankController::addFavorite(const QString &name, const QString &toCard, const QString &note) {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
         FavoritePayment f;
         f.name = name.toStdString();
         f.toCard = toCard.toStdString();
         f.note = note.toStdString();
-        currentUser->favorites.push_back(f);
-        saveCurrent();
+        updateShown(currentName, [&](RegularUser &u){ u.favorites.push_back(f); });
+        appendRow(favoritesRows, "favorites", favoriteRow(f, favoritesRows->count()));
         emit infoMessage("Избранный платеж добавлен");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
     }
 }
 
-void BankController::transfer(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note, const QString &category) {
+QString BankController::transfer(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note,
+                                 const QString &category, const QString &idempotencyKey) {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
-        auto it = std::find_if(currentUser->accounts.begin(), currentUser->accounts.end(), [&](const Account &a){
-            return a.accountNumber == fromAccount.toStdString();
-        });
-        if (it == currentUser->accounts.end()) throw ValidationError("Нет такого счета");
-        if (cents <= 0) throw ValidationError("Сумма должна быть положительной");
-        if (it->balanceCents < cents) throw ValidationError("Недостаточно средств");
-        it->balanceCents -= cents;
-
+        if (currentName.empty()) throw AuthError("Необходима авторизация");
+        auto key = idempotencyKey.trimmed().toStdString();
+        auto cat = category.isEmpty() ? std::string("other") : category.toStdString();
+        std::string fingerprint;
+        if (!key.empty()) {
+            fingerprint = IdempotencyStore::fingerprint({fromAccount.toStdString(), toCard.toStdString(), std::to_string(cents), note.toStdString(), cat});
+            QString original;
+            if (replayIdempotent(key, "transfer", fingerprint, original)) return original;
+        }
+        std::string recipientName;
+        std::string message;
         Transaction t;
-        t.id = generateNumericId(12);
-        t.fromAccount = fromAccount.toStdString();
-        t.toCard = toCard.toStdString();
-        t.cents = cents;
-        t.timestamp = std::time(nullptr);
-        t.note = note.toStdString();
-        t.category = category.isEmpty() ? "other" : category.toStdString();
-        t.status = "completed";
-        t.cancelReason.clear();
-        currentUser->history.push_back(t);
-        saveCurrent();
-
-        bool credited = adjustRecipientBalance(toCard.toStdString(), cents);
+        updateShown(currentName, [&](RegularUser &u){
+            t = executeTransfer(u, fromAccount.toStdString(), toCard.toStdString(), cents, note.toStdString(), cat, recipientName);
+            message = !recipientName.empty() ? "Перевод выполнен" : "Перевод выполнен (получатель не найден)";
+            // ключ фиксируется сразу после проводки: повтор после сбоя записи файла не переведет деньги второй раз
+            if (!key.empty()) IdempotencyStore::instance().remember(currentName, key, {"transfer", fingerprint, t.id, message});
+        });
+        if (recipientName != currentName) mirrorBalances(recipientName);
+        syncAccountsRows();
+        appendRow(historyRows, "history", historyRow(t));
+        AnalyticsStore::instance().record(LedgerEventKind::Transfer, t, currentName, recipientName);
 
-        emit infoMessage(credited ? "Перевод выполнен" : "Перевод выполнен (получатель не найден)");
+        emit infoMessage(QString::fromStdString(message));
+        return QString::fromStdString(t.id);
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
+        return QString();
     }
 }
 
+// true — ключ уже обработан: клиент получает исходный результат, операция не повторяется
+bool BankController::replayIdempotent(const std::string &key, const std::string &kind, const std::string &fingerprint, QString &transactionId) {
+    auto &store = IdempotencyStore::instance();
+    IdempotencyStore::validateKey(key);
+    IdempotencyRecord done;
+    if (!store.find(currentName, key, done)) return false;
+    if (done.kind != kind || done.fingerprint != fingerprint) throw ValidationError("Ключ идемпотентности уже использован для другой операции");
+    transactionId = QString::fromStdString(done.transactionId);
+    emit infoMessage(QString::fromStdString(done.message));
+    return true;
+}
+
+Transaction BankController::executeTransfer(RegularUser &sender, const std::string &fromAccount, const std::string &toCard, long long cents,
+                                            const std::string &note, const std::string &category, std::string &recipientName, std::time_t at) {
+    auto &ledger = PostingLedger::instance();
+    syncLedgerBalances(sender);
+    auto it = std::find_if(sender.accounts.begin(), sender.accounts.end(), [&](const Account &a){ return a.accountNumber == fromAccount; });
+    if (it == sender.accounts.end()) throw ValidationError("Нет такого счета");
+    if (cents <= 0) throw ValidationError("Сумма должна быть положительной");
+    if (it->balanceCents < cents) throw ValidationError("Недостаточно средств");
+    requireLedgerField(toCard, "Реквизиты получателя");
+    requireLedgerField(category, "Категория");
+
+    auto &limits = VelocityRules::instance();
+    limits.prime(fromAccount, sender.history);
+    auto verdict = limits.check(fromAccount, toCard, cents);
+
+    // Получатель по справочнику журнала, без обхода файлов. Конвертация — до записи,
+    // чтобы ошибка курса не оставила в журнале половину операции
+    long long appliedRate = 0;
+    long long creditedCents = cents;
+    std::vector<PostingLeg> legs{{fromAccount, it->currency, -cents}};
+    LedgerAccount recipient;
+    std::string destination = ledger.resolve(toCard);
+    if (!destination.empty() && ledger.account(destination, recipient)) {
+        creditedCents = RatesTable::instance().convert(cents, it->currency, recipient.currency, &appliedRate);
+        if (recipient.currency != it->currency) {
+            legs.push_back({"fx:" + it->currency, it->currency, cents});
+            legs.push_back({"fx:" + recipient.currency, recipient.currency, -creditedCents});
+        }
+        legs.push_back({destination, recipient.currency, creditedCents});
+        recipientName = recipient.owner;
+    } else {
+        legs.push_back({"ext:" + toCard, it->currency, cents});
+    }
+
+    Transaction t;
+    t.id = IdAllocator::instance().nextTransactionId();
+    t.fromAccount = fromAccount;
+    t.toCard = toCard;
+    t.cents = cents;
+    t.timestamp = at ? at : std::time(nullptr);
+    t.note = note;
+    t.category = category;
+    t.status = "completed";
+    t.cancelReason.clear();
+    t.rate = appliedRate == kRateScale ? 0 : appliedRate;
+    t.creditedCents = recipientName.empty() ? 0 : creditedCents;
+    ledger.post(t.id, "transfer", std::move(legs), note, category);
+    syncLedgerBalances(sender);
+    sender.history.push_back(t);
+    limits.record(fromAccount, toCard, cents);
+    limits.flag(t, sender.usernameValue, verdict.flags);
+    return t;
+}
+
 void BankController::payFavorite(const QString &favName, const QString &fromAccount, qlonglong cents, const QString &category) {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
-        auto it = std::find_if(currentUser->favorites.begin(), currentUser->favorites.end(), [&](const FavoritePayment &f){
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        auto it = std::find_if(user->favorites.begin(), user->favorites.end(), [&](const FavoritePayment &f){
             return f.name == favName.toStdString();
         });
-        if (it == currentUser->favorites.end()) throw ValidationError("Нет такого избранного платежа");
+        if (it == user->favorites.end()) throw ValidationError("Нет такого избранного платежа");
         transfer(fromAccount, QString::fromStdString(it->toCard), cents, QString::fromStdString(it->note), category);
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
     }
 }
 
-void BankController::depositToAccount(const QString &accountNumber, qlonglong cents, const QString &externalAccount) {
+QString BankController::schedulePayment(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note,
+                                        const QString &category, const QString &repeat, int dayOfMonth, qlonglong firstRunTs) {
+    try {
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        ScheduledPayment p;
+        p.fromAccount = fromAccount.toStdString();
+        p.toCard = toCard.trimmed().toStdString();
+        p.cents = cents;
+        p.note = note.toStdString();
+        p.category = category.isEmpty() ? "other" : category.toStdString();
+        p.repeat = repeat.isEmpty() ? "once" : repeat.trimmed().toLower().toStdString();
+        p.dayOfMonth = dayOfMonth;
+        p.nextRun = firstRunTs > 0 ? static_cast<std::time_t>(firstRunTs) : std::time(nullptr);
+        return addSchedule(p);
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+        return QString();
+    }
+}
+
+QString BankController::scheduleFavorite(const QString &favName, const QString &fromAccount, qlonglong cents, const QString &category,
+                                         const QString &repeat, int dayOfMonth, qlonglong firstRunTs) {
+    try {
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        auto it = std::find_if(user->favorites.begin(), user->favorites.end(), [&](const FavoritePayment &f){
+            return f.name == favName.toStdString();
+        });
+        if (it == user->favorites.end()) throw ValidationError("Нет такого избранного платежа");
+        ScheduledPayment p;
+        p.fromAccount = fromAccount.toStdString();
+        p.toCard = it->toCard;
+        p.cents = cents;
+        p.note = it->note;
+        p.category = category.isEmpty() ? "other" : category.toStdString();
+        p.repeat = repeat.isEmpty() ? "once" : repeat.trimmed().toLower().toStdString();
+        p.dayOfMonth = dayOfMonth;
+        p.nextRun = firstRunTs > 0 ? static_cast<std::time_t>(firstRunTs) : std::time(nullptr);
+        p.favorite = it->name;
+        return addSchedule(p);
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+        return QString();
+    }
+}
+
+QVariantList BankController::listSchedules() const {
+    QVariantList out;
+    auto user = current();
+    if (!user) return out;
+    for (const auto &p : ScheduleStore::instance().forOwner(user->usernameValue)) {
+        out.push_back(schema::toVariantMap(p));
+    }
+    return out;
+}
+
+void BankController::cancelSchedule(const QString &scheduleId) {
+    try {
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        if (!ScheduleStore::instance().remove(scheduleId.trimmed().toStdString(), user->usernameValue)) {
+            throw NotFoundError("Поручение не найдено");
+        }
+        armScheduleTimer();
+        emit infoMessage("Поручение отменено");
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+QString BankController::addSchedule(ScheduledPayment p) {
+    auto user = current();
+    if (!user) throw AuthError("Необходима авторизация");
+    auto acc = std::find_if(user->accounts.begin(), user->accounts.end(), [&](const Account &a){
+        return a.accountNumber == p.fromAccount;
+    });
+    if (acc == user->accounts.end()) throw ValidationError("Нет такого счета");
+    if (p.cents <= 0) throw ValidationError("Сумма должна быть положительной");
+    if (p.toCard.empty()) throw ValidationError("Укажите получателя");
+    requireLedgerField(p.toCard, "Реквизиты получателя");
+    requireLedgerField(p.category, "Категория");
+    if (p.repeat != "once" && p.repeat != "daily" && p.repeat != "monthly") throw ValidationError("Периодичность: once, daily или monthly");
+    if (p.repeat == "monthly" && (p.dayOfMonth < 1 || p.dayOfMonth > 31)) throw ValidationError("День месяца должен быть от 1 до 31");
+    p.id = IdAllocator::instance().nextScheduleId();
+    p.owner = user->usernameValue;
+    ScheduleStore::instance().add(p);
+    armScheduleTimer();
+    emit infoMessage("Поручение создано");
+    return QString::fromStdString(p.id);
+}
+
+void BankController::runDueSchedules() {
+    auto &store = ScheduleStore::instance();
+    std::time_t now = std::time(nullptr);
+    auto due = store.takeDue(now);
+    if (due.empty()) {
+        armScheduleTimer();
+        return;
+    }
+
+    // Пачка по владельцу: каждый пользователь загружается и сохраняется один раз
+    std::map<std::string, std::vector<ScheduledPayment>> byOwner;
+    for (auto &p : due) byOwner[p.owner].push_back(std::move(p));
+
+    int executed = 0;
+    for (auto &[owner, payments] : byOwner) {
+        std::vector<std::string> failures;
+        std::vector<std::pair<Transaction, std::string>> done;
+        bool loaded = false;
+        try {
+            updateShown(owner, [&](RegularUser &user){
+                loaded = true;
+                for (const auto &p : payments) {
+                    std::time_t at = p.nextRun;
+                    // после простоя исполняем пропущенные запуски, но не больше kMaxCatchUp за раз;
+                    // каждый запуск датируется своим плановым временем, а не временем исполнения
+                    for (int runs = 0; at != 0 && at <= now && runs < kMaxCatchUp; ++runs) {
+                        try {
+                            std::string recipientName;
+                            auto note = p.note.empty() ? std::string("Плановый платеж ") + p.id : p.note;
+                            done.emplace_back(executeTransfer(user, p.fromAccount, p.toCard, p.cents, note, p.category, recipientName, at), recipientName);
+                        } catch (const std::exception &e) {
+                            failures.push_back("Плановый платеж " + p.id + " не выполнен: " + e.what());
+                        }
+                        at = p.following(at);
+                    }
+                    while (at != 0 && at <= now) at = p.following(at);
+                    store.reschedule(p.id, at);
+                }
+            });
+        } catch (const std::exception &e) {
+            if (!loaded) {
+                for (const auto &p : payments) store.reschedule(p.id, 0);
+            } else {
+                emit errorOccured(QString::fromStdString(e.what()));
+            }
+            continue;
+        }
+        for (const auto &[t, recipientName] : done) {
+            if (recipientName != owner) mirrorBalances(recipientName);
+            AnalyticsStore::instance().record(LedgerEventKind::Transfer, t, owner, recipientName);
+        }
+        executed += static_cast<int>(done.size());
+        if (owner == currentName) {
+            syncAccountsRows();
+            for (const auto &entry : done) appendRow(historyRows, "history", historyRow(entry.first));
+        }
+        for (const auto &message : failures) notify(owner, message);
+    }
+    store.save();
+    if (executed > 0) emit infoMessage(QString("Выполнено плановых платежей: %1").arg(executed));
+    armScheduleTimer();
+}
+
+void BankController::armScheduleTimer() {
+    std::time_t next = ScheduleStore::instance().nextDue();
+    if (next == 0) {
+        scheduleTimer->stop();
+        return;
+    }
+    long long delayMs = (static_cast<long long>(next) - static_cast<long long>(std::time(nullptr))) * 1000;
+    // QTimer принимает int: дальние запуски перевзводим раз в сутки
+    delayMs = std::clamp<long long>(delayMs, 0, 24LL * 3600 * 1000);
+    scheduleTimer->start(static_cast<int>(delayMs));
+}
+
+QString BankController::depositToAccount(const QString &accountNumber, qlonglong cents, const QString &externalAccount,
+                                         const QString &idempotencyKey) {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
         if (cents <= 0) throw ValidationError("Сумма должна быть положительной");
         auto accountId = accountNumber.toStdString();
-        auto it = std::find_if(currentUser->accounts.begin(), currentUser->accounts.end(), [&](const Account &a){
+        auto it = std::find_if(user->accounts.begin(), user->accounts.end(), [&](const Account &a){
             return a.accountNumber == accountId;
         });
-        if (it == currentUser->accounts.end()) throw ValidationError("Нет такого счета");
-        it->balanceCents += cents;
+        if (it == user->accounts.end()) throw ValidationError("Нет такого счета");
+        requireLedgerField(externalAccount.toStdString(), "Счет списания");
+        auto key = idempotencyKey.trimmed().toStdString();
+        std::string fingerprint;
+        if (!key.empty()) {
+            fingerprint = IdempotencyStore::fingerprint({accountId, std::to_string(cents), externalAccount.toStdString()});
+            QString original;
+            if (replayIdempotent(key, "deposit", fingerprint, original)) return original;
+        }
 
         Transaction t;
-        t.id = generateNumericId(12);
+        t.id = IdAllocator::instance().nextTransactionId();
         t.fromAccount = externalAccount.toStdString();
         t.toCard = accountId;
         t.cents = cents;
@@ -276,11 +694,22 @@ void BankController::depositToAccount(const QString &accountNumber, qlonglong ce
         t.note = "Пополнение счета";
         t.category = "other";
         t.status = "completed";
-        currentUser->history.push_back(t);
-        saveCurrent();
+        auto currency = it->currency;
+        updateShown(currentName, [&](RegularUser &u){
+            syncLedgerBalances(u);
+            PostingLedger::instance().post(t.id, "deposit", {{"ext:" + t.fromAccount, currency, -cents}, {accountId, currency, cents}}, t.note, t.category);
+            syncLedgerBalances(u);
+            u.history.push_back(t);
+            if (!key.empty()) IdempotencyStore::instance().remember(currentName, key, {"deposit", fingerprint, t.id, "Счет пополнен"});
+        });
+        syncAccountsRows();
+        appendRow(historyRows, "history", historyRow(t));
+        AnalyticsStore::instance().record(LedgerEventKind::Deposit, t, std::string(), user->usernameValue);
         emit infoMessage("Счет пополнен");
+        return QString::fromStdString(t.id);
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
+        return QString();
     }
 }
 
@@ -297,133 +726,117 @@ QStringList BankController::listUsers() const {
     return out;
 }
 
-QStringList BankController::searchUsers(const QString &query) const {
+QStringList BankController::searchUsers(const QString &query, int offset, int limit) const {
     QStringList out;
     if (!isAdminLogin) return out;
-    auto q = query.trimmed().toStdString();
-    for (const auto &name : UserStorage::listUsernames()) {
-        if (name.find(q) != std::string::npos) out.push_back(QString::fromStdString(name));
-    }
+    auto page = UserStorage::searchUsernames(query.trimmed().toStdString(), static_cast<std::size_t>(std::max(offset, 0)),
+                                             static_cast<std::size_t>(limit > 0 ? limit : 50));
+    for (const auto &name : page.names) out.push_back(QString::fromStdString(name));
     return out;
 }
 
+int BankController::searchUsersCount(const QString &query) const {
+    if (!isAdminLogin) return 0;
+    return static_cast<int>(UserStorage::searchUsernames(query.trimmed().toStdString(), 0, 0).total);
+}
+
+void BankController::deleteUser(const QString &username) {
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        auto uname = username.trimmed().toStdString();
+        if (uname.empty()) throw ValidationError("Пустое имя пользователя");
+        auto &repo = UserRepository::instance();
+        std::vector<std::string> accounts;
+        for (const auto &a : repo.peek(uname)->accounts) accounts.push_back(a.accountNumber);
+        // сначала выгрузка: отложенная запись не должна вернуть удаленный файл
+        repo.remove(uname);
+        UserStorage::removeUser(uname);
+        // все, что хранится по имени, уходит вместе с пользователем: зарегистрированный
+        // заново под тем же именем начинает с пустого места
+        PostingLedger::instance().closeOwner(uname);
+        HistoryArchive::remove(uname);
+        NotificationStore::instance().clear(uname);
+        ScheduleStore::instance().removeOwner(uname);
+        IdempotencyStore::instance().forgetOwner(uname);
+        VelocityRules::instance().forget(accounts);
+        armScheduleTimer();
+        invalidateViews();
+        restartSearch();
+        emit infoMessage("Пользователь удален");
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
 QStringList BankController::sortUsersByAccountCount() const {
-    QStringList out;
-    if (!isAdminLogin) return out;
-    auto users = UserStorage::loadAll();
-    std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-        if (a.accounts.size() == b.accounts.size()) return a.usernameValue < b.usernameValue;
-        return a.accounts.size() < b.accounts.size();
-    });
-    for (const auto &u : users) out << QString::fromStdString(u.usernameValue);
-    return out;
+    return sortUsers("accounts");
 }
 
 QStringList BankController::sortUsers(const QString &sortBy) const {
     QStringList out;
     if (!isAdminLogin) return out;
-    auto users = UserStorage::loadAll();
     std::string sort = sortBy.trimmed().toLower().toStdString();
-    
-    if (sort == "accounts" || sort == "счета") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.accounts.size() == b.accounts.size()) return a.usernameValue < b.usernameValue;
-            return a.accounts.size() < b.accounts.size();
-        });
-    } else if (sort == "cards" || sort == "карты") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.cards.size() == b.cards.size()) return a.usernameValue < b.usernameValue;
-            return a.cards.size() < b.cards.size();
-        });
-    } else if (sort == "transactions" || sort == "транзакции" || sort == "переводы") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.history.size() == b.history.size()) return a.usernameValue < b.usernameValue;
-            return a.history.size() < b.history.size();
-        });
-    } else {
-        // По умолчанию сортировка по имени
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            return a.usernameValue < b.usernameValue;
-        });
-    }
-    
-    for (const auto &u : users) out << QString::fromStdString(u.usernameValue);
+    // для сортировки хватает размеров разделов: записи не разбираются
+    std::vector<std::pair<std::size_t, std::string>> keyed;
+    syncUserFiles();
+    UserStorage::forEachUser([&](const UserView &u) {
+        keyed.emplace_back(userSortKey(u, sort), std::string(u.username));
+    }, SectionNone);
+    std::sort(keyed.begin(), keyed.end());
+    for (const auto &[key, name] : keyed) out << QString::fromStdString(name);
     return out;
 }
 
 QVariantList BankController::getAllUsersInfo(const QString &sortBy) const {
+    if (!isAdminLogin) return QVariantList();
+    return usersInfo(sortBy);
+}
+
+// Не трогает состояние контроллера — считается и в фоновом потоке (prefetchStep)
+QVariantList BankController::usersInfo(const QString &sortBy) {
     QVariantList out;
-    if (!isAdminLogin) return out;
-    
-    auto users = UserStorage::loadAll();
+    auto totals = BalanceTable::instance().totalsByOwner();
     std::string sort = sortBy.trimmed().toLower().toStdString();
+    struct Entry {
+        std::size_t key;
+        std::string name;
+        QVariantMap info;
+    };
+    std::vector<Entry> entries;
     
-    // Сортировка
-    if (sort == "accounts" || sort == "счета") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.accounts.size() == b.accounts.size()) return a.usernameValue < b.usernameValue;
-            return a.accounts.size() < b.accounts.size();
-        });
-    } else if (sort == "cards" || sort == "карты") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.cards.size() == b.cards.size()) return a.usernameValue < b.usernameValue;
-            return a.cards.size() < b.cards.size();
-        });
-    } else if (sort == "transactions" || sort == "транзакции" || sort == "переводы") {
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            if (a.history.size() == b.history.size()) return a.usernameValue < b.usernameValue;
-            return a.history.size() < b.history.size();
-        });
-    } else {
-        // По умолчанию сортировка по имени
-        std::sort(users.begin(), users.end(), [](const RegularUser &a, const RegularUser &b){
-            return a.usernameValue < b.usernameValue;
-        });
-    }
-    
-    // Формируем список с полной информацией
-    for (const auto &u : users) {
+    // Формируем список с полной информацией; история и избранное нужны только числом
+    syncUserFiles();
+    UserStorage::forEachUser([&](const UserView &u) {
         QVariantMap m;
-        m["username"] = QString::fromStdString(u.usernameValue);
-        m["accountsCount"] = static_cast<int>(u.accounts.size());
-        m["cardsCount"] = static_cast<int>(u.cards.size());
-        m["transactionsCount"] = static_cast<int>(u.history.size());
-        m["favoritesCount"] = static_cast<int>(u.favorites.size());
-        m["notificationsCount"] = static_cast<int>(u.notifications.size());
+        m["username"] = schema::toQString(u.username);
+        m["accountsCount"] = static_cast<int>(u.sizes.accounts);
+        m["cardsCount"] = static_cast<int>(u.sizes.cards);
+        m["transactionsCount"] = static_cast<int>(u.sizes.history);
+        m["favoritesCount"] = static_cast<int>(u.sizes.favorites);
+        m["notificationsCount"] = static_cast<int>(NotificationStore::instance().count(std::string(u.username)) + u.notifications);
         
-        // Подсчитываем общий баланс
-        long long totalBalance = 0;
-        for (const auto &acc : u.accounts) {
-            totalBalance += acc.balanceCents;
-        }
-        m["totalBalance"] = static_cast<qlonglong>(totalBalance);
+        // Общий баланс — из таблицы балансов
+        auto total = totals.find(std::string(u.username));
+        m["totalBalance"] = static_cast<qlonglong>(total != totals.end() ? total->second : 0);
         
         // Список счетов
         QVariantList accountsList;
-        for (const auto &acc : u.accounts) {
-            QVariantMap accMap;
-            accMap["accountNumber"] = QString::fromStdString(acc.accountNumber);
-            accMap["currency"] = QString::fromStdString(acc.currency);
-            accMap["balanceCents"] = static_cast<qlonglong>(acc.balanceCents);
-            accountsList.append(accMap);
-        }
+        for (const auto &acc : u.accounts) accountsList.append(schema::toVariantMap(acc));
         m["accounts"] = accountsList;
         
         // Список карт
         QVariantList cardsList;
-        for (const auto &card : u.cards) {
-            QVariantMap cardMap;
-            cardMap["cardNumber"] = QString::fromStdString(card.cardNumber);
-            cardMap["holderName"] = QString::fromStdString(card.holderName);
-            cardMap["expiry"] = QString::fromStdString(card.expiry);
-            cardMap["linkedAccount"] = QString::fromStdString(card.linkedAccount);
-            cardsList.append(cardMap);
-        }
+        for (const auto &card : u.cards) cardsList.append(schema::toVariantMap(card));
         m["cards"] = cardsList;
         
-        out.append(m);
-    }
+        entries.push_back({userSortKey(u, sort), std::string(u.username), std::move(m)});
+    }, SectionAccounts | SectionCards);
     
+    // Сортировка
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b){
+        return a.key != b.key ? a.key < b.key : a.name < b.name;
+    });
+    for (auto &e : entries) out.append(std::move(e.info));
     return out;
 }
 
@@ -432,24 +845,11 @@ QVariantList BankController::sortTransfers(const QString &sortBy) const {
     if (!isAdminLogin) return out;
     
     std::string sort = sortBy.trimmed().toLower().toStdString();
-    auto users = UserStorage::loadAll();
     std::vector<QVariantMap> transfers;
-    
-    for (const auto &u : users) {
-        for (const auto &t : u.history) {
-            QVariantMap m;
-            m["user"] = QString::fromStdString(u.usernameValue);
-            m["id"] = QString::fromStdString(t.id);
-            m["fromAccount"] = QString::fromStdString(t.fromAccount);
-            m["toCard"] = QString::fromStdString(t.toCard);
-            m["cents"] = static_cast<qlonglong>(t.cents);
-            m["timestamp"] = static_cast<qlonglong>(t.timestamp);
-            m["note"] = QString::fromStdString(t.note);
-            m["status"] = QString::fromStdString(t.status);
-            m["cancelReason"] = QString::fromStdString(t.cancelReason);
-            transfers.push_back(m);
-        }
-    }
+    syncUserFiles();
+    UserStorage::forEachTransaction([&](const UserView &u, const TransactionView &t) {
+        transfers.push_back(transferRow(u.username, t));
+    });
     
     if (sort == "user" || sort == "пользователь") {
         std::sort(transfers.begin(), transfers.end(), [](const QVariantMap &a, const QVariantMap &b){
@@ -491,41 +891,36 @@ QVariantList BankController::sortTransfers(const QString &sortBy) const {
 QVariantMap BankController::receiptFor(const QString &transactionId) const {
     QVariantMap out;
     std::string txId = transactionId.trimmed().toStdString();
-    auto build = [&](const RegularUser &u, const Transaction &t) {
-        QVariantMap m;
-        m["user"] = QString::fromStdString(u.usernameValue);
-        m["id"] = QString::fromStdString(t.id);
-        m["fromAccount"] = QString::fromStdString(t.fromAccount);
-        m["toCard"] = QString::fromStdString(t.toCard);
-        m["cents"] = static_cast<qlonglong>(t.cents);
-        m["timestamp"] = static_cast<qlonglong>(t.timestamp);
-        m["note"] = QString::fromStdString(t.note);
-        m["status"] = QString::fromStdString(t.status);
-        m["cancelReason"] = QString::fromStdString(t.cancelReason);
-        return m;
-    };
 
     if (isAdminLogin) {
-        for (const auto &user : UserStorage::loadAll()) {
-            auto it = std::find_if(user.history.begin(), user.history.end(), [&](const Transaction &t){ return t.id == txId; });
-            if (it != user.history.end()) {
-                return build(user, *it);
-            }
-        }
-    } else if (currentUser) {
-        auto it = std::find_if(currentUser->history.begin(), currentUser->history.end(), [&](const Transaction &t){ return t.id == txId; });
-        if (it != currentUser->history.end()) {
-            return build(*currentUser, *it);
+        // обход останавливается на первой найденной операции
+        syncUserFiles();
+        UserStorage::forEachTransaction([&](const UserView &u, const TransactionView &t) {
+            if (t.id != txId) return true;
+            out = transferRow(u.username, t);
+            return false;
+        });
+        if (!out.isEmpty()) return out;
+        // архив проверяется только после живых историй, по индексу id — один блок
+        std::string owner;
+        Transaction t;
+        if (HistoryArchive::find(txId, owner, t)) return transferRow(owner, t);
+    } else if (auto user = current()) {
+        auto it = std::find_if(user->history.begin(), user->history.end(), [&](const Transaction &t){ return t.id == txId; });
+        if (it != user->history.end()) {
+            return transferRow(user->usernameValue, *it);
         }
+        Transaction t;
+        if (HistoryArchive::find(user->usernameValue, txId, t)) return transferRow(user->usernameValue, t);
     }
     return out;
 }
 
 QString BankController::downloadReceipt(const QString &transactionId) {
     // Старый метод для обратной совместимости - сохраняет в data/receipts
-    std::filesystem::create_directories("data/receipts");
-    auto filename = "data/receipts/receipt_" + transactionId.trimmed().toStdString() + ".txt";
-    return saveReceiptToFile(transactionId, QString::fromStdString(filename));
+    std::filesystem::create_directories(receiptsRoot());
+    auto filename = receiptsRoot() / ("receipt_" + transactionId.trimmed().toStdString() + ".txt");
+    return saveReceiptToFile(transactionId, QString::fromStdString(filename.string()));
 }
 
 QString BankController::saveReceiptToFile(const QString &transactionId, const QString &filePath) {
@@ -572,17 +967,37 @@ QString BankController::saveReceiptToFile(const QString &transactionId, const QS
     }
 }
 
+QVariantList BankController::listArchivedHistory(qlonglong fromTs, qlonglong toTs) const {
+    QVariantList out;
+    auto user = current();
+    if (!user) return out;
+    try {
+        for (const auto &t : HistoryArchive::range(user->usernameValue, fromTs, toTs)) out.push_back(historyRow(t));
+    } catch (...) {
+    }
+    return out;
+}
+
+QString BankController::archivedReceipt(const QString &transactionId) const {
+    std::string text;
+    if (!HistoryArchive::readReceipt("receipt_" + transactionId.trimmed().toStdString(), text)) return QString();
+    return QString::fromStdString(text);
+}
+
 QVariantMap BankController::getExpenseStats() const {
-    QVariantMap stats;
-    if (!currentUser) return stats;
-    
+    auto user = current();
+    return user ? expenseStats(*user) : QVariantMap();
+}
+
+// Не трогает состояние контроллера — считается и в фоновом потоке (prefetchStep)
+QVariantMap BankController::expenseStats(const RegularUser &user) {
     std::unordered_map<std::string, long long> categoryTotals;
-    for (const auto &t : currentUser->history) {
+    for (const auto &t : user.history) {
         if (t.cents > 0 && t.status == "completed") {
             // Учитываем только исходящие переводы (не пополнения)
             // Пополнения имеют fromAccount как внешний счет, а toCard как наш счет
             bool isOutgoing = false;
-            for (const auto &acc : currentUser->accounts) {
+            for (const auto &acc : user.accounts) {
                 if (acc.accountNumber == t.fromAccount) {
                     isOutgoing = true;
                     break;
@@ -621,28 +1036,84 @@ QVariantMap BankController::getExpenseStats() const {
     return result;
 }
 
-QVariantList BankController::listNotifications() const {
+QVariantList BankController::listNotifications(qlonglong beforeId, int limit) const {
     QVariantList out;
-    if (!currentUser) return out;
-    for (const auto &n : currentUser->notifications) {
-        QVariantMap m;
-        m["message"] = QString::fromStdString(n);
-        out.push_back(m);
-    }
+    auto user = current();
+    if (!user) return out;
+    auto &store = NotificationStore::instance();
+    long long cursor = store.readCursor(user->usernameValue);
+    auto page = store.page(user->usernameValue, beforeId, static_cast<std::size_t>(limit > 0 ? limit : 50));
+    for (const auto &n : page) out.push_back(notificationRow(n, cursor));
+    return out;
+}
+
+QVariantList BankController::listNotificationsSince(qlonglong afterId) const {
+    QVariantList out;
+    auto user = current();
+    if (!user) return out;
+    auto &store = NotificationStore::instance();
+    long long cursor = store.readCursor(user->usernameValue);
+    for (const auto &n : store.since(user->usernameValue, afterId)) out.push_back(notificationRow(n, cursor));
     return out;
 }
 
+int BankController::unreadNotifications() const {
+    auto user = current();
+    if (!user) return 0;
+    return static_cast<int>(NotificationStore::instance().unreadCount(user->usernameValue));
+}
+
+void BankController::markNotificationsRead(qlonglong upToId) {
+    try {
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        auto &store = NotificationStore::instance();
+        store.markRead(user->usernameValue, upToId);
+        long long cursor = store.readCursor(user->usernameValue);
+        for (int i = 0; i < notificationsRows->count(); ++i) {
+            auto row = notificationsRows->get(i);
+            if (row.value("unread").toBool() && row.value("id").toLongLong() <= cursor) {
+                row["unread"] = false;
+                notificationsRows->setRow(i, row);
+                emit collectionChanged("notifications", "changed", i, notificationsRows->revision());
+            }
+        }
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
 void BankController::clearNotifications() {
     try {
-        if (!currentUser) throw AuthError("Необходима авторизация");
-        currentUser->notifications.clear();
-        saveCurrent();
+        auto user = current();
+        if (!user) throw AuthError("Необходима авторизация");
+        NotificationStore::instance().clear(user->usernameValue);
+        notificationsRows->setRows({});
+        emit collectionChanged("notifications", "reset", -1, notificationsRows->revision());
         emit infoMessage("Уведомления очищены");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
     }
 }
 
+void BankController::notify(const std::string &username, const std::string &message) {
+    try {
+        auto id = NotificationStore::instance().append(username, message);
+        if (username == currentName) {
+            NotificationEntry entry{id, std::time(nullptr), message};
+            appendRow(notificationsRows, "notifications", notificationRow(entry, 0));
+        }
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+void BankController::migrateLegacyNotifications(RegularUser &user) {
+    if (user.notifications.empty()) return;
+    for (const auto &message : user.notifications) NotificationStore::instance().append(user.usernameValue, message);
+    user.notifications.clear();
+}
+
 void BankController::cancelTransfer(const QString &transactionId, const QString &reason) {
     try {
         if (!isAdminLogin) throw AuthError("Только администратор может отменять платежи");
@@ -651,74 +1122,607 @@ void BankController::cancelTransfer(const QString &transactionId, const QString
         if (txId.empty()) throw ValidationError("Укажите платеж");
         if (reasonStd.empty()) throw ValidationError("Укажите причину отмены");
 
+        // владелец операции — по ее первому внутреннему счету в журнале; старые операции ищутся обходом
+        auto &ledger = PostingLedger::instance();
+        LedgerEntry posted;
+        if (!ledger.find(txId, "transfer", posted)) ledger.find(txId, "deposit", posted);
+        std::vector<std::string> candidates;
+        for (const auto &leg : posted.legs) {
+            LedgerAccount owner;
+            if (ledger.account(leg.account, owner)) {
+                candidates.push_back(owner.owner);
+                break;
+            }
+        }
+        if (candidates.empty()) candidates = UserStorage::listUsernames();
+
+        auto &repo = UserRepository::instance();
         bool found = false;
-        for (const auto &name : UserStorage::listUsernames()) {
-            RegularUser user = UserStorage::loadUser(name);
-            auto it = std::find_if(user.history.begin(), user.history.end(), [&](const Transaction &t){ return t.id == txId; });
-            if (it != user.history.end()) {
+        for (const auto &name : candidates) {
+            // поиск по снимку, изменение — новой версией владельца
+            auto snapshot = repo.peek(name);
+            auto &history = snapshot->history;
+            if (std::none_of(history.begin(), history.end(), [&](const Transaction &t){ return t.id == txId; })) continue;
+
+            std::string recipientName;
+            Transaction cancelled;
+            repo.update(name, [&](RegularUser &user){
+                auto it = std::find_if(user.history.begin(), user.history.end(), [&](const Transaction &t){ return t.id == txId; });
+                if (it == user.history.end()) throw NotFoundError("Платеж не найден");
                 if (it->status == "cancelled") throw ValidationError("Платеж уже отменен");
-                auto accIt = std::find_if(user.accounts.begin(), user.accounts.end(), [&](const Account &a){ return a.accountNumber == it->fromAccount; });
-                if (accIt != user.accounts.end()) accIt->balanceCents += it->cents;
-                it->status = "cancelled";
-                it->cancelReason = reasonStd;
-                user.notifications.push_back("Платеж " + it->id + " отменен: " + reasonStd);
-                UserStorage::saveUser(user);
-
-                // снять деньги у получателя
-                std::string recipientName;
-                if (adjustRecipientBalance(it->toCard, -it->cents, &recipientName) && !recipientName.empty() && recipientName != user.usernameValue) {
-                    try {
-                        RegularUser recipient = UserStorage::loadUser(recipientName);
-                        recipient.notifications.push_back("Платеж " + it->id + " отменен администратором. Причина: " + reasonStd);
-                        UserStorage::saveUser(recipient);
-                    } catch (...) {}
-                }
-                found = true;
-                break;
+                recipientName = reverseTransaction(user, *it, reasonStd);
+                syncLedgerBalances(user);
+                cancelled = *it;
+            });
+            notify(name, "Платеж " + cancelled.id + " отменен: " + reasonStd);
+            if (!recipientName.empty() && recipientName != name) {
+                mirrorBalances(recipientName);
+                notify(recipientName, "Платеж " + cancelled.id + " отменен администратором. Причина: " + reasonStd);
             }
+            AnalyticsStore::instance().record(LedgerEventKind::Cancel, cancelled, name, recipientName);
+            found = true;
+            break;
         }
-        if (!found) throw NotFoundError("Платеж не найден");
+        if (!found) {
+            Transaction archived;
+            if (candidates.size() == 1 && HistoryArchive::find(candidates.front(), txId, archived)) {
+                throw ValidationError("Платеж в архиве, отмена невозможна");
+            }
+            throw NotFoundError("Платеж не найден");
+        }
+        invalidateViews();
+        restartSearch();
         emit infoMessage("Платеж отменен");
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
     }
 }
 
+// filter: toCard — карта/счет получателя, fromAccount — счет отправителя, user — владелец,
+// fromTs/toTs — полуинтервал времени, ids — список операций. Подходящие операции находятся
+// одним потоковым проходом по файлам, затем каждый владелец меняется одной записью файла
+QVariantMap BankController::cancelTransfers(const QVariantMap &filter, const QString &reason, bool dryRun) {
+    QVariantMap out;
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор может отменять платежи");
+        std::string reasonStd = reason.trimmed().toStdString();
+        if (!dryRun && reasonStd.empty()) throw ValidationError("Укажите причину отмены");
+        std::string toCard = filter.value("toCard").toString().trimmed().toStdString();
+        std::string fromAccount = filter.value("fromAccount").toString().trimmed().toStdString();
+        std::string owner = filter.value("user").toString().trimmed().toStdString();
+        long long fromTs = filter.value("fromTs").toLongLong();
+        long long toTs = filter.value("toTs").toLongLong();
+        std::unordered_set<std::string> ids;
+        for (const auto &id : filter.value("ids").toStringList()) {
+            if (!id.trimmed().isEmpty()) ids.insert(id.trimmed().toStdString());
+        }
+        if (toCard.empty() && fromAccount.empty() && owner.empty() && !fromTs && !toTs && ids.empty()) {
+            throw ValidationError("Укажите хотя бы одно условие отбора");
+        }
+
+        std::map<std::string, std::unordered_set<std::string>> byOwner;
+        QVariantList preview;
+        long long count = 0, sumCents = 0;
+        syncUserFiles();
+        UserStorage::forEachTransaction([&](const UserView &u, const TransactionView &t) {
+            if (t.status == "cancelled") return;
+            if (!owner.empty() && u.username != owner) return;
+            if (!toCard.empty() && t.toCard != toCard) return;
+            if (!fromAccount.empty() && t.fromAccount != fromAccount) return;
+            if (fromTs && t.timestamp < fromTs) return;
+            if (toTs && t.timestamp >= toTs) return;
+            if (!ids.empty() && !ids.count(std::string(t.id))) return;
+            byOwner[std::string(u.username)].insert(std::string(t.id));
+            ++count;
+            sumCents += t.cents;
+            if (preview.size() < 200) preview.push_back(transferRow(u.username, t));
+        });
+
+        long long cancelled = 0, cancelledCents = 0;
+        if (!dryRun) {
+            auto &repo = UserRepository::instance();
+            std::unordered_set<std::string> recipients;
+            for (const auto &[name, wanted] : byOwner) {
+                std::vector<std::pair<Transaction, std::string>> done;  // операция и получатель
+                repo.update(name, [&](RegularUser &user){
+                    done.clear();
+                    for (auto &t : user.history) {
+                        // статус перепроверяется по живой версии: операцию могли отменить после прохода
+                        if (!wanted.count(t.id) || t.status == "cancelled") continue;
+                        std::string recipientName = reverseTransaction(user, t, reasonStd);
+                        done.emplace_back(t, recipientName);
+                    }
+                    syncLedgerBalances(user);
+                });
+                if (done.empty()) continue;
+                std::string ownerMessage = done.size() == 1 ? "Платеж " + done.front().first.id + " отменен: " + reasonStd
+                                                            : "Отменено платежей: " + std::to_string(done.size()) + ". Причина: " + reasonStd;
+                notify(name, ownerMessage);
+                std::map<std::string, std::size_t> perRecipient;
+                for (const auto &[t, recipientName] : done) {
+                    ++cancelled;
+                    cancelledCents += t.cents;
+                    AnalyticsStore::instance().record(LedgerEventKind::Cancel, t, name, recipientName);
+                    if (!recipientName.empty() && recipientName != name) {
+                        ++perRecipient[recipientName];
+                        recipients.insert(recipientName);
+                    }
+                }
+                for (const auto &[recipientName, n] : perRecipient) {
+                    notify(recipientName, n == 1 ? "Платеж от " + name + " отменен администратором. Причина: " + reasonStd
+                                                 : "Отменено администратором платежей от " + name + ": " + std::to_string(n) + ". Причина: " + reasonStd);
+                }
+            }
+            // балансы получателей публикуются один раз, после всех сторно
+            for (const auto &name : recipients) mirrorBalances(name);
+        }
+
+        out["dryRun"] = dryRun;
+        out["matched"] = static_cast<qlonglong>(count);
+        out["matchedCents"] = static_cast<qlonglong>(sumCents);
+        out["users"] = static_cast<int>(byOwner.size());
+        out["cancelled"] = static_cast<qlonglong>(cancelled);
+        out["cancelledCents"] = static_cast<qlonglong>(cancelledCents);
+        out["items"] = preview;
+        if (!dryRun) {
+            invalidateViews();
+            restartSearch();
+            emit infoMessage(QString("Отменено платежей: %1").arg(cancelled));
+        }
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+    return out;
+}
+
+// Сторно операции владельца: те же ноги с обратным знаком, получатель списывается в своей
+// валюте. Балансы владельца не пересчитываются — это делает вызывающий. Возвращает получателя.
+// Зовется внутри update до записи файла: если запись не удалась, операция остается
+// неотмененной, а сторно — в журнале; повторная отмена находит его там и не проводит заново
+std::string BankController::reverseTransaction(const RegularUser &owner, Transaction &t, const std::string &reason) {
+    auto &ledger = PostingLedger::instance();
+    std::string recipientName;
+    LedgerEntry posted;
+    std::vector<PostingLeg> legs;
+    if (ledger.find(t.id, "transfer", posted) || ledger.find(t.id, "deposit", posted)) {
+        for (const auto &leg : posted.legs) {
+            legs.push_back({leg.account, leg.currency, -leg.cents});
+            LedgerAccount account;
+            if (ledger.account(leg.account, account) && account.owner != owner.usernameValue) recipientName = account.owner;
+        }
+    } else {
+        legs = reversalLegs(t, recipientName);
+    }
+    ledger.postOnce(t.id, "cancel", std::move(legs), reason, t.category);
+    t.status = "cancelled";
+    t.cancelReason = reason;
+    return recipientName;
+}
+
 void BankController::clearAllUsers() {
     try {
         if (!isAdminLogin) throw AuthError("Только администратор");
-        auto root = storage::usersRoot();
-        if (std::filesystem::exists(root)) {
-            for (auto &entry : std::filesystem::directory_iterator(root)) {
-                std::filesystem::remove_all(entry.path());
+        UserRepository::instance().clear();
+        UserStorage::clearAll();
+        AnalyticsStore::instance().clear();
+        PostingLedger::instance().clear();
+        HistoryArchive::clearAll();
+        IdempotencyStore::instance().clear();
+        ScheduleStore::instance().clear();
+        NotificationStore::instance().clearAll();
+        VelocityRules::instance().clear();
+        armScheduleTimer();
+        invalidateViews();
+        restartSearch();
+        emit infoMessage("Все пользователи удалены");
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+QVariantList BankController::listFlaggedTransfers() const {
+    QVariantList out;
+    if (!isAdminLogin) return out;
+    for (const auto &f : VelocityRules::instance().flagged()) {
+        QVariantMap m;
+        m["user"] = QString::fromStdString(f.username);
+        m["id"] = QString::fromStdString(f.transactionId);
+        m["fromAccount"] = QString::fromStdString(f.fromAccount);
+        m["toCard"] = QString::fromStdString(f.toCard);
+        m["cents"] = static_cast<qlonglong>(f.cents);
+        m["timestamp"] = static_cast<qlonglong>(f.timestamp);
+        m["code"] = QString::fromStdString(f.code);
+        out.push_back(m);
+    }
+    return out;
+}
+
+void BankController::reloadLimits() {
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        VelocityRules::instance().reload();
+        emit infoMessage("Лимиты перечитаны");
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+QVariantMap BankController::importLedger(const QString &filePath) {
+    QVariantMap out;
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        syncUserFiles();
+        auto report = BulkImporter::run(filePath.toStdString());
+        out["rows"] = static_cast<qlonglong>(report.rows);
+        out["accepted"] = static_cast<qlonglong>(report.accepted);
+        out["rejected"] = static_cast<qlonglong>(report.rejected);
+        out["users"] = static_cast<qlonglong>(report.users);
+        out["seconds"] = report.seconds;
+        out["rowsPerSecond"] = report.rowsPerSecond;
+        QStringList errors;
+        for (const auto &e : report.errors) errors << QString::fromStdString(e);
+        out["errors"] = errors;
+        invalidateViews();
+        restartSearch();
+        emit infoMessage(QString("Импортировано строк: %1 из %2, пользователей: %3 (%4 строк/с)")
+                             .arg(static_cast<qulonglong>(report.accepted)).arg(static_cast<qulonglong>(report.rows)).arg(static_cast<qulonglong>(report.users)).arg(static_cast<qlonglong>(report.rowsPerSecond)));
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+    return out;
+}
+
+QVariantMap BankController::reconcileLedger(bool full) {
+    QVariantMap out;
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        syncUserFiles();
+        auto report = Reconciler::run(full);
+        out["full"] = report.full;
+        out["from"] = static_cast<qlonglong>(report.from);
+        out["to"] = static_cast<qlonglong>(report.to);
+        out["usersChecked"] = static_cast<qlonglong>(report.usersChecked);
+        out["accountsChecked"] = static_cast<qlonglong>(report.accountsChecked);
+        out["postings"] = static_cast<qlonglong>(report.postings);
+        out["seconds"] = report.seconds;
+        QVariantList discrepancies;
+        for (const auto &d : report.discrepancies) {
+            QVariantMap m;
+            m["account"] = QString::fromStdString(d.account);
+            m["owner"] = QString::fromStdString(d.owner);
+            m["expectedCents"] = static_cast<qlonglong>(d.expectedCents);
+            m["actualCents"] = static_cast<qlonglong>(d.actualCents);
+            m["reason"] = QString::fromStdString(d.reason);
+            QStringList ids;
+            for (const auto &id : d.transactionIds) ids << QString::fromStdString(id);
+            m["transactionIds"] = ids;
+            discrepancies.push_back(m);
+        }
+        out["discrepancies"] = discrepancies;
+        if (report.discrepancies.empty()) {
+            emit infoMessage(QString("Сверка завершена: расхождений нет (счетов: %1)").arg(static_cast<qulonglong>(report.accountsChecked)));
+        } else {
+            emit errorOccured(QString("Сверка: расхождений %1, см. data/reconcile/report.txt").arg(static_cast<qulonglong>(report.discrepancies.size())));
+        }
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+    return out;
+}
+
+QVariantMap BankController::archiveHistory(int olderThanDays) {
+    QVariantMap out;
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        if (olderThanDays < 1) throw ValidationError("Срок должен быть не меньше дня");
+        auto sizeOf = [](const std::filesystem::path &root) {
+            std::uintmax_t total = 0;
+            std::error_code ec;
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root, ec)) {
+                if (entry.is_regular_file(ec)) total += entry.file_size(ec);
             }
+            return total;
+        };
+        auto before = sizeOf(usersRoot()) + sizeOf(receiptsRoot()) + sizeOf(archiveRoot());
+        std::time_t cutoff = std::time(nullptr) - static_cast<std::time_t>(olderThanDays) * 24 * 3600;
+        std::size_t users = 0, transactions = 0, blocks = 0;
+        auto &repo = UserRepository::instance();
+        for (const auto &name : UserStorage::listUsernames()) {
+            // только префикс истории и целыми блоками: сквозные номера операций не сдвигаются
+            auto archivable = [&](const RegularUser &user) {
+                auto old = std::find_if(user.history.begin(), user.history.end(), [&](const Transaction &t){ return t.timestamp >= cutoff; });
+                return static_cast<std::size_t>(old - user.history.begin()) / HistoryArchive::kBlockSize * HistoryArchive::kBlockSize;
+            };
+            if (archivable(*repo.peek(name)) == 0) continue;
+            std::size_t count = 0;
+            repo.update(name, [&](RegularUser &user){
+                count = archivable(user);
+                if (count == 0) return;
+                std::vector<Transaction> moved(user.history.begin(), user.history.begin() + static_cast<std::ptrdiff_t>(count));
+                // архив дописывается до записи файла; если она не удастся, операции останутся
+                // и в истории, а следующий перенос пропустит уже архивные (append) и дочистит ее
+                blocks += HistoryArchive::append(name, moved);
+                user.history.erase(user.history.begin(), user.history.begin() + static_cast<std::ptrdiff_t>(count));
+            });
+            if (count == 0) continue;
+            ++users;
+            transactions += count;
         }
-        emit infoMessage("Все пользователи удалены");
+        auto receipts = HistoryArchive::packReceipts();
+        auto after = sizeOf(usersRoot()) + sizeOf(receiptsRoot()) + sizeOf(archiveRoot());
+        out["users"] = static_cast<qlonglong>(users);
+        out["transactions"] = static_cast<qlonglong>(transactions);
+        out["blocks"] = static_cast<qlonglong>(blocks);
+        out["receipts"] = static_cast<qlonglong>(receipts);
+        out["bytesBefore"] = static_cast<qlonglong>(before);
+        out["bytesAfter"] = static_cast<qlonglong>(after);
+        invalidateViews();
+        restartSearch();
+        emit infoMessage(QString("В архив перенесено операций: %1, чеков: %2").arg(static_cast<qulonglong>(transactions)).arg(static_cast<qulonglong>(receipts)));
     } catch (const std::exception &e) {
         emit errorOccured(QString::fromStdString(e.what()));
     }
+    return out;
 }
 
-void BankController::saveCurrent() {
-    if (currentUser) {
-        UserStorage::saveUser(*currentUser);
+QVariant BankController::viewData(const QString &view, const QString &arg) {
+    std::string key = view.toStdString() + '\n' + arg.toStdString();
+    auto it = viewCache.find(key);
+    if (it == viewCache.end()) {
+        ++viewsFetched;
+        it = viewCache.emplace(key, ViewEntry{computeView(view, arg), false}).first;
+    } else if (it->second.prefetched) {
+        ++prefetchHits;
+        it->second.prefetched = false;
     }
+    schedulePrefetch(view);
+    return it->second.data;
 }
 
-QString BankController::ratesText() const {
+QVariant BankController::computeView(const QString &view, const QString &arg) const {
+    if (view == "adminTransfers") return listAllTransfers(arg);
+    if (view == "adminUsers") return getAllUsersInfo(arg);
+    if (view == "expenseStats") return getExpenseStats();
+    return QVariant();
+}
+
+// Вероятные следующие виды: у администратора — соседняя вкладка панели, у пользователя — статистика
+void BankController::schedulePrefetch(const QString &view) {
+    prefetchQueue.clear();
+    if (isAdminLogin) {
+        // переводы вкладка ищет сама через searchTransfers
+        if (view != "adminUsers") prefetchQueue.emplace_back("adminUsers", QString());
+    } else if (!currentName.empty() && view != "expenseStats") {
+        prefetchQueue.emplace_back("expenseStats", QString());
+    }
+    if (!prefetchQueue.empty()) idleTimer->start(0);
+}
+
+// Вид считается в пуле потоков: задача получает только снимок пользователя и аргументы,
+// а результат кладется в кэш в потоке контроллера, если кэш с тех пор не сбрасывался
+void BankController::prefetchStep() {
+    if (prefetchWatcher->isRunning()) return;
+    while (!prefetchQueue.empty()) {
+        auto [view, arg] = prefetchQueue.front();
+        prefetchQueue.erase(prefetchQueue.begin());
+        std::string key = view.toStdString() + '\n' + arg.toStdString();
+        if (viewCache.count(key)) continue;
+        std::function<QVariant()> job;
+        if (view == "adminUsers" && isAdminLogin) {
+            job = [arg]() { return QVariant(usersInfo(arg)); };
+        } else if (view == "expenseStats") {
+            if (auto user = current()) job = [user]() { return QVariant(expenseStats(*user)); };
+        }
+        if (!job) continue;
+        prefetchKey = key;
+        prefetchKeyGeneration = prefetchGeneration;
+        prefetchWatcher->setFuture(QtConcurrent::run(std::move(job)));
+        return;
+    }
+}
+
+void BankController::prefetchDone() {
+    if (prefetchKeyGeneration == prefetchGeneration && !viewCache.count(prefetchKey)) {
+        viewCache.emplace(prefetchKey, ViewEntry{prefetchWatcher->result(), true});
+        ++viewsPrefetched;
+    }
+    if (!prefetchQueue.empty()) idleTimer->start(0);
+}
+
+// Данные изменил сам администратор: корпус поиска перечитывается сразу
+void BankController::restartSearch() {
+    transferSearch.reset();
+    searchStale = false;
+    if (isAdminLogin && searchGeneration > 0) {
+        // порции прежнего поиска устарели: их номер больше не совпадает, клиент начинает заново
+        searchTimer->stop();
+        ++searchGeneration;
+        emit transferSearchReset();
+    }
+}
+
+void BankController::invalidateViews() {
+    viewCache.clear();
+    prefetchQueue.clear();
+    ++prefetchGeneration;  // результат незаконченной задачи уже устарел
+    idleTimer->stop();
+}
+
+void BankController::markInteractive(qlonglong elapsedMs) {
+    if (timeToInteractiveMs < 0) timeToInteractiveMs = elapsedMs;
+}
+
+void BankController::setWriteBehind(int intervalMs) {
     try {
-        std::filesystem::create_directories("data");
-        auto path = std::filesystem::path("data/rates.txt");
-        if (!std::filesystem::exists(path)) {
-            std::ofstream ofs(path);
-            ofs << "USD/RUB=100.00\nEUR/RUB=110.00\n";
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        UserRepository::instance().setWriteBehind(std::chrono::milliseconds(std::max(intervalMs, 0)));
+        emit infoMessage(intervalMs > 0 ? QString("Отложенная запись: раз в %1 мс").arg(intervalMs) : QString("Синхронная запись"));
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+QVariantMap BankController::persistenceMetrics() const {
+    QVariantMap out;
+    auto &repo = UserRepository::instance();
+    auto stats = repo.writeStats();
+    out["intervalMs"] = static_cast<qlonglong>(repo.writeBehind().count());
+    out["requested"] = static_cast<qlonglong>(stats.requested);
+    out["written"] = static_cast<qlonglong>(stats.written);
+    out["coalesced"] = static_cast<qlonglong>(stats.coalesced);
+    out["dirty"] = static_cast<qlonglong>(stats.dirty);
+    out["flushes"] = static_cast<qlonglong>(stats.flushes);
+    out["failed"] = static_cast<qlonglong>(stats.failed);
+    out["maxLagMs"] = stats.maxLagMs;
+    return out;
+}
+
+QVariantMap BankController::startupMetrics() const {
+    QVariantMap out;
+    out["timeToInteractiveMs"] = timeToInteractiveMs;
+    out["viewsFetched"] = viewsFetched;
+    out["viewsPrefetched"] = viewsPrefetched;
+    out["prefetchHits"] = prefetchHits;
+    return out;
+}
+
+UserSnapshot BankController::current() const {
+    if (currentName.empty()) return nullptr;
+    try {
+        return UserRepository::instance().get(currentName);
+    } catch (const NotFoundError &) {
+        return nullptr;  // пользователя удалили из другой сессии
+    }
+}
+
+void BankController::resetCollections() {
+    shown = current();
+    if (auto user = shown) {
+        accountsRows->setRows(toRows(user->accounts, accountRow));
+        cardsRows->setRows(toRows(user->cards, cardRow));
+        historyRows->setRows(toRows(historyOf(*user), historyRow));
+        favoritesRows->setRows(favoriteRows(user->favorites));
+        const auto &name = user->usernameValue;
+        long long cursor = NotificationStore::instance().readCursor(name);
+        auto notes = NotificationStore::instance().since(name, 0);
+        notificationsRows->setRows(toRows(notes, [cursor](const NotificationEntry &n){ return notificationRow(n, cursor); }));
+    } else {
+        for (auto *model : {accountsRows, cardsRows, historyRows, favoritesRows, notificationsRows}) model->setRows({});
+    }
+    emit collectionChanged("accounts", "reset", -1, accountsRows->revision());
+    emit collectionChanged("cards", "reset", -1, cardsRows->revision());
+    emit collectionChanged("history", "reset", -1, historyRows->revision());
+    emit collectionChanged("favorites", "reset", -1, favoritesRows->revision());
+    emit collectionChanged("notifications", "reset", -1, notificationsRows->revision());
+}
+
+void BankController::syncAccountsRows() {
+    auto user = current();
+    if (!user) return;
+    auto before = accountsRows->revision();
+    accountsRows->syncByKey(toRows(user->accounts, accountRow), "accountNumber");
+    if (accountsRows->revision() != before) emit collectionChanged("accounts", "changed", -1, accountsRows->revision());
+}
+
+void BankController::appendRow(VariantListModel *model, const QString &collection, const QVariantMap &row) {
+    model->appendRow(row);
+    emit collectionChanged(collection, "inserted", model->count() - 1, model->revision());
+}
+
+void BankController::refreshCollections() {
+    try {
+        auto user = current();
+        if (!user) return;
+        // сверяются только коллекции, отличающиеся от показанной версии
+        auto before = std::exchange(shown, user);
+        auto sync = [this](VariantListModel *model, const QString &collection, const QList<QVariantMap> &rows, const QString &key) {
+            auto revision = model->revision();
+            model->syncByKey(rows, key);
+            if (model->revision() != revision) emit collectionChanged(collection, "changed", -1, model->revision());
+        };
+        bool accountsChanged = !before || !schema::sameRows(before->accounts, user->accounts);
+        if (accountsChanged) syncAccountsRows();
+        if (!before || !schema::sameRows(before->cards, user->cards)) sync(cardsRows, "cards", toRows(user->cards, cardRow), "cardNumber");
+        // зачисления от других видны только по балансам: история берет их из журнала
+        if (accountsChanged || !schema::sameRows(before->history, user->history)) {
+            sync(historyRows, "history", toRows(historyOf(*user), historyRow), "id");
         }
-        std::ifstream ifs(path);
-        std::string all((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-        return QString::fromStdString(all);
-    } catch (...) {
-        return QStringLiteral("Курсы недоступны");
+        if (!before || !schema::sameRows(before->favorites, user->favorites)) {
+            sync(favoritesRows, "favorites", favoriteRows(user->favorites), "position");
+        }
+
+        // уведомления только дописываются: догружаем хвост после последнего показанного id
+        long long lastId = notificationsRows->count() > 0
+            ? notificationsRows->get(notificationsRows->count() - 1).value("id").toLongLong()
+            : 0;
+        long long cursor = NotificationStore::instance().readCursor(user->usernameValue);
+        for (const auto &n : NotificationStore::instance().since(user->usernameValue, lastId)) {
+            appendRow(notificationsRows, "notifications", notificationRow(n, cursor));
+        }
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
+    }
+}
+
+qlonglong BankController::revision(const QString &collection) const {
+    if (collection == "accounts") return accountsRows->revision();
+    if (collection == "cards") return cardsRows->revision();
+    if (collection == "history") return historyRows->revision();
+    if (collection == "favorites") return favoritesRows->revision();
+    if (collection == "notifications") return notificationsRows->revision();
+    return -1;
+}
+
+namespace {
+
+std::int64_t bucketSeconds(const QString &bucket) {
+    auto b = bucket.trimmed().toLower();
+    if (b == "hour" || b == "час") return AnalyticsStore::kHour;
+    if (b == "week" || b == "неделя") return AnalyticsStore::kWeek;
+    return AnalyticsStore::kDay;
+}
+
+}
+
+QVariantList BankController::analyticsVolume(const QString &bucket, qlonglong fromTs, qlonglong toTs, bool byCategory) const {
+    QVariantList out;
+    if (!isAdminLogin) return out;
+    for (const auto &b : AnalyticsStore::instance().aggregate(LedgerEventKind::Transfer, fromTs, toTs, bucketSeconds(bucket), byCategory)) {
+        QVariantMap m;
+        m["bucketStart"] = static_cast<qlonglong>(b.bucketStart);
+        if (b.category >= 0) m["category"] = QString::fromStdString(categoryName(static_cast<std::uint8_t>(b.category)));
+        m["count"] = static_cast<qlonglong>(b.count);
+        m["sumCents"] = static_cast<qlonglong>(b.sumCents);
+        out.push_back(m);
     }
+    return out;
+}
+
+QVariantList BankController::analyticsCancellationRate(const QString &bucket, qlonglong fromTs, qlonglong toTs) const {
+    QVariantList out;
+    if (!isAdminLogin) return out;
+    auto &store = AnalyticsStore::instance();
+    auto seconds = bucketSeconds(bucket);
+    auto transfers = store.aggregate(LedgerEventKind::Transfer, fromTs, toTs, seconds, false);
+    auto cancels = store.aggregate(LedgerEventKind::Cancel, fromTs, toTs, seconds, false);
+    std::map<std::int64_t, std::pair<std::int64_t, std::int64_t>> merged;
+    for (const auto &b : transfers) merged[b.bucketStart].first = b.count;
+    for (const auto &b : cancels) merged[b.bucketStart].second = b.count;
+    for (const auto &[start, counts] : merged) {
+        QVariantMap m;
+        m["bucketStart"] = static_cast<qlonglong>(start);
+        m["transfers"] = static_cast<qlonglong>(counts.first);
+        m["cancelled"] = static_cast<qlonglong>(counts.second);
+        m["rate"] = counts.first > 0 ? static_cast<double>(counts.second) / counts.first : 0.0;
+        out.push_back(m);
+    }
+    return out;
+}
+
+QString BankController::ratesText() const {
+    auto snap = RatesTable::instance().snapshot();
+    if (!snap) return QStringLiteral("Курсы недоступны");
+    return QString::fromStdString(snap->rawText);
 }
 
 bool BankController::isCardExpired(const QString &expiry) const {
@@ -774,72 +1778,103 @@ bool BankController::isCardExpired(const QString &expiry) const {
     }
 }
 
-bool BankController::adjustRecipientBalance(const std::string &destination, long long deltaCents, std::string *ownerUsername) {
-    bool updated = false;
-    for (const auto &name : UserStorage::listUsernames()) {
-        try {
-            RegularUser user = UserStorage::loadUser(name);
-            bool changed = false;
-            auto accountIt = std::find_if(user.accounts.begin(), user.accounts.end(), [&](const Account &a){
-                return a.accountNumber == destination;
-            });
-            if (accountIt != user.accounts.end()) {
-                long long newBalance = accountIt->balanceCents + deltaCents;
-                if (newBalance < 0) newBalance = 0;
-                accountIt->balanceCents = newBalance;
-                changed = true;
-            } else {
-                auto cardIt = std::find_if(user.cards.begin(), user.cards.end(), [&](const Card &c){
-                    return c.cardNumber == destination;
-                });
-                if (cardIt != user.cards.end()) {
-                    auto linked = std::find_if(user.accounts.begin(), user.accounts.end(), [&](const Account &a){
-                        return a.accountNumber == cardIt->linkedAccount;
-                    });
-                    if (linked != user.accounts.end()) {
-                        long long newBalance = linked->balanceCents + deltaCents;
-                        if (newBalance < 0) newBalance = 0;
-                        linked->balanceCents = newBalance;
-                        changed = true;
-                    }
-                }
-            }
+// Балансы счетов из журнала проводок; счета и карты, которых журнал еще не знает, заносятся в справочник
+void BankController::syncLedgerBalances(RegularUser &user) {
+    auto &ledger = PostingLedger::instance();
+    ledger.adopt(user);
+    for (auto &a : user.accounts) a.balanceCents = ledger.balance(a.accountNumber);
+}
 
-            if (changed) {
-                UserStorage::saveUser(user);
-                if (ownerUsername) *ownerUsername = user.usernameValue;
-                updated = true;
-                break;
-            }
-        } catch (...) {
-        }
+// Балансы получателя уже в таблице балансов, его файл не переписывается. Если получатель
+// загружен в хранилище, публикуется версия с новыми балансами — ее увидят все сессии
+void BankController::mirrorBalances(const std::string &owner) {
+    auto &repo = UserRepository::instance();
+    if (owner.empty() || !repo.cached(owner)) return;
+    try {
+        repo.update(owner, [this](RegularUser &u){ syncLedgerBalances(u); }, false);
+    } catch (...) {
+        // следующая загрузка возьмет балансы из таблицы
     }
-    return updated;
+}
+
+// Сторно операции, записанной до появления журнала: ноги восстанавливаются по справочнику
+std::vector<PostingLeg> BankController::reversalLegs(const Transaction &t, std::string &recipientName) {
+    auto &ledger = PostingLedger::instance();
+    LedgerAccount source, target;
+    bool fromInternal = ledger.account(t.fromAccount, source);
+    std::string destination = ledger.resolve(t.toCard);
+    bool toInternal = !destination.empty() && ledger.account(destination, target);
+    std::string sourceCurrency = fromInternal ? source.currency : target.currency;
+    std::string targetCurrency = toInternal ? target.currency : sourceCurrency;
+    long long targetCents = targetCurrency != sourceCurrency && t.creditedCents ? t.creditedCents : t.cents;
+
+    std::vector<PostingLeg> legs{{fromInternal ? t.fromAccount : "ext:" + t.fromAccount, sourceCurrency, t.cents}};
+    if (targetCurrency != sourceCurrency) {
+        legs.push_back({"fx:" + sourceCurrency, sourceCurrency, -t.cents});
+        legs.push_back({"fx:" + targetCurrency, targetCurrency, targetCents});
+    }
+    legs.push_back({toInternal ? destination : "ext:" + t.toCard, targetCurrency, -targetCents});
+    recipientName = toInternal ? target.owner : std::string();
+    return legs;
 }
 
 QVariantList BankController::listAllTransfers(const QString &query) const {
     QVariantList out;
     if (!isAdminLogin) return out;
     std::string q = query.trimmed().toStdString();
-    auto users = UserStorage::loadAll();
-    for (const auto &u : users) {
-        for (const auto &t : u.history) {
-            QVariantMap m;
-            m["user"] = QString::fromStdString(u.usernameValue);
-            m["id"] = QString::fromStdString(t.id);
-            m["fromAccount"] = QString::fromStdString(t.fromAccount);
-            m["toCard"] = QString::fromStdString(t.toCard);
-            m["cents"] = static_cast<qlonglong>(t.cents);
-            m["timestamp"] = static_cast<qlonglong>(t.timestamp);
-            m["note"] = QString::fromStdString(t.note);
-            m["status"] = QString::fromStdString(t.status);
-            m["cancelReason"] = QString::fromStdString(t.cancelReason);
-            if (q.empty()) { out.push_back(m); continue; }
-            auto contains = [&](const std::string &s){ return s.find(q) != std::string::npos; };
-            if (contains(u.usernameValue) || contains(t.id) || contains(t.fromAccount) || contains(t.toCard) || contains(t.note) || contains(t.status) || contains(t.cancelReason)) {
-                out.push_back(m);
-            }
+    auto contains = [&](std::string_view s){ return s.find(q) != std::string_view::npos; };
+    syncUserFiles();
+    UserStorage::forEachTransaction([&](const UserView &u, const TransactionView &t) {
+        if (q.empty() || contains(u.username) || contains(t.id) || contains(t.fromAccount) || contains(t.toCard) || contains(t.note) || contains(t.status) || contains(t.cancelReason)) {
+            out.push_back(transferRow(u.username, t));
         }
+    });
+    return out;
+}
+
+int BankController::searchTransfers(const QString &query) {
+    if (!isAdminLogin) return 0;
+    if (searchStale) {
+        transferSearch.reset();
+        searchStale = false;
+    }
+    syncUserFiles();  // корпус разбирается из файлов
+    transferSearch.start(query.trimmed().toStdString());
+    searchFirstBatch = true;
+    searchTimer->start(0);
+    return ++searchGeneration;
+}
+
+// Порция поиска на один виток цикла событий: первая — до 50 строк, чтобы список
+// появился сразу, дальше — сколько найдется за 8 мс. Ввод между порциями успевает обработаться
+void BankController::searchStep() {
+    std::vector<TransferSearch::Hit> hits;
+    bool done = transferSearch.step(std::chrono::steady_clock::now() + std::chrono::milliseconds(8), searchFirstBatch ? 50 : 2000, hits);
+    searchFirstBatch = false;
+    QVariantList rows;
+    rows.reserve(static_cast<qsizetype>(hits.size()));
+    for (const auto &h : hits) rows.push_back(transferRow(transferSearch.user(h).username, transferSearch.transaction(h)));
+    emit transferSearchRows(searchGeneration, rows, done);
+    if (!done) searchTimer->start(0);
+}
+
+QVariantMap BankController::queryTransfers(const QString &expression, const QString &orderBy, int limit) {
+    QVariantMap out;
+    try {
+        if (!isAdminLogin) throw AuthError("Только администратор");
+        auto query = TransferQuery::compile(expression.toStdString());
+        UserArena arena;
+        syncUserFiles();
+        auto users = UserStorage::scanAll(arena);
+        auto columns = TransferColumns::build(users);
+        auto result = query.run(columns, orderBy.toStdString(), static_cast<std::size_t>(std::max(0, limit)));
+        QVariantList items;
+        for (auto row : result.top) items.push_back(transferRow(columns.userNames.values[columns.users[row]], *columns.rows[row]));
+        out["count"] = static_cast<qlonglong>(result.count);
+        out["sumCents"] = static_cast<qlonglong>(result.sumCents);
+        out["items"] = items;
+    } catch (const std::exception &e) {
+        emit errorOccured(QString::fromStdString(e.what()));
     }
     return out;
 }
@@ -4,7 +4,8 @@
 #include <QString>
 #include <QStringList>
 #include <QVariantList>
-#include <optional>
+#include <QTimer>
+#include <QFutureWatcher>
 #include <unordered_map>
 #include "../models/User.h"
 #include "../models/Account.h"
@@ -14,14 +15,36 @@
 #include "../utils/Exceptions.h"
 #include "../utils/Utils.h"
 #include "../storage/UserStorage.h"
+#include "../storage/RatesTable.h"
+#include "../storage/IdAllocator.h"
+#include "../storage/AnalyticsStore.h"
+#include "../storage/ScheduleStore.h"
+#include "../storage/NotificationStore.h"
+#include "../storage/VelocityRules.h"
+#include "../storage/BulkImporter.h"
+#include "../storage/Reconciler.h"
+#include "../storage/PostingLedger.h"
+#include "../storage/HistoryArchive.h"
+#include "../storage/HistoryIndex.h"
+#include "../storage/TransferQuery.h"
+#include "../storage/TransferSearch.h"
+#include "../storage/UserRepository.h"
+#include "../storage/IdempotencyStore.h"
+#include "VariantListModel.h"
 
 class BankController : public QObject {
     Q_OBJECT
     Q_PROPERTY(bool authenticated READ isAuthenticated NOTIFY authenticatedChanged)
     Q_PROPERTY(bool admin READ isAdmin NOTIFY authenticatedChanged)
     Q_PROPERTY(QString username READ username NOTIFY authenticatedChanged)
+    Q_PROPERTY(QObject *accountsModel READ accountsModel CONSTANT)
+    Q_PROPERTY(QObject *cardsModel READ cardsModel CONSTANT)
+    Q_PROPERTY(QObject *historyModel READ historyModel CONSTANT)
+    Q_PROPERTY(QObject *favoritesModel READ favoritesModel CONSTANT)
+    Q_PROPERTY(QObject *notificationsModel READ notificationsModel CONSTANT)
 public:
     explicit BankController(QObject *parent = nullptr);
+    ~BankController() override;
 
     Q_INVOKABLE void seedAdmin();
 
@@ -32,6 +55,9 @@ public:
     Q_INVOKABLE QVariantList listAccounts() const;
     Q_INVOKABLE QVariantList listCards() const;
     Q_INVOKABLE QVariantList listHistory() const;
+    // filter: fromTs, toTs, minCents, maxCents, category, status, counterparty, order ("newest"/"oldest"), cursor, limit;
+    // результат: items, nextCursor (пусто — последняя страница)
+    Q_INVOKABLE QVariantMap queryHistory(const QVariantMap &filter);
     Q_INVOKABLE QVariantList listFavorites() const;
     Q_INVOKABLE QVariantList listUserCards(const QString &username) const; // any user by name
     Q_INVOKABLE QVariantList listUserAccounts(const QString &username) const; // any user by name
@@ -40,48 +66,177 @@ public:
     Q_INVOKABLE void addCard(const QString &holderName, const QString &expiry, const QString &linkedAccount);
     Q_INVOKABLE void addFavorite(const QString &name, const QString &toCard, const QString &note);
 
-    Q_INVOKABLE void transfer(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note, const QString &category = "other");
+    // idempotencyKey: повтор запроса с тем же ключом возвращает исходный результат, не выполняя операцию.
+    // Возвращает id операции, пустую строку при ошибке
+    Q_INVOKABLE QString transfer(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note,
+                                 const QString &category = "other", const QString &idempotencyKey = QString());
     Q_INVOKABLE void payFavorite(const QString &favName, const QString &fromAccount, qlonglong cents, const QString &category = "other");
     Q_INVOKABLE QVariantMap getExpenseStats() const;
-    Q_INVOKABLE void depositToAccount(const QString &accountNumber, qlonglong cents, const QString &externalAccount);
+
+    // repeat: "once", "daily", "monthly" (dayOfMonth 1..31); firstRunTs — unix-время, 0 — сейчас
+    Q_INVOKABLE QString schedulePayment(const QString &fromAccount, const QString &toCard, qlonglong cents, const QString &note,
+                                        const QString &category, const QString &repeat, int dayOfMonth = 0, qlonglong firstRunTs = 0);
+    Q_INVOKABLE QString scheduleFavorite(const QString &favName, const QString &fromAccount, qlonglong cents, const QString &category,
+                                         const QString &repeat, int dayOfMonth = 0, qlonglong firstRunTs = 0);
+    Q_INVOKABLE QVariantList listSchedules() const;
+    Q_INVOKABLE void cancelSchedule(const QString &scheduleId);
+    Q_INVOKABLE void runDueSchedules();
+    Q_INVOKABLE QString depositToAccount(const QString &accountNumber, qlonglong cents, const QString &externalAccount,
+                                         const QString &idempotencyKey = QString());
     Q_INVOKABLE QVariantMap receiptFor(const QString &transactionId) const;
     Q_INVOKABLE QString downloadReceipt(const QString &transactionId);
     Q_INVOKABLE QString saveReceiptToFile(const QString &transactionId, const QString &filePath);
-
-    Q_INVOKABLE QVariantList listNotifications() const;
+    // Архивная история текущего пользователя за [fromTs, toTs); разжимаются только нужные блоки
+    Q_INVOKABLE QVariantList listArchivedHistory(qlonglong fromTs, qlonglong toTs) const;
+    Q_INVOKABLE QString archivedReceipt(const QString &transactionId) const; // текст сохраненного чека из архива
+
+    // Страница от новых к старым: id < beforeId (0 — с самой новой)
+    Q_INVOKABLE QVariantList listNotifications(qlonglong beforeId = 0, int limit = 50) const;
+    Q_INVOKABLE QVariantList listNotificationsSince(qlonglong afterId) const;
+    Q_INVOKABLE int unreadNotifications() const;
+    Q_INVOKABLE void markNotificationsRead(qlonglong upToId = 0); // 0 — все
     Q_INVOKABLE void clearNotifications();
 
     Q_INVOKABLE void setAccountBalance(const QString &accountNumber, qlonglong cents);
 
     Q_INVOKABLE QVariantList listAllTransfers(const QString &query) const;
+    // Поиск для поля ввода: строки приходят порциями в transferSearchRows с номером поиска,
+    // который возвращает вызов; новый вызов отменяет незаконченный поиск. После изменения данных
+    // поиск сбрасывается с новым номером и transferSearchReset — клиент запрашивает его заново
+    Q_INVOKABLE int searchTransfers(const QString &query);
+    // expression — язык запросов TransferQuery; результат: count, sumCents, items (первые limit по orderBy)
+    Q_INVOKABLE QVariantMap queryTransfers(const QString &expression, const QString &orderBy = "timestamp desc", int limit = 50);
     Q_INVOKABLE void cancelTransfer(const QString &transactionId, const QString &reason);
+    // Отмена по фильтру (toCard, fromAccount, user, fromTs, toTs, ids). dryRun — только подсчет
+    // и первые 200 подходящих операций; итоги: matched, matchedCents, users, cancelled, cancelledCents, items
+    Q_INVOKABLE QVariantMap cancelTransfers(const QVariantMap &filter, const QString &reason, bool dryRun = true);
     Q_INVOKABLE void clearAllUsers();
+    Q_INVOKABLE QVariantList listFlaggedTransfers() const; // помеченные правилами data/limits.txt
+    Q_INVOKABLE void reloadLimits();
+    // Импорт выгрузки CSV/NDJSON (см. BulkImporter); отчет: rows, accepted, rejected, users, seconds, rowsPerSecond, errors
+    Q_INVOKABLE QVariantMap importLedger(const QString &filePath);
+    // Сверка балансов с историей; full — без контрольной точки, с нуля
+    Q_INVOKABLE QVariantMap reconcileLedger(bool full = false);
+    // Перенос операций старше olderThanDays и сохраненных чеков в сжатый архив;
+    // отчет: users, transactions, blocks, receipts, bytesBefore, bytesAfter
+    Q_INVOKABLE QVariantMap archiveHistory(int olderThanDays = 365);
 
     Q_INVOKABLE QStringList listUsers() const;
-    Q_INVOKABLE QStringList searchUsers(const QString &query) const;
+    // Точные совпадения, затем по началу имени, затем по подстроке; постранично
+    Q_INVOKABLE QStringList searchUsers(const QString &query, int offset = 0, int limit = 50) const;
+    Q_INVOKABLE int searchUsersCount(const QString &query) const;
+    Q_INVOKABLE void deleteUser(const QString &username);
     Q_INVOKABLE QStringList sortUsersByAccountCount() const;
     Q_INVOKABLE QStringList sortUsers(const QString &sortBy) const; // "accounts", "cards", "transactions", "name"
     Q_INVOKABLE QVariantList getAllUsersInfo(const QString &sortBy = "") const; // Returns full user info with accounts, cards, transactions count
     Q_INVOKABLE QVariantList sortTransfers(const QString &sortBy) const; // "user", "amount", "date", "status"
 
+    // Аналитика для администратора; bucket: "hour", "day", "week"; fromTs/toTs — unix-время, [from, to)
+    Q_INVOKABLE QVariantList analyticsVolume(const QString &bucket, qlonglong fromTs, qlonglong toTs, bool byCategory = false) const;
+    Q_INVOKABLE QVariantList analyticsCancellationRate(const QString &bucket, qlonglong fromTs, qlonglong toTs) const;
+
     Q_INVOKABLE QString ratesText() const;
     Q_INVOKABLE bool isCardExpired(const QString &expiry) const;
 
-    bool isAuthenticated() const { return currentUser.has_value() || isAdminLogin; }
+    // Ленивые вкладки: данные вида считаются при первом показе, вероятные следующие виды —
+    // в простое цикла событий. view: "adminTransfers" (arg — фильтр), "adminUsers" (arg — сортировка), "expenseStats"
+    Q_INVOKABLE QVariant viewData(const QString &view, const QString &arg = QString());
+    Q_INVOKABLE void markInteractive(qlonglong elapsedMs); // первый кадр окна после запуска
+    Q_INVOKABLE QVariantMap startupMetrics() const; // timeToInteractiveMs, viewsFetched, viewsPrefetched, prefetchHits
+    // Отложенная запись файлов пользователей: intervalMs > 0 — не чаще раза в интервал, 0 — синхронно
+    Q_INVOKABLE void setWriteBehind(int intervalMs);
+    Q_INVOKABLE QVariantMap persistenceMetrics() const; // intervalMs, requested, written, coalesced, dirty, flushes, failed, maxLagMs
+
+    // Перечитать текущего пользователя и разослать только отличающиеся строки
+    Q_INVOKABLE void refreshCollections();
+    Q_INVOKABLE qlonglong revision(const QString &collection) const; // "accounts", "cards", "history", "favorites", "notifications"
+
+    QObject *accountsModel() const { return accountsRows; }
+    QObject *cardsModel() const { return cardsRows; }
+    QObject *historyModel() const { return historyRows; }
+    QObject *favoritesModel() const { return favoritesRows; }
+    QObject *notificationsModel() const { return notificationsRows; }
+
+    bool isAuthenticated() const { return !currentName.empty() || isAdminLogin; }
     bool isAdmin() const { return isAdminLogin; }
-    QString username() const { return isAdminLogin ? QStringLiteral("admin") : (currentUser ? QString::fromStdString(currentUser->usernameValue) : QString()); }
+    QString username() const { return isAdminLogin ? QStringLiteral("admin") : QString::fromStdString(currentName); }
 
 signals:
     void authenticatedChanged();
     void errorOccured(const QString &message);
     void infoMessage(const QString &message);
+    // change: "inserted", "changed", "removed", "reset"
+    void collectionChanged(const QString &collection, const QString &change, int row, qlonglong revision);
+    void transferSearchRows(int generation, const QVariantList &rows, bool done);
+    void transferSearchReset();
 
 private:
-    std::optional<RegularUser> currentUser;
+    std::string currentName; // данные пользователя — снимки UserRepository через current()
+    storage::UserSnapshot shown; // версия текущего пользователя, которую показывают модели
+    int repositoryListener = 0;
     bool isAdminLogin = false;
 
-    void saveCurrent();
-    bool adjustRecipientBalance(const std::string &destination, long long deltaCents, std::string *ownerUsername = nullptr);
+    VariantListModel *accountsRows;
+    VariantListModel *cardsRows;
+    VariantListModel *historyRows;
+    VariantListModel *favoritesRows;
+    VariantListModel *notificationsRows;
+
+    static constexpr int kMaxCatchUp = 31;
+    QTimer *scheduleTimer;
+
+    struct ViewEntry {
+        QVariant data;
+        bool prefetched = false;
+    };
+    std::unordered_map<std::string, ViewEntry> viewCache; // вид + '\n' + аргумент
+    std::vector<std::pair<QString, QString>> prefetchQueue;
+    QTimer *idleTimer;
+    QFutureWatcher<QVariant> *prefetchWatcher;
+    std::string prefetchKey;         // вид, который сейчас считается в фоне
+    int prefetchKeyGeneration = 0;
+    int prefetchGeneration = 0;      // растет при сбросе кэша видов
+    qlonglong timeToInteractiveMs = -1;
+    int viewsFetched = 0;
+    int viewsPrefetched = 0;
+    int prefetchHits = 0;
+
+    storage::TransferSearch transferSearch;
+    QTimer *searchTimer;
+    int searchGeneration = 0;
+    bool searchFirstBatch = false;
+    bool searchStale = false;      // файлы изменились: корпус перечитывается со следующего запроса
+
+    storage::HistoryIndex historyIndex; // перестраивается при смене ревизии истории
+    qlonglong historyIndexRevision = -1;
+    std::string historyIndexUser;
+
+    storage::UserSnapshot current() const;
+    template <typename F>
+    storage::UserSnapshot updateShown(const std::string &name, F &&fn);
+    QVariant computeView(const QString &view, const QString &arg) const;
+    void schedulePrefetch(const QString &view);
+    void prefetchStep();
+    void prefetchDone();
+    static QVariantMap expenseStats(const RegularUser &user);
+    static QVariantList usersInfo(const QString &sortBy);
+    void invalidateViews();
+    void restartSearch();
+    void searchStep();
+    Transaction executeTransfer(RegularUser &sender, const std::string &fromAccount, const std::string &toCard, long long cents,
+                                const std::string &note, const std::string &category, std::string &recipientName, std::time_t at = 0);
+    bool replayIdempotent(const std::string &key, const std::string &kind, const std::string &fingerprint, QString &transactionId);
+    QString addSchedule(ScheduledPayment p);
+    void armScheduleTimer();
+    void notify(const std::string &username, const std::string &message);
+    void migrateLegacyNotifications(RegularUser &user);
+    void resetCollections();
+    void syncAccountsRows();
+    void appendRow(VariantListModel *model, const QString &collection, const QVariantMap &row);
+    void syncLedgerBalances(RegularUser &user);
+    void mirrorBalances(const std::string &owner);
+    std::string reverseTransaction(const RegularUser &owner, Transaction &t, const std::string &reason);
+    std::vector<storage::PostingLeg> reversalLegs(const Transaction &t, std::string &recipientName);
 };
 
 
@@ -0,0 +1,107 @@
+#include "VariantListModel.h"
+
+#include <QSet>
+
+VariantListModel::VariantListModel(const QStringList &roles, QObject *parent)
+    : QAbstractListModel(parent), roleKeys(roles) {
+}
+
+int VariantListModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return static_cast<int>(rows.size());
+}
+
+QVariant VariantListModel::data(const QModelIndex &index, int role) const {
+    int column = role - Qt::UserRole - 1;
+    if (!index.isValid() || index.row() >= rows.size() || column < 0 || column >= roleKeys.size()) return QVariant();
+    return rows.at(index.row()).value(roleKeys.at(column));
+}
+
+QHash<int, QByteArray> VariantListModel::roleNames() const {
+    QHash<int, QByteArray> names;
+    for (int i = 0; i < roleKeys.size(); ++i) names.insert(Qt::UserRole + 1 + i, roleKeys.at(i).toUtf8());
+    return names;
+}
+
+QVariantMap VariantListModel::get(int row) const {
+    if (row < 0 || row >= rows.size()) return QVariantMap();
+    return rows.at(row);
+}
+
+void VariantListModel::appendRow(const QVariantMap &row) {
+    int at = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), at, at);
+    rows.append(row);
+    endInsertRows();
+    emit countChanged();
+    bump();
+}
+
+void VariantListModel::setRow(int row, const QVariantMap &value) {
+    if (row < 0 || row >= rows.size()) return;
+    QList<int> changedRoles;
+    for (int i = 0; i < roleKeys.size(); ++i) {
+        if (rows.at(row).value(roleKeys.at(i)) != value.value(roleKeys.at(i))) changedRoles.append(Qt::UserRole + 1 + i);
+    }
+    if (changedRoles.isEmpty()) return;
+    rows[row] = value;
+    emit dataChanged(index(row), index(row), changedRoles);
+    bump();
+}
+
+void VariantListModel::removeRow(int row) {
+    if (row < 0 || row >= rows.size()) return;
+    beginRemoveRows(QModelIndex(), row, row);
+    rows.removeAt(row);
+    endRemoveRows();
+    emit countChanged();
+    bump();
+}
+
+void VariantListModel::setRows(const QList<QVariantMap> &newRows) {
+    beginResetModel();
+    rows = newRows;
+    endResetModel();
+    emit countChanged();
+    bump();
+}
+
+void VariantListModel::syncByKey(const QList<QVariantMap> &newRows, const QString &keyRole) {
+    QSet<QString> keep;
+    for (const auto &row : newRows) keep.insert(row.value(keyRole).toString());
+    for (int i = static_cast<int>(rows.size()) - 1; i >= 0; --i) {
+        if (!keep.contains(rows.at(i).value(keyRole).toString())) removeRow(i);
+    }
+    // после удаления оставшиеся строки идут в прежнем относительном порядке
+    for (int i = 0; i < newRows.size(); ++i) {
+        const auto key = newRows.at(i).value(keyRole).toString();
+        if (i < rows.size() && rows.at(i).value(keyRole).toString() == key) {
+            setRow(i, newRows.at(i));
+            continue;
+        }
+        int found = -1;
+        for (int j = i + 1; j < rows.size(); ++j) {
+            if (rows.at(j).value(keyRole).toString() == key) { found = j; break; }
+        }
+        if (found >= 0) {
+            beginMoveRows(QModelIndex(), found, found, QModelIndex(), i);
+            rows.move(found, i);
+            endMoveRows();
+            bump();
+            setRow(i, newRows.at(i));
+        } else {
+            beginInsertRows(QModelIndex(), i, i);
+            rows.insert(i, newRows.at(i));
+            endInsertRows();
+            emit countChanged();
+            bump();
+        }
+    }
+    // при повторяющихся ключах за новым списком остаются лишние строки
+    for (int i = static_cast<int>(rows.size()) - 1; i >= newRows.size(); --i) removeRow(i);
+}
+
+void VariantListModel::bump() {
+    ++revisionValue;
+    emit revisionChanged();
+}
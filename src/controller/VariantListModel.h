@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QVariantMap>
+
+// Список строк-QVariantMap с фиксированным набором ролей.
+// Изменения публикуются построчно (insert/change/remove), а не сбросом модели,
+// поэтому QML пересоздает только затронутые делегаты.
+class VariantListModel : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(qlonglong revision READ revision NOTIFY revisionChanged)
+public:
+    explicit VariantListModel(const QStringList &roles, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const { return static_cast<int>(rows.size()); }
+    qlonglong revision() const { return revisionValue; }
+
+    Q_INVOKABLE QVariantMap get(int row) const;
+
+    void appendRow(const QVariantMap &row);
+    void setRow(int row, const QVariantMap &value);
+    void removeRow(int row);
+    void setRows(const QList<QVariantMap> &newRows);
+    // Построчный дифф по ключевой роли: меняются только отличающиеся строки
+    void syncByKey(const QList<QVariantMap> &newRows, const QString &keyRole);
+
+signals:
+    void countChanged();
+    void revisionChanged();
+
+private:
+    QStringList roleKeys;
+    QList<QVariantMap> rows;
+    qlonglong revisionValue = 0;
+
+    void bump();
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+#include <array>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "../models/Schema.h"
+
+// Строка для QML из Schema<T>: ключи-QString создаются один раз на тип
+// и дальше только разделяются, а не собираются из const char* на каждую строку.
+namespace schema {
+
+inline QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<int>(text.size()));
+}
+
+template <typename T>
+const std::array<QString, fieldCount<T>()> &qmlKeys() {
+    static const auto keys = [] {
+        std::array<QString, fieldCount<T>()> out;
+        std::size_t i = 0;
+        forEachField<T>([&](const auto &f) {
+            out[i++] = toQString(f.name);
+        });
+        return out;
+    }();
+    return keys;
+}
+
+template <typename M>
+QVariant toVariant(const M &value) {
+    if constexpr (isText<M>) {
+        return toQString(value);
+    } else {
+        return static_cast<qlonglong>(value);
+    }
+}
+
+template <typename T>
+QVariantMap toVariantMap(const T &obj) {
+    const auto &keys = qmlKeys<T>();
+    QVariantMap m;
+    std::size_t i = 0;
+    forEachField<T>([&](const auto &f) {
+        m.insert(keys[i++], toVariant(obj.*(f.member)));
+    });
+    return m;
+}
+
+}
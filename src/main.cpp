@@ -1,10 +1,29 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
+#include <QElapsedTimer>
+#include <cstring>
+#include <iostream>
 #include "src/controller/BankController.h"
 
 int main(int argc, char *argv[])
 {
+    // Ночная сверка без интерфейса: Bank --reconcile [--full]
+    if (argc > 1 && std::strcmp(argv[1], "--reconcile") == 0) {
+        auto report = storage::Reconciler::run(argc > 2 && std::strcmp(argv[2], "--full") == 0);
+        std::cout << "users " << report.usersChecked << ", accounts " << report.accountsChecked
+                  << ", postings " << report.postings << ", discrepancies " << report.discrepancies.size() << "\n";
+        for (const auto &d : report.discrepancies) {
+            std::cout << d.account << " " << d.owner << " expected " << d.expectedCents << " actual " << d.actualCents << ":";
+            for (const auto &id : d.transactionIds) std::cout << " " << id;
+            std::cout << "\n";
+        }
+        return report.discrepancies.empty() ? 0 : 1;
+    }
+
+    QElapsedTimer startup;
+    startup.start();
     QGuiApplication app(argc, argv);
 
     QQmlApplicationEngine engine;
@@ -19,5 +38,15 @@ int main(int argc, char *argv[])
         Qt::QueuedConnection);
     engine.load(QUrl("qrc:/Main.qml"));
 
+    // время до интерактивности: от старта процесса до первого показанного кадра
+    if (!engine.rootObjects().isEmpty()) {
+        if (auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().first())) {
+            QObject::connect(window, &QQuickWindow::frameSwapped, controller, [controller, startup]() {
+                controller->markInteractive(startup.elapsed());
+                std::cout << "startup: interactive in " << startup.elapsed() << " ms\n";
+            }, Qt::SingleShotConnection);
+        }
+    }
+
     return app.exec();
 }
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <iostream>
+#include "Schema.h"
 
 class Account {
 public:
@@ -17,19 +18,24 @@ public:
         return accountNumber < other.accountNumber;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const Account &acc) {
-        os << acc.accountNumber << "," << acc.currency << "," << acc.balanceCents;
-        return os;
-    }
+    friend std::ostream &operator<<(std::ostream &os, const Account &acc);
+    friend std::istream &operator>>(std::istream &is, Account &acc);
+};
 
-    friend std::istream &operator>>(std::istream &is, Account &acc) {
-        std::getline(is, acc.accountNumber, ',');
-        std::getline(is, acc.currency, ',');
-        std::string cents;
-        std::getline(is, cents);
-        if (!cents.empty()) acc.balanceCents = std::stoll(cents);
-        return is;
-    }
+template <>
+struct Schema<Account> {
+    static constexpr auto fields = std::make_tuple(
+        field("accountNumber", &Account::accountNumber),
+        field("currency", &Account::currency),
+        field("balanceCents", &Account::balanceCents));
 };
 
+inline std::ostream &operator<<(std::ostream &os, const Account &acc) {
+    schema::writeText(os, acc);
+    return os;
+}
 
+inline std::istream &operator>>(std::istream &is, Account &acc) {
+    schema::readText(is, acc);
+    return is;
+}
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <iostream>
+#include "Schema.h"
 
 class Card {
 public:
@@ -10,16 +11,25 @@ public:
     std::string expiry;
     std::string linkedAccount;
 
-    friend std::ostream &operator<<(std::ostream &os, const Card &c) {
-        os << c.cardNumber << "," << c.holderName << "," << c.expiry << "," << c.linkedAccount;
-        return os;
-    }
+    friend std::ostream &operator<<(std::ostream &os, const Card &c);
+    friend std::istream &operator>>(std::istream &is, Card &c);
+};
 
-    friend std::istream &operator>>(std::istream &is, Card &c) {
-        std::getline(is, c.cardNumber, ',');
-        std::getline(is, c.holderName, ',');
-        std::getline(is, c.expiry, ',');
-        std::getline(is, c.linkedAccount);
-        return is;
-    }
+template <>
+struct Schema<Card> {
+    static constexpr auto fields = std::make_tuple(
+        field("cardNumber", &Card::cardNumber),
+        field("holderName", &Card::holderName),
+        field("expiry", &Card::expiry),
+        field("linkedAccount", &Card::linkedAccount));
 };
+
+inline std::ostream &operator<<(std::ostream &os, const Card &c) {
+    schema::writeText(os, c);
+    return os;
+}
+
+inline std::istream &operator>>(std::istream &is, Card &c) {
+    schema::readText(is, c);
+    return is;
+}
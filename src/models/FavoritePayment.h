@@ -2,6 +2,7 @@
 
 #include <string>
 #include <iostream>
+#include "Schema.h"
 
 class FavoritePayment {
 public:
@@ -9,17 +10,24 @@ public:
     std::string toCard;    
     std::string note;      
 
-    friend std::ostream &operator<<(std::ostream &os, const FavoritePayment &f) {
-        os << f.name << "," << f.toCard << "," << f.note;
-        return os;
-    }
+    friend std::ostream &operator<<(std::ostream &os, const FavoritePayment &f);
+    friend std::istream &operator>>(std::istream &is, FavoritePayment &f);
+};
 
-    friend std::istream &operator>>(std::istream &is, FavoritePayment &f) {
-        std::getline(is, f.name, ',');
-        std::getline(is, f.toCard, ',');
-        std::getline(is, f.note);
-        return is;
-    }
+template <>
+struct Schema<FavoritePayment> {
+    static constexpr auto fields = std::make_tuple(
+        field("name", &FavoritePayment::name),
+        field("toCard", &FavoritePayment::toCard),
+        field("note", &FavoritePayment::note));
 };
 
+inline std::ostream &operator<<(std::ostream &os, const FavoritePayment &f) {
+    schema::writeText(os, f);
+    return os;
+}
 
+inline std::istream &operator>>(std::istream &is, FavoritePayment &f) {
+    schema::readText(is, f);
+    return is;
+}
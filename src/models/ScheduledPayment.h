@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <ctime>
+#include <algorithm>
+#include "Schema.h"
+
+// Постоянное поручение или отложенный разовый перевод
+class ScheduledPayment {
+public:
+    std::string id;
+    std::string owner;        // username отправителя
+    std::string fromAccount;
+    std::string toCard;
+    long long cents = 0;
+    std::string note;
+    std::string category = "other";
+    std::string repeat = "once";  // once, daily, monthly
+    int dayOfMonth = 0;           // для monthly: 1..31, в коротких месяцах — последний день
+    std::time_t nextRun = 0;
+    std::string favorite;         // имя избранного платежа, если создан из него
+
+    // Следующий запуск после current; 0 — поручение исчерпано
+    std::time_t following(std::time_t current) const {
+        if (repeat == "daily") {
+            std::tm tm = *std::localtime(&current);
+            tm.tm_mday += 1;
+            tm.tm_isdst = -1;
+            return std::mktime(&tm);
+        }
+        if (repeat == "monthly") {
+            std::tm tm = *std::localtime(&current);
+            tm.tm_mon += 1;
+            tm.tm_mday = 1;
+            tm.tm_isdst = -1;
+            std::mktime(&tm);
+            tm.tm_mday = std::min(dayOfMonth > 0 ? dayOfMonth : 1, daysInMonth(tm.tm_year + 1900, tm.tm_mon + 1));
+            tm.tm_isdst = -1;
+            return std::mktime(&tm);
+        }
+        return 0;
+    }
+
+    static int daysInMonth(int year, int month) {
+        static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return month == 2 && leap ? 29 : days[(month - 1) % 12];
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ScheduledPayment &p);
+    friend std::istream &operator>>(std::istream &is, ScheduledPayment &p);
+};
+
+template <>
+struct Schema<ScheduledPayment> {
+    static constexpr bool escapeCommas = true;
+    static constexpr auto fields = std::make_tuple(
+        field("id", &ScheduledPayment::id),
+        field("owner", &ScheduledPayment::owner),
+        field("fromAccount", &ScheduledPayment::fromAccount),
+        field("toCard", &ScheduledPayment::toCard),
+        field("cents", &ScheduledPayment::cents),
+        field("note", &ScheduledPayment::note),
+        field("category", &ScheduledPayment::category, "other"),
+        field("repeat", &ScheduledPayment::repeat, "once"),
+        field("dayOfMonth", &ScheduledPayment::dayOfMonth),
+        field("nextRun", &ScheduledPayment::nextRun),
+        field("favorite", &ScheduledPayment::favorite));
+};
+
+inline std::ostream &operator<<(std::ostream &os, const ScheduledPayment &p) {
+    schema::writeText(os, p);
+    return os;
+}
+
+inline std::istream &operator>>(std::istream &is, ScheduledPayment &p) {
+    schema::readText(is, p);
+    return is;
+}
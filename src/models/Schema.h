@@ -0,0 +1,256 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <unordered_map>
+
+// Описание полей модели: один список на тип, из него строятся текстовый
+// и колоночный форматы (и преобразование для QML в controller/VariantSchema.h).
+// Модель объявляет специализацию Schema<T> с constexpr-кортежем fields и, если ее
+// текстовый формат всегда кодировал ',' в строках как ';', флагом escapeCommas.
+
+template <typename T, typename M>
+struct FieldDescriptor {
+    std::string_view name;
+    M T::*member;
+    const char *fallback;  // значение при пустом поле в тексте (nullptr — оставить пустым)
+};
+
+template <typename T, typename M>
+constexpr FieldDescriptor<T, M> field(std::string_view name, M T::*member, const char *fallback = nullptr) {
+    return {name, member, fallback};
+}
+
+template <typename T>
+struct Schema;
+
+namespace schema {
+
+template <typename T>
+constexpr std::size_t fieldCount() {
+    return std::tuple_size<std::decay_t<decltype(Schema<T>::fields)>>::value;
+}
+
+template <typename T, typename F>
+void forEachField(F &&fn) {
+    std::apply([&](const auto &...f) { (fn(f), ...); }, Schema<T>::fields);
+}
+
+template <typename M>
+constexpr bool isText = std::is_same_v<M, std::string> || std::is_same_v<M, std::string_view>;
+
+// Замена ',' <-> ';' только у типов, чьи файлы так писались (операции, плановые платежи):
+// у счетов, карт и избранного ';' в файле — это сам символ ';'
+template <typename T, typename = void>
+constexpr bool escapesCommas = false;
+
+template <typename T>
+constexpr bool escapesCommas<T, std::void_t<decltype(Schema<T>::escapeCommas)>> = Schema<T>::escapeCommas;
+
+// Совпадение по всем полям схемы — для сравнения двух версий одной коллекции
+template <typename T>
+bool sameFields(const T &a, const T &b) {
+    bool same = true;
+    forEachField<T>([&](const auto &f) { same = same && a.*(f.member) == b.*(f.member); });
+    return same;
+}
+
+template <typename T>
+bool sameRows(const std::vector<T> &a, const std::vector<T> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const T &x, const T &y) { return sameFields(x, y); });
+}
+
+// Текст: поля через запятую, перевод строки в строках -> пробел, ',' -> ';' при escapesCommas<T>
+template <typename T>
+void writeText(std::ostream &os, const T &obj) {
+    bool first = true;
+    forEachField<T>([&](const auto &f) {
+        if (!first) os << ',';
+        first = false;
+        const auto &value = obj.*(f.member);
+        using M = std::decay_t<decltype(value)>;
+        if constexpr (isText<M>) {
+            for (char ch : value) os << (escapesCommas<T> && ch == ',' ? ';' : ch == '\n' ? ' ' : ch);
+        } else {
+            os << static_cast<long long>(value);
+        }
+    });
+}
+
+// Последнее поле читается до конца строки: так разбираются и старые записи
+// с запятой в последнем поле. Недостающие хвостовые поля остаются по умолчанию.
+template <typename T>
+void readText(std::istream &is, T &obj) {
+    std::string line;
+    if (!std::getline(is, line)) return;
+    obj = T();
+    std::stringstream ss(line);
+    std::size_t index = 0;
+    const std::size_t count = fieldCount<T>();
+    forEachField<T>([&](const auto &f) {
+        auto &value = obj.*(f.member);
+        using M = std::decay_t<decltype(value)>;
+        std::string text;
+        bool present = ++index == count ? static_cast<bool>(std::getline(ss, text)) : static_cast<bool>(std::getline(ss, text, ','));
+        if (!present) return;
+        if constexpr (std::is_same_v<M, std::string>) {
+            if constexpr (escapesCommas<T>) std::replace(text.begin(), text.end(), ';', ',');
+            value = text.empty() && f.fallback ? std::string(f.fallback) : text;
+        } else {
+            static_assert(std::is_integral_v<M>, "unsupported field type");
+            value = text.empty() ? M() : static_cast<M>(std::stoll(text));
+        }
+    });
+}
+
+// Разбор без копий для представлений со string_view-полями: строки указывают в line,
+// ';' раскодируется на месте (при escapesCommas<T>), поэтому буфер должен жить не меньше obj
+template <typename T>
+void readView(char *line, std::size_t size, T &obj) {
+    std::size_t pos = 0;
+    std::size_t index = 0;
+    const std::size_t count = fieldCount<T>();
+    forEachField<T>([&](const auto &f) {
+        auto &value = obj.*(f.member);
+        using M = std::decay_t<decltype(value)>;
+        if (pos > size) return;
+        std::size_t end = size;
+        if (++index < count) {
+            auto *comma = static_cast<char *>(std::memchr(line + pos, ',', size - pos));
+            if (comma) end = static_cast<std::size_t>(comma - line);
+        }
+        char *text = line + pos;
+        std::size_t length = end - pos;
+        pos = end + 1;
+        if constexpr (std::is_same_v<M, std::string_view>) {
+            if constexpr (escapesCommas<T>) std::replace(text, text + length, ';', ',');
+            value = length == 0 && f.fallback ? std::string_view(f.fallback) : std::string_view(text, length);
+        } else {
+            static_assert(std::is_integral_v<M>, "unsupported field type");
+            long long number = 0;
+            std::from_chars(text, text + length, number);
+            value = static_cast<M>(number);
+        }
+    });
+}
+
+// Колоночный формат для архивов: значения одного поля идут подряд.
+// Строки — словарь колонки и varint-ссылки (или сами строки, если повторов мало),
+// целые — zigzag-varint разности с предыдущим значением колонки.
+inline void writeVarint(std::string &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline bool readVarint(std::string_view &data, std::uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+        auto byte = static_cast<unsigned char>(data.front());
+        data.remove_prefix(1);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline std::uint64_t zigzag(std::int64_t v) { return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63); }
+inline std::int64_t unzigzag(std::uint64_t v) { return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1); }
+
+inline void writeString(std::string &out, std::string_view s) {
+    writeVarint(out, s.size());
+    out.append(s.data(), s.size());
+}
+
+inline bool readString(std::string_view &data, std::string &s) {
+    std::uint64_t size = 0;
+    if (!readVarint(data, size) || data.size() < size) return false;
+    s.assign(data.data(), static_cast<std::size_t>(size));
+    data.remove_prefix(static_cast<std::size_t>(size));
+    return true;
+}
+
+template <typename T>
+void writeColumns(std::string &out, const std::vector<T> &rows) {
+    writeVarint(out, rows.size());
+    forEachField<T>([&](const auto &f) {
+        using M = std::decay_t<decltype(rows.front().*(f.member))>;
+        if constexpr (isText<M>) {
+            std::unordered_map<std::string_view, std::uint64_t> codes;
+            std::vector<std::string_view> dictionary;
+            for (const auto &row : rows) {
+                std::string_view value = row.*(f.member);
+                if (codes.emplace(value, dictionary.size()).second) dictionary.push_back(value);
+            }
+            bool useDictionary = dictionary.size() * 2 <= rows.size();
+            out.push_back(useDictionary ? 1 : 0);
+            if (useDictionary) {
+                writeVarint(out, dictionary.size());
+                for (auto value : dictionary) writeString(out, value);
+                for (const auto &row : rows) writeVarint(out, codes[row.*(f.member)]);
+            } else {
+                for (const auto &row : rows) writeString(out, row.*(f.member));
+            }
+        } else {
+            std::int64_t previous = 0;
+            for (const auto &row : rows) {
+                auto value = static_cast<std::int64_t>(row.*(f.member));
+                writeVarint(out, zigzag(value - previous));
+                previous = value;
+            }
+        }
+    });
+}
+
+// false — данные обрезаны или повреждены
+template <typename T>
+bool readColumns(std::string_view data, std::vector<T> &rows) {
+    std::uint64_t count = 0;
+    if (!readVarint(data, count) || count > data.size()) return false;
+    rows.assign(static_cast<std::size_t>(count), T());
+    bool ok = true;
+    forEachField<T>([&](const auto &f) {
+        if (!ok) return;
+        using M = std::decay_t<decltype(rows.front().*(f.member))>;
+        if constexpr (isText<M>) {
+            if (data.empty()) { ok = false; return; }
+            bool useDictionary = data.front() == 1;
+            data.remove_prefix(1);
+            if (useDictionary) {
+                std::uint64_t size = 0;
+                ok = readVarint(data, size) && size <= data.size();
+                std::vector<std::string> dictionary(ok ? static_cast<std::size_t>(size) : 0);
+                for (auto &value : dictionary) ok = ok && readString(data, value);
+                for (auto &row : rows) {
+                    std::uint64_t code = 0;
+                    ok = ok && readVarint(data, code) && code < dictionary.size();
+                    if (ok) row.*(f.member) = dictionary[code];
+                }
+            } else {
+                for (auto &row : rows) ok = ok && readString(data, row.*(f.member));
+            }
+        } else {
+            std::int64_t previous = 0;
+            for (auto &row : rows) {
+                std::uint64_t delta = 0;
+                ok = ok && readVarint(data, delta);
+                previous += unzigzag(delta);
+                row.*(f.member) = static_cast<M>(previous);
+            }
+        }
+    });
+    return ok;
+}
+
+}
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <sstream>
 #include "Payment.h"
+#include "Schema.h"
 
 class Transaction : public Payment {
 public:
@@ -18,6 +19,8 @@ public:
     std::string category = "other";  // medicine, sport, food, entertainment, other
     std::string status = "completed";
     std::string cancelReason;
+    long long rate = 0;          // примененный курс (фикс. точка, 1e6), 0 — без конвертации
+    long long creditedCents = 0; // зачислено получателю в его валюте
 
     Transaction() = default;
     Transaction(std::string id_, std::string fromAcc, std::string to, long long c, std::time_t ts, std::string note_, std::string cat = "other")
@@ -26,53 +29,33 @@ public:
     std::string description() const override { return note; }
     long long amountCents() const override { return cents; }
 
-    friend std::ostream &operator<<(std::ostream &os, const Transaction &t) {
-        auto sanitize = [](std::string value) {
-            std::replace(value.begin(), value.end(), '\n', ' ');
-            std::replace(value.begin(), value.end(), ',', ';');
-            return value;
-        };
-        os << t.id << "," << t.fromAccount << "," << t.toCard << "," << t.cents << "," << t.timestamp << ","
-           << sanitize(t.note) << "," << sanitize(t.category) << "," << sanitize(t.status) << "," << sanitize(t.cancelReason);
-        return os;
-    }
+    friend std::ostream &operator<<(std::ostream &os, const Transaction &t);
+    friend std::istream &operator>>(std::istream &is, Transaction &t);
+};
 
-    friend std::istream &operator>>(std::istream &is, Transaction &t) {
-        std::string line;
-        if (!std::getline(is, line)) return is;
-        std::stringstream ss(line);
-        std::string field;
-        auto desanitize = [](std::string value) {
-            std::replace(value.begin(), value.end(), ';', ',');
-            return value;
-        };
-        std::getline(ss, t.id, ',');
-        std::getline(ss, t.fromAccount, ',');
-        std::getline(ss, t.toCard, ',');
-        std::getline(ss, field, ',');
-        if (!field.empty()) t.cents = std::stoll(field);
-        else t.cents = 0;
-        std::getline(ss, field, ',');
-        if (!field.empty()) t.timestamp = static_cast<std::time_t>(std::stoll(field));
-        else t.timestamp = 0;
-        if (std::getline(ss, field, ',')) t.note = desanitize(field); else t.note.clear();
-        if (std::getline(ss, field, ',')) {
-            t.category = field.empty() ? "other" : desanitize(field);
-        } else {
-            t.category = "other";
-        }
-        if (std::getline(ss, field, ',')) {
-            t.status = field.empty() ? "completed" : desanitize(field);
-        } else {
-            t.status = "completed";
-        }
-        if (std::getline(ss, field, ',')) {
-            t.cancelReason = desanitize(field);
-        } else {
-            t.cancelReason.clear();
-        }
-        return is;
-    }
+template <>
+struct Schema<Transaction> {
+    static constexpr bool escapeCommas = true;
+    static constexpr auto fields = std::make_tuple(
+        field("id", &Transaction::id),
+        field("fromAccount", &Transaction::fromAccount),
+        field("toCard", &Transaction::toCard),
+        field("cents", &Transaction::cents),
+        field("timestamp", &Transaction::timestamp),
+        field("note", &Transaction::note),
+        field("category", &Transaction::category, "other"),
+        field("status", &Transaction::status, "completed"),
+        field("cancelReason", &Transaction::cancelReason),
+        field("rate", &Transaction::rate),
+        field("creditedCents", &Transaction::creditedCents));
 };
 
+inline std::ostream &operator<<(std::ostream &os, const Transaction &t) {
+    schema::writeText(os, t);
+    return os;
+}
 
+inline std::istream &operator>>(std::istream &is, Transaction &t) {
+    schema::readText(is, t);
+    return is;
+}
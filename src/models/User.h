@@ -25,7 +25,7 @@ public:
     std::vector<Card> cards;
     std::vector<Transaction> history;
     std::vector<FavoritePayment> favorites;
-    std::vector<std::string> notifications;
+    std::vector<std::string> notifications;  // устаревшее: уведомления живут в NotificationStore, здесь — только для миграции
 
     RegularUser() = default;
     RegularUser(std::string uname, std::string pwhash)
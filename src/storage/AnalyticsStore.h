@@ -0,0 +1,324 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include "UserStorage.h"
+#include "PostingLedger.h"
+#include "UserRepository.h"
+#include "../models/Transaction.h"
+
+namespace storage {
+
+static inline std::filesystem::path analyticsRoot() {
+    return std::filesystem::path("data/analytics");
+}
+
+enum class LedgerEventKind : std::uint8_t { Transfer = 0, Deposit = 1, Cancel = 2 };
+
+// Коды категорий и статусов для колонок (порядок менять нельзя — он в файле)
+static inline std::uint8_t categoryCode(const std::string &category) {
+    static const std::array<const char *, 5> names{"other", "medicine", "sport", "food", "entertainment"};
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (category == names[i]) return static_cast<std::uint8_t>(i);
+    }
+    return 0;
+}
+
+static inline std::string categoryName(std::uint8_t code) {
+    static const std::array<const char *, 5> names{"other", "medicine", "sport", "food", "entertainment"};
+    return code < names.size() ? names[code] : "other";
+}
+
+static inline std::uint8_t statusCode(const std::string &status) {
+    return status == "cancelled" ? 1 : 0;
+}
+
+struct LedgerEvent {
+    LedgerEventKind kind = LedgerEventKind::Transfer;
+    const Transaction *transaction = nullptr;
+    std::string sender;
+    std::string receiver;
+};
+
+struct AnalyticsBucket {
+    std::int64_t bucketStart = 0;
+    int category = -1;  // -1 — без разбивки по категориям
+    std::int64_t count = 0;
+    std::int64_t sumCents = 0;
+};
+
+// Append-only колоночное хранилище событий леджера.
+// Файл events.bin — записи фиксированной длины, в памяти — отдельный вектор на колонку.
+class AnalyticsStore {
+public:
+    static constexpr std::size_t kRecordSize = 28;
+    static constexpr std::int64_t kHour = 3600;
+    static constexpr std::int64_t kDay = 86400;
+    static constexpr std::int64_t kWeek = 7 * 86400;
+
+    static AnalyticsStore &instance() {
+        static AnalyticsStore store;
+        return store;
+    }
+
+    void record(LedgerEventKind kind, const Transaction &t, const std::string &sender, const std::string &receiver) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        Row row;
+        row.timestamp = eventTime(kind, t.id, t.timestamp);
+        row.cents = t.cents;
+        row.sender = userId(sender);
+        row.receiver = userId(receiver);
+        row.category = categoryCode(t.category);
+        row.status = kind == LedgerEventKind::Cancel ? 1 : statusCode(t.status);
+        row.kind = static_cast<std::uint8_t>(kind);
+        append(row, true, true);
+    }
+
+    // Пакетная запись (импорт): события упорядочиваются по времени, файл сбрасывается один раз
+    void recordBatch(std::vector<LedgerEvent> batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::vector<std::pair<std::int64_t, const LedgerEvent *>> ordered;
+        ordered.reserve(batch.size());
+        for (const auto &e : batch) ordered.emplace_back(eventTime(e.kind, e.transaction->id, e.transaction->timestamp), &e);
+        std::stable_sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b){ return a.first < b.first; });
+        for (const auto &[timestamp, event] : ordered) {
+            const auto &e = *event;
+            Row row;
+            row.timestamp = timestamp;
+            row.cents = e.transaction->cents;
+            row.sender = userId(e.sender);
+            row.receiver = userId(e.receiver);
+            row.category = categoryCode(e.transaction->category);
+            row.status = e.kind == LedgerEventKind::Cancel ? 1 : statusCode(e.transaction->status);
+            row.kind = static_cast<std::uint8_t>(e.kind);
+            append(row, true, false);
+        }
+        if (events.is_open()) events.flush();
+    }
+
+    // Сумма и число событий kind в корзинах по bucketSeconds на [from, to).
+    // Недели начинаются с понедельника (UTC).
+    std::vector<AnalyticsBucket> aggregate(LedgerEventKind kind, std::int64_t from, std::int64_t to, std::int64_t bucketSeconds, bool byCategory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::vector<AnalyticsBucket> out;
+        if (bucketSeconds <= 0 || to <= from) return out;
+        const std::int64_t offset = bucketSeconds == kWeek ? 3 * kDay : 0;  // 1970-01-01 — четверг
+        const std::int64_t first = floorDiv(from + offset, bucketSeconds);
+        const std::int64_t last = floorDiv(to - 1 + offset, bucketSeconds);
+        const std::size_t buckets = static_cast<std::size_t>(last - first + 1);
+        const std::size_t width = byCategory ? 5 : 1;
+        if (buckets * width > 10'000'000) return out;
+        std::vector<std::int64_t> counts(buckets * width, 0), sums(buckets * width, 0);
+
+        auto [begin, end] = range(from, to);
+        const std::uint8_t wanted = static_cast<std::uint8_t>(kind);
+        const std::int64_t *ts = timestamps.data();
+        const std::int64_t *cents = amounts.data();
+        const std::uint8_t *kinds = kindCodes.data();
+        const std::uint8_t *cats = categoryCodes.data();
+        for (std::size_t i = begin; i < end; ++i) {
+            if (kinds[i] != wanted || ts[i] < from || ts[i] >= to) continue;
+            std::size_t slot = static_cast<std::size_t>(floorDiv(ts[i] + offset, bucketSeconds) - first) * width;
+            if (byCategory) slot += cats[i] < width ? cats[i] : 0;
+            ++counts[slot];
+            sums[slot] += cents[i];
+        }
+
+        for (std::size_t b = 0; b < buckets; ++b) {
+            for (std::size_t c = 0; c < width; ++c) {
+                std::size_t slot = b * width + c;
+                if (counts[slot] == 0) continue;
+                AnalyticsBucket bucket;
+                bucket.bucketStart = (first + static_cast<std::int64_t>(b)) * bucketSeconds - offset;
+                bucket.category = byCategory ? static_cast<int>(c) : -1;
+                bucket.count = counts[slot];
+                bucket.sumCents = sums[slot];
+                out.push_back(bucket);
+            }
+        }
+        return out;
+    }
+
+    std::size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        return timestamps.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (events.is_open()) events.close();
+        std::error_code ec;
+        std::filesystem::remove_all(analyticsRoot(), ec);
+        timestamps.clear(); amounts.clear(); senders.clear(); receivers.clear();
+        categoryCodes.clear(); statusCodes.clear(); kindCodes.clear();
+        userNames.assign(1, std::string());
+        userIds.clear();
+        sorted = true;
+        loaded = true;
+        std::filesystem::create_directories(analyticsRoot());
+        events.open(eventsPath(), std::ios::binary | std::ios::trunc);
+    }
+
+private:
+    struct Row {
+        std::int64_t timestamp = 0;
+        std::int64_t cents = 0;
+        std::uint32_t sender = 0;
+        std::uint32_t receiver = 0;
+        std::uint8_t category = 0;
+        std::uint8_t status = 0;
+        std::uint8_t kind = 0;
+    };
+
+    std::mutex mutex;
+    std::ofstream events;
+    bool loaded = false;
+    bool sorted = true;  // timestamps неубывающие — можно искать диапазон бинарным поиском
+
+    std::vector<std::int64_t> timestamps;
+    std::vector<std::int64_t> amounts;
+    std::vector<std::uint32_t> senders;
+    std::vector<std::uint32_t> receivers;
+    std::vector<std::uint8_t> categoryCodes;
+    std::vector<std::uint8_t> statusCodes;
+    std::vector<std::uint8_t> kindCodes;
+
+    std::vector<std::string> userNames{std::string()};  // id 0 — внешний/неизвестный
+    std::unordered_map<std::string, std::uint32_t> userIds;
+
+    AnalyticsStore() = default;
+
+    static std::filesystem::path eventsPath() { return analyticsRoot() / "events.bin"; }
+    static std::filesystem::path usersPath() { return analyticsRoot() / "users.txt"; }
+
+    static std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+        std::int64_t q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    // Одно правило для живой записи, импорта и первичного наполнения: отмена учитывается
+    // временем проводки сторно в журнале, а если ее там нет (старые данные) — временем платежа
+    static std::int64_t eventTime(LedgerEventKind kind, const std::string &transactionId, std::time_t timestamp) {
+        LedgerEntry cancel;
+        if (kind == LedgerEventKind::Cancel && PostingLedger::instance().find(transactionId, "cancel", cancel)) return cancel.timestamp;
+        return timestamp;
+    }
+
+    std::pair<std::size_t, std::size_t> range(std::int64_t from, std::int64_t to) const {
+        if (!sorted) return {0, timestamps.size()};
+        auto lo = std::lower_bound(timestamps.begin(), timestamps.end(), from);
+        auto hi = std::lower_bound(lo, timestamps.end(), to);
+        return {static_cast<std::size_t>(lo - timestamps.begin()), static_cast<std::size_t>(hi - timestamps.begin())};
+    }
+
+    std::uint32_t userId(const std::string &name) {
+        if (name.empty()) return 0;
+        auto it = userIds.find(name);
+        if (it != userIds.end()) return it->second;
+        auto id = static_cast<std::uint32_t>(userNames.size());
+        userNames.push_back(name);
+        userIds.emplace(name, id);
+        std::ofstream ofs(usersPath(), std::ios::app);
+        ofs << name << "\n";
+        return id;
+    }
+
+    void append(const Row &row, bool persist, bool flush = true) {
+        if (!timestamps.empty() && row.timestamp < timestamps.back()) sorted = false;
+        timestamps.push_back(row.timestamp);
+        amounts.push_back(row.cents);
+        senders.push_back(row.sender);
+        receivers.push_back(row.receiver);
+        categoryCodes.push_back(row.category);
+        statusCodes.push_back(row.status);
+        kindCodes.push_back(row.kind);
+        if (!persist) return;
+        char buf[kRecordSize] = {};
+        std::memcpy(buf, &row.timestamp, 8);
+        std::memcpy(buf + 8, &row.cents, 8);
+        std::memcpy(buf + 16, &row.sender, 4);
+        std::memcpy(buf + 20, &row.receiver, 4);
+        buf[24] = static_cast<char>(row.category);
+        buf[25] = static_cast<char>(row.status);
+        buf[26] = static_cast<char>(row.kind);
+        if (!events.is_open()) events.open(eventsPath(), std::ios::binary | std::ios::app);
+        if (!events) throw BankingError("Cannot write analytics: " + eventsPath().string());
+        events.write(buf, kRecordSize);
+        if (flush) events.flush();
+    }
+
+    void ensureLoaded() {
+        if (loaded) return;
+        loaded = true;
+        std::filesystem::create_directories(analyticsRoot());
+        bool fresh = !std::filesystem::exists(eventsPath());
+
+        std::ifstream names(usersPath());
+        std::string line;
+        while (std::getline(names, line)) {
+            userIds.emplace(line, static_cast<std::uint32_t>(userNames.size()));
+            userNames.push_back(line);
+        }
+
+        std::ifstream ifs(eventsPath(), std::ios::binary);
+        if (ifs) {
+            auto bytes = std::filesystem::file_size(eventsPath());
+            std::size_t n = static_cast<std::size_t>(bytes / kRecordSize);
+            for (auto *column : {&timestamps, &amounts}) column->reserve(n);
+            char buf[kRecordSize];
+            while (ifs.read(buf, kRecordSize)) {
+                Row row;
+                std::memcpy(&row.timestamp, buf, 8);
+                std::memcpy(&row.cents, buf + 8, 8);
+                std::memcpy(&row.sender, buf + 16, 4);
+                std::memcpy(&row.receiver, buf + 20, 4);
+                row.category = static_cast<std::uint8_t>(buf[24]);
+                row.status = static_cast<std::uint8_t>(buf[25]);
+                row.kind = static_cast<std::uint8_t>(buf[26]);
+                append(row, false);
+            }
+        }
+        if (fresh) backfill();
+    }
+
+    // Первый запуск: события восстанавливаются из историй пользователей
+    void backfill() {
+        UserRepository::instance().flush();
+        std::vector<Row> rows;
+        UserStorage::forEachTransaction([&](const UserView &u, const TransactionView &t) {
+            bool outgoing = std::any_of(u.accounts.begin(), u.accounts.end(), [&](const AccountView &a){ return a.accountNumber == t.fromAccount; });
+            std::uint32_t user = userId(std::string(u.username));
+            Row row;
+            row.timestamp = t.timestamp;
+            row.cents = t.cents;
+            row.sender = outgoing ? user : 0;
+            row.receiver = outgoing ? 0 : user;
+            row.category = categoryCode(std::string(t.category));
+            row.status = statusCode(std::string(t.status));
+            row.kind = static_cast<std::uint8_t>(outgoing ? LedgerEventKind::Transfer : LedgerEventKind::Deposit);
+            rows.push_back(row);
+            if (row.status == 1) {
+                row.kind = static_cast<std::uint8_t>(LedgerEventKind::Cancel);
+                row.timestamp = eventTime(LedgerEventKind::Cancel, std::string(t.id), t.timestamp);
+                rows.push_back(row);
+            }
+        }, SectionAccounts);
+        std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b){ return a.timestamp < b.timestamp; });
+        for (const auto &row : rows) append(row, true);
+    }
+};
+
+}
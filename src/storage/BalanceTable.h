@@ -0,0 +1,253 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+static inline std::filesystem::path ledgerRoot() {
+    return std::filesystem::path("data/ledger");
+}
+
+// Запись счета — ровно одна строка кэша
+struct BalanceRecord {
+    char account[32];           // номер счета, дополненный нулями
+    std::uint32_t ownerId;      // строка owners.txt, 0 — без владельца
+    char currency[4];
+    std::int64_t balanceCents;
+    std::uint64_t version;      // растет при каждом изменении баланса
+    char reserved[8];
+};
+static_assert(sizeof(BalanceRecord) == 64, "BalanceRecord must stay 64 bytes");
+
+// Балансы клиентских счетов в отображенном в память файле balances.tbl: заголовок и плотный
+// массив BalanceRecord. Зачисление и списание — сложение на месте с новой версией записи,
+// без разбора и перезаписи файла пользователя. Файлы пользователей при чтении получают
+// балансы отсюда (overlay). В заголовке — последний примененный seq журнала проводок:
+// по нему журнал при загрузке понимает, нужно ли перестроить таблицу.
+class BalanceTable {
+public:
+    static constexpr std::size_t kMaxAccountLength = sizeof(BalanceRecord::account) - 1;
+
+    static BalanceTable &instance() {
+        static BalanceTable table;
+        return table;
+    }
+
+    static bool fits(const std::string &account) { return !account.empty() && account.size() <= kMaxAccountLength; }
+
+    long long balance(const std::string &account) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        auto it = slotByAccount.find(account);
+        return it != slotByAccount.end() ? record(it->second)->balanceCents : 0;
+    }
+
+    // Создает запись, если ее нет; владелец и валюта существующей записи не меняются
+    void ensure(const std::string &account, const std::string &owner, const std::string &currency) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        slotFor(account, owner, currency);
+    }
+
+    // Возвращает новую версию записи
+    std::uint64_t add(const std::string &account, long long deltaCents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        auto *r = record(slotFor(account, std::string(), std::string()));
+        r->balanceCents += deltaCents;
+        return ++r->version;
+    }
+
+    void set(const std::string &account, long long balanceCents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        auto *r = record(slotFor(account, std::string(), std::string()));
+        if (r->balanceCents == balanceCents) return;
+        r->balanceCents = balanceCents;
+        ++r->version;
+    }
+
+    long long appliedSeq() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        return header()->appliedSeq;
+    }
+
+    void setAppliedSeq(long long seq) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        header()->appliedSeq = seq;
+    }
+
+    // Подставляет балансы из таблицы в счета, прочитанные из файла
+    template <typename TAccounts>
+    void overlay(TAccounts &accounts) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        for (auto &a : accounts) {
+            auto it = slotByAccount.find(std::string(a.accountNumber));
+            if (it != slotByAccount.end()) a.balanceCents = record(it->second)->balanceCents;
+        }
+    }
+
+    // Суммы по владельцам одним проходом по массиву
+    std::unordered_map<std::string, long long> totalsByOwner() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        std::vector<long long> totals(owners.size(), 0);
+        const auto *records = record(0);
+        for (std::uint32_t i = 0, n = header()->count; i < n; ++i) {
+            if (records[i].ownerId < totals.size()) totals[records[i].ownerId] += records[i].balanceCents;
+        }
+        std::unordered_map<std::string, long long> out;
+        for (std::size_t id = 1; id < owners.size(); ++id) out[owners[id]] += totals[id];
+        return out;
+    }
+
+    // Удаление пользователя: его записи остаются (их суммы есть в журнале), но без владельца,
+    // так что пользователь с тем же именем не унаследует ни счета, ни итоги
+    void releaseOwner(const std::string &owner) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureOpen();
+        auto it = ownerIds.find(owner);
+        if (it == ownerIds.end()) return;
+        for (std::uint32_t i = 0, n = header()->count; i < n; ++i) {
+            if (record(i)->ownerId == it->second) record(i)->ownerId = 0;
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        close();
+        std::error_code ec;
+        std::filesystem::remove(tablePath(), ec);
+        std::filesystem::remove(ownersPath(), ec);
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        std::uint32_t recordSize;
+        std::uint32_t count;
+        std::uint32_t capacity;
+        std::uint32_t reserved;
+        std::int64_t appliedSeq;
+        char padding[32];
+    };
+    static_assert(sizeof(Header) == sizeof(BalanceRecord), "header occupies one record slot");
+
+    static constexpr char kMagic[8] = {'B', 'A', 'L', 'T', 'B', 'L', '0', '1'};
+    static constexpr std::uint32_t kInitialCapacity = 1024;
+
+    std::mutex mutex;
+    MappedFile file;
+    unsigned char *base = nullptr;
+    std::unordered_map<std::string, std::uint32_t> slotByAccount;
+    std::vector<std::string> owners{std::string()};
+    std::unordered_map<std::string, std::uint32_t> ownerIds;
+
+    BalanceTable() = default;
+    ~BalanceTable() { close(); }
+
+    static std::filesystem::path tablePath() { return ledgerRoot() / "balances.tbl"; }
+    static std::filesystem::path ownersPath() { return ledgerRoot() / "owners.txt"; }
+
+    Header *header() { return reinterpret_cast<Header *>(base); }
+    BalanceRecord *record(std::uint32_t slot) { return reinterpret_cast<BalanceRecord *>(base) + 1 + slot; }
+
+    void close() {
+        base = nullptr;
+        file.close();
+        slotByAccount.clear();
+        owners.assign(1, std::string());
+        ownerIds.clear();
+    }
+
+    void ensureOpen() {
+        if (base) return;
+        std::filesystem::create_directories(ledgerRoot());
+        if (!file.open(tablePath())) throw BankingError("Cannot open balance table: " + tablePath().string());
+        bool fresh = file.size() < sizeof(Header);
+        if (fresh && !file.resize(sizeof(Header) * (1 + kInitialCapacity))) {
+            throw BankingError("Cannot resize balance table: " + tablePath().string());
+        }
+        mapFile();
+        if (fresh || std::memcmp(header()->magic, kMagic, sizeof(kMagic)) != 0 || header()->recordSize != sizeof(BalanceRecord)) {
+            // новая или чужая таблица: пустая, журнал перестроит ее при загрузке
+            std::memset(base, 0, sizeof(Header));
+            std::memcpy(header()->magic, kMagic, sizeof(kMagic));
+            header()->recordSize = sizeof(BalanceRecord);
+            header()->capacity = static_cast<std::uint32_t>(file.size() / sizeof(BalanceRecord)) - 1;
+            header()->appliedSeq = -1;
+        }
+
+        std::ifstream ifs(ownersPath());
+        std::string name;
+        while (std::getline(ifs, name)) {
+            ownerIds.emplace(name, static_cast<std::uint32_t>(owners.size()));
+            owners.push_back(name);
+        }
+        for (std::uint32_t i = 0, n = header()->count; i < n; ++i) slotByAccount.emplace(std::string(record(i)->account), i);
+    }
+
+    void mapFile() {
+        base = file.data();
+        if (!base) throw BankingError("Cannot map balance table: " + tablePath().string());
+    }
+
+    std::uint32_t slotFor(const std::string &account, const std::string &owner, const std::string &currency) {
+        auto it = slotByAccount.find(account);
+        if (it != slotByAccount.end()) {
+            auto *r = record(it->second);
+            if (r->ownerId == 0 && !owner.empty()) r->ownerId = ownerId(owner);
+            if (r->currency[0] == '\0' && !currency.empty()) std::strncpy(r->currency, currency.c_str(), sizeof(r->currency) - 1);
+            return it->second;
+        }
+        if (!fits(account)) throw ValidationError("Слишком длинный номер счета: " + account);
+        if (header()->count == header()->capacity) grow();
+        std::uint32_t slot = header()->count;
+        auto *r = record(slot);
+        std::memset(r, 0, sizeof(BalanceRecord));
+        std::memcpy(r->account, account.data(), account.size());
+        r->ownerId = ownerId(owner);
+        std::strncpy(r->currency, currency.c_str(), sizeof(r->currency) - 1);
+        // счетчик увеличивается после заполнения записи: оборванная запись не попадет в таблицу
+        header()->count = slot + 1;
+        slotByAccount.emplace(account, slot);
+        return slot;
+    }
+
+    void grow() {
+        std::uint32_t capacity = header()->capacity * 2;
+        base = nullptr;
+        if (!file.resize(static_cast<std::uint64_t>(sizeof(BalanceRecord)) * (1 + capacity))) {
+            mapFile();
+            throw BankingError("Cannot resize balance table: " + tablePath().string());
+        }
+        mapFile();
+        header()->capacity = capacity;
+    }
+
+    std::uint32_t ownerId(const std::string &name) {
+        if (name.empty()) return 0;
+        auto it = ownerIds.find(name);
+        if (it != ownerIds.end()) return it->second;
+        auto id = static_cast<std::uint32_t>(owners.size());
+        owners.push_back(name);
+        ownerIds.emplace(name, id);
+        std::ofstream ofs(ownersPath(), std::ios::app);
+        ofs << name << "\n";
+        return id;
+    }
+};
+
+}
@@ -0,0 +1,427 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "UserStorage.h"
+#include "UserRepository.h"
+#include "IdAllocator.h"
+#include "AnalyticsStore.h"
+#include "PostingLedger.h"
+#include "../models/User.h"
+#include "../utils/Exceptions.h"
+#include "../utils/Utils.h"
+
+namespace storage {
+
+struct ImportReport {
+    std::size_t rows = 0;
+    std::size_t accepted = 0;
+    std::size_t rejected = 0;
+    std::size_t users = 0;
+    double seconds = 0;
+    double rowsPerSecond = 0;
+    std::vector<std::string> errors;  // первые kMaxErrors, "строка N: причина"
+};
+
+// Импорт выгрузок старых систем. Строки файла — записи четырех видов:
+//   CSV:    user,<name>,<passwordHash>
+//           account,<user>,<number>,<currency>,<balanceCents>
+//           card,<user>,<number>,<holderName>,<expiry>,<linkedAccount>
+//           transaction,<user>,<поля Transaction через запятую>
+//   NDJSON: {"type":"account","user":"...","accountNumber":"...",...} — имена полей как в моделях
+// Файл режется на куски по границам строк и разбирается параллельно; записи группируются
+// по пользователю, проверяются ссылки (карта -> linkedAccount, операция -> счет пользователя),
+// номера счетов и карт и id операций, уже занятые в хранилище, отклоняются, а счетчик
+// идентификаторов переносится за импортированные;
+// каждый файл пользователя пишется ровно один раз, манифест и индексы обновляются тем же проходом.
+class BulkImporter {
+public:
+    static constexpr std::size_t kMaxErrors = 100;
+
+    static ImportReport run(const std::filesystem::path &path, unsigned threads = 0) {
+        auto started = std::chrono::steady_clock::now();
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) throw NotFoundError("Файл импорта не найден: " + path.string());
+        std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        auto ext = path.extension().string();
+        bool json = ext == ".ndjson" || ext == ".jsonl" || ext == ".json";
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        // файлы дополняются с диска: отложенные изменения должны быть уже там
+        UserRepository::instance().flush();
+
+        // 1. параллельный разбор кусков
+        auto bounds = split(text, threads);
+        std::vector<Chunk> chunks(bounds.size());
+        {
+            std::vector<std::thread> pool;
+            for (std::size_t i = 0; i < bounds.size(); ++i) {
+                pool.emplace_back([&, i]() { parse(text, bounds[i].first, bounds[i].second, json, chunks[i]); });
+            }
+            for (auto &t : pool) t.join();
+        }
+
+        // 2. слияние по пользователям в порядке файла, сквозная нумерация строк
+        ImportReport report;
+        std::map<std::string, Staged> staged;
+        std::size_t lineBase = 0;
+        for (auto &chunk : chunks) {
+            report.rows += chunk.rows;
+            for (auto &[line, message] : chunk.errors) reject(report, lineBase + line, message);
+            for (auto &[name, part] : chunk.users) {
+                auto &target = staged[name];
+                for (auto &user : part.users) { user.line += lineBase; target.users.push_back(std::move(user)); }
+                for (auto &a : part.accounts) { a.line += lineBase; target.accounts.push_back(std::move(a)); }
+                for (auto &c : part.cards) { c.line += lineBase; target.cards.push_back(std::move(c)); }
+                for (auto &t : part.transactions) { t.line += lineBase; target.transactions.push_back(std::move(t)); }
+            }
+            lineBase += chunk.lines;
+        }
+
+        // 3. проверка ссылок и сборка пользователей; номера и id уникальны по всему хранилищу
+        std::unordered_set<std::string> accountNumbers, cardNumbers, transactionIds;
+        UserStorage::forEachUser([&](const UserView &u) {
+            for (const auto &a : u.accounts) accountNumbers.emplace(a.accountNumber);
+            for (const auto &c : u.cards) cardNumbers.emplace(c.cardNumber);
+            for (const auto &t : u.history) transactionIds.emplace(t.id);
+        }, SectionAccounts | SectionCards | SectionHistory);
+        std::vector<RegularUser> users;
+        std::vector<std::size_t> firstImported;  // история до этого индекса уже была в хранилище
+        users.reserve(staged.size());
+        for (auto &[name, part] : staged) {
+            RegularUser user;
+            if (!part.users.empty()) {
+                for (std::size_t i = 1; i < part.users.size(); ++i) reject(report, part.users[i].line, "повторная запись пользователя " + name);
+                if (UserStorage::exists(name)) {
+                    reject(report, part.users.front().line, "пользователь уже существует: " + name);
+                    dropAll(report, part, "пользователь " + name + " не импортирован");
+                    continue;
+                }
+                user = RegularUser(name, part.users.front().item.passwordHash);
+                ++report.accepted;
+            } else if (UserStorage::exists(name)) {
+                user = UserStorage::loadUser(name);  // дополнение существующего
+            } else {
+                dropAll(report, part, "нет записи user для " + name);
+                continue;
+            }
+
+            for (auto &a : part.accounts) {
+                if (a.item.accountNumber.empty() || a.item.currency.empty()) { reject(report, a.line, "неполная запись счета"); continue; }
+                if (!accountNumbers.insert(a.item.accountNumber).second) { reject(report, a.line, "счет уже существует: " + a.item.accountNumber); continue; }
+                user.accounts.push_back(std::move(a.item));
+                ++report.accepted;
+            }
+            auto ownsAccount = [&](const std::string &number) {
+                return std::any_of(user.accounts.begin(), user.accounts.end(), [&](const Account &a){ return a.accountNumber == number; });
+            };
+            for (auto &c : part.cards) {
+                if (c.item.cardNumber.empty()) { reject(report, c.line, "пустой номер карты"); continue; }
+                if (!ownsAccount(c.item.linkedAccount)) { reject(report, c.line, "карта ссылается на чужой или несуществующий счет " + c.item.linkedAccount); continue; }
+                if (!cardNumbers.insert(c.item.cardNumber).second) { reject(report, c.line, "карта уже существует: " + c.item.cardNumber); continue; }
+                user.cards.push_back(std::move(c.item));
+                ++report.accepted;
+            }
+            firstImported.push_back(user.history.size());
+            auto ownsCard = [&](const std::string &number) {
+                return std::any_of(user.cards.begin(), user.cards.end(), [&](const Card &c){ return c.cardNumber == number; });
+            };
+            for (auto &t : part.transactions) {
+                if (t.item.id.empty() || t.item.cents < 0) { reject(report, t.line, "неполная запись операции"); continue; }
+                if (!ownsAccount(t.item.fromAccount) && !ownsAccount(t.item.toCard) && !ownsCard(t.item.toCard)) {
+                    reject(report, t.line, "операция " + t.item.id + " не связана со счетами " + name);
+                    continue;
+                }
+                if (!transactionIds.insert(t.item.id).second) { reject(report, t.line, "операция уже существует: " + t.item.id); continue; }
+                user.history.push_back(std::move(t.item));
+                ++report.accepted;
+            }
+            users.push_back(std::move(user));
+        }
+
+        // 4. аналитика загружается до записи файлов, иначе ее первичное наполнение учло бы импорт дважды
+        auto &analytics = AnalyticsStore::instance();
+        analytics.size();
+        std::unordered_map<std::string, std::string> owners;
+        for (const auto &u : users) {
+            for (const auto &a : u.accounts) owners.emplace(a.accountNumber, u.usernameValue);
+            for (const auto &c : u.cards) owners.emplace(c.cardNumber, u.usernameValue);
+        }
+
+        UserStorage::saveUsers(users, threads);
+        report.users = users.size();
+        // дополненные файлы записаны мимо хранилища: загруженные версии перечитаются
+        for (const auto &u : users) UserRepository::instance().evict(u.usernameValue);
+
+        // 5. индексы тем же проходом
+        std::vector<std::string> accountIds, cardIds, txIds;
+        std::vector<LedgerEvent> events;
+        for (std::size_t i = 0; i < users.size(); ++i) {
+            const auto &u = users[i];
+            for (const auto &a : u.accounts) accountIds.push_back(a.accountNumber);
+            for (const auto &c : u.cards) cardIds.push_back(c.cardNumber);
+            for (auto it = u.history.begin() + static_cast<std::ptrdiff_t>(firstImported[i]); it != u.history.end(); ++it) {
+                const auto &t = *it;
+                txIds.push_back(t.id);
+                bool outgoing = std::any_of(u.accounts.begin(), u.accounts.end(), [&](const Account &a){ return a.accountNumber == t.fromAccount; });
+                LedgerEvent e;
+                e.kind = outgoing ? LedgerEventKind::Transfer : LedgerEventKind::Deposit;
+                e.transaction = &t;
+                if (outgoing) {
+                    e.sender = u.usernameValue;
+                    auto owner = owners.find(t.toCard);
+                    if (owner != owners.end()) e.receiver = owner->second;
+                } else {
+                    e.receiver = u.usernameValue;
+                }
+                events.push_back(e);
+                if (t.status == "cancelled") {
+                    e.kind = LedgerEventKind::Cancel;
+                    events.push_back(e);
+                }
+            }
+        }
+        auto &ids = IdAllocator::instance();
+        ids.advancePast(IdKind::Account, accountIds);
+        ids.advancePast(IdKind::Card, cardIds);
+        ids.advancePast(IdKind::Transaction, txIds);
+        analytics.recordBatch(std::move(events));
+        // балансы файлов импорта становятся входящими остатками в журнале проводок
+        std::vector<const RegularUser *> adopted;
+        for (const auto &u : users) adopted.push_back(&u);
+        PostingLedger::instance().adoptAll(adopted);
+
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        report.rowsPerSecond = report.seconds > 0 ? report.rows / report.seconds : 0;
+        return report;
+    }
+
+private:
+    struct UserRecord {
+        std::string passwordHash;
+    };
+
+    template <typename T>
+    struct Item {
+        std::size_t line = 0;  // номер строки в файле, с 1
+        T item;
+    };
+
+    struct Staged {
+        std::vector<Item<UserRecord>> users;
+        std::vector<Item<Account>> accounts;
+        std::vector<Item<Card>> cards;
+        std::vector<Item<Transaction>> transactions;
+    };
+
+    struct Chunk {
+        std::size_t rows = 0;
+        std::size_t lines = 0;
+        std::unordered_map<std::string, Staged> users;
+        std::vector<std::pair<std::size_t, std::string>> errors;
+    };
+
+    using Fields = std::unordered_map<std::string, std::string>;
+
+    static void reject(ImportReport &report, std::size_t line, const std::string &message) {
+        ++report.rejected;
+        if (report.errors.size() < kMaxErrors) report.errors.push_back("строка " + std::to_string(line) + ": " + message);
+    }
+
+    static void dropAll(ImportReport &report, const Staged &part, const std::string &message) {
+        for (const auto &a : part.accounts) reject(report, a.line, message);
+        for (const auto &c : part.cards) reject(report, c.line, message);
+        for (const auto &t : part.transactions) reject(report, t.line, message);
+    }
+
+    // Куски примерно равного размера, граница сдвигается до конца строки
+    static std::vector<std::pair<std::size_t, std::size_t>> split(const std::string &text, unsigned parts) {
+        std::vector<std::pair<std::size_t, std::size_t>> out;
+        const std::size_t minChunk = 1 << 20;
+        std::size_t size = std::max<std::size_t>(text.size() / std::max(parts, 1u), minChunk);
+        std::size_t begin = 0;
+        while (begin < text.size()) {
+            std::size_t end = std::min(begin + size, text.size());
+            if (end < text.size()) {
+                auto nl = text.find('\n', end);
+                end = nl == std::string::npos ? text.size() : nl + 1;
+            }
+            out.emplace_back(begin, end);
+            begin = end;
+        }
+        return out;
+    }
+
+    static void parse(const std::string &text, std::size_t begin, std::size_t end, bool json, Chunk &chunk) {
+        while (begin < end) {
+            std::size_t nl = text.find('\n', begin);
+            if (nl == std::string::npos || nl > end) nl = end;
+            std::string line = text.substr(begin, nl - begin);
+            begin = nl + 1;
+            ++chunk.lines;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (utils::trim(line).empty() || line[0] == '#') continue;
+            ++chunk.rows;
+            try {
+                if (json) parseJsonRow(line, chunk);
+                else parseCsvRow(line, chunk);
+            } catch (const std::exception &e) {
+                chunk.errors.emplace_back(chunk.lines, e.what());
+            }
+        }
+    }
+
+    static void parseCsvRow(const std::string &line, Chunk &chunk) {
+        std::stringstream ss(line);
+        std::string kind, user;
+        std::getline(ss, kind, ',');
+        std::getline(ss, user, ',');
+        kind = utils::trim(kind);
+        user = utils::trim(user);
+        if (user.empty()) throw ValidationError("нет имени пользователя");
+        auto &staged = chunk.users[user];
+        if (kind == "user") {
+            UserRecord r;
+            std::getline(ss, r.passwordHash);
+            staged.users.push_back({chunk.lines, r});
+        } else if (kind == "account") {
+            Account a;
+            ss >> a;
+            staged.accounts.push_back({chunk.lines, a});
+        } else if (kind == "card") {
+            Card c;
+            ss >> c;
+            staged.cards.push_back({chunk.lines, c});
+        } else if (kind == "transaction") {
+            Transaction t;
+            ss >> t;
+            staged.transactions.push_back({chunk.lines, t});
+        } else {
+            throw ValidationError("неизвестный тип записи: " + kind);
+        }
+    }
+
+    static void parseJsonRow(const std::string &line, Chunk &chunk) {
+        Fields f = parseFlatObject(line);
+        auto get = [&](const char *key) {
+            auto it = f.find(key);
+            return it == f.end() ? std::string() : it->second;
+        };
+        std::string kind = get("type");
+        std::string user = get("user");
+        if (user.empty()) throw ValidationError("нет имени пользователя");
+        auto &staged = chunk.users[user];
+        if (kind == "user") {
+            staged.users.push_back({chunk.lines, UserRecord{get("passwordHash")}});
+        } else if (kind == "account") {
+            staged.accounts.push_back({chunk.lines, fromFields<Account>(f)});
+        } else if (kind == "card") {
+            staged.cards.push_back({chunk.lines, fromFields<Card>(f)});
+        } else if (kind == "transaction") {
+            staged.transactions.push_back({chunk.lines, fromFields<Transaction>(f)});
+        } else {
+            throw ValidationError("неизвестный тип записи: " + kind);
+        }
+    }
+
+    // Поля модели по именам из Schema<T>; отсутствующие остаются по умолчанию
+    template <typename T>
+    static T fromFields(const Fields &f) {
+        T obj;
+        schema::forEachField<T>([&](const auto &d) {
+            auto it = f.find(std::string(d.name));
+            if (it == f.end()) return;
+            auto &value = obj.*(d.member);
+            using M = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<M, std::string>) {
+                value = it->second.empty() && d.fallback ? std::string(d.fallback) : it->second;
+            } else {
+                value = it->second.empty() ? M() : static_cast<M>(std::stoll(it->second));
+            }
+        });
+        return obj;
+    }
+
+    // Плоский JSON-объект: строки, числа, true/false/null; вложенные объекты не поддерживаются
+    static Fields parseFlatObject(const std::string &line) {
+        Fields out;
+        std::size_t i = 0;
+        auto skip = [&]() { while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) ++i; };
+        auto expect = [&](char ch) {
+            skip();
+            if (i >= line.size() || line[i] != ch) throw ValidationError(std::string("ожидался символ ") + ch);
+            ++i;
+        };
+        auto readString = [&]() {
+            expect('"');
+            std::string s;
+            while (i < line.size() && line[i] != '"') {
+                char ch = line[i++];
+                if (ch != '\\' || i >= line.size()) { s += ch; continue; }
+                char esc = line[i++];
+                switch (esc) {
+                case 'n': s += '\n'; break;
+                case 't': s += '\t'; break;
+                case 'r': s += '\r'; break;
+                case 'u': {
+                    if (i + 4 > line.size()) throw ValidationError("неверная escape-последовательность");
+                    unsigned cp = static_cast<unsigned>(std::stoul(line.substr(i, 4), nullptr, 16));
+                    i += 4;
+                    if (cp < 0x80) {
+                        s += static_cast<char>(cp);
+                    } else if (cp < 0x800) {
+                        s += static_cast<char>(0xC0 | (cp >> 6));
+                        s += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else {
+                        s += static_cast<char>(0xE0 | (cp >> 12));
+                        s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        s += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    break;
+                }
+                default: s += esc;
+                }
+            }
+            if (i >= line.size()) throw ValidationError("незакрытая строка");
+            ++i;
+            return s;
+        };
+        expect('{');
+        skip();
+        if (i < line.size() && line[i] == '}') return out;
+        while (true) {
+            std::string key = readString();
+            expect(':');
+            skip();
+            std::string value;
+            if (i < line.size() && line[i] == '"') {
+                value = readString();
+            } else {
+                std::size_t start = i;
+                while (i < line.size() && line[i] != ',' && line[i] != '}') ++i;
+                value = utils::trim(line.substr(start, i - start));
+                if (value == "null") value.clear();
+            }
+            out[key] = value;
+            skip();
+            if (i < line.size() && line[i] == ',') { ++i; continue; }
+            expect('}');
+            break;
+        }
+        return out;
+    }
+};
+
+}
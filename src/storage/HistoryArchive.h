@@ -0,0 +1,423 @@
+#pragma once
+
+#include <QByteArray>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "../models/Transaction.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+static inline std::filesystem::path archiveRoot() {
+    return std::filesystem::path("data/archive");
+}
+
+static inline std::filesystem::path receiptsRoot() {
+    return std::filesystem::path("data/receipts");
+}
+
+// Холодное хранилище. История: <user>.arc — сжатые qCompress блоки по kBlockSize операций
+// в колоночном формате Schema (словари счетов/категорий/статусов, дельты времени),
+// <user>.idx — строка на блок: смещение, размер, число операций, min/max времени;
+// ids.idx — общий индекс id операции -> пользователь и номер блока (в памяти — хеш-таблица),
+// так что поиск операции разжимает один блок. Строки ids.idx пишутся до строки блока:
+// ссылка на незаписанный блок при чтении отбрасывается.
+// Операции уходят в архив префиксом истории, так что их сквозные номера не меняются:
+// архивные — [0, archivedCount), дальше — история в файле пользователя.
+// Чеки: пачки по kReceiptsPerBlock в receipts.arc, receipts.idx — блоки и положение чека в блоке.
+// Чтение разжимает только блоки, которые нужны запросу.
+class HistoryArchive {
+public:
+    static constexpr std::size_t kBlockSize = 256;
+    static constexpr std::size_t kReceiptsPerBlock = 64;
+
+    struct Block {
+        std::uint64_t offset = 0;
+        std::uint64_t bytes = 0;
+        std::size_t count = 0;
+        long long minTimestamp = 0;
+        long long maxTimestamp = 0;
+    };
+
+    static std::vector<Block> blocks(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex());
+        return readIndex(indexPath(username));
+    }
+
+    static std::size_t archivedCount(const std::string &username) {
+        std::size_t total = 0;
+        for (const auto &b : blocks(username)) total += b.count;
+        return total;
+    }
+
+    // Дописывает операции блоками; возвращает число записанных блоков. Уже архивные операции
+    // пропускаются: если после прошлого переноса не записался файл пользователя, повтор
+    // только дочищает его историю, не дублируя архив
+    static std::size_t append(const std::string &username, const std::vector<Transaction> &all) {
+        std::lock_guard<std::mutex> lock(mutex());
+        auto &ids = idIndex();
+        auto committed = readIndex(indexPath(username)).size();
+        std::vector<Transaction> items;
+        for (const auto &t : all) {
+            if (!ids.locate(t.id, username, committed)) items.push_back(t);
+        }
+        if (items.empty()) return 0;
+        std::filesystem::create_directories(archiveRoot());
+        std::ofstream data(dataPath(username), std::ios::binary | std::ios::app);
+        std::ofstream index(indexPath(username), std::ios::app);
+        if (!data || !index) throw BankingError("Cannot write archive: " + dataPath(username).string());
+        std::error_code ec;
+        auto offset = std::filesystem::exists(dataPath(username)) ? std::filesystem::file_size(dataPath(username), ec) : 0;
+        std::size_t written = 0;
+        for (std::size_t start = 0; start < items.size(); start += kBlockSize) {
+            std::vector<Transaction> chunk(items.begin() + static_cast<std::ptrdiff_t>(start),
+                                           items.begin() + static_cast<std::ptrdiff_t>(std::min(items.size(), start + kBlockSize)));
+            std::string raw;
+            schema::writeColumns(raw, chunk);
+            auto packed = compress(raw);
+            data.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+            data.flush();
+            if (!data) throw BankingError("Cannot write archive: " + dataPath(username).string());
+            auto [minIt, maxIt] = std::minmax_element(chunk.begin(), chunk.end(), [](const Transaction &a, const Transaction &b){
+                return a.timestamp < b.timestamp;
+            });
+            ids.add(username, committed + written, chunk);
+            // индекс пишется после данных: оборванная запись оставит блок без ссылки, но не битую ссылку
+            index << offset << "," << packed.size() << "," << chunk.size() << "," << minIt->timestamp << "," << maxIt->timestamp << "\n";
+            index.flush();
+            offset += packed.size();
+            ++written;
+        }
+        return written;
+    }
+
+    static std::vector<Transaction> readBlock(const std::string &username, const Block &block) {
+        std::ifstream ifs(dataPath(username), std::ios::binary);
+        std::string packed(static_cast<std::size_t>(block.bytes), '\0');
+        ifs.seekg(static_cast<std::streamoff>(block.offset));
+        if (!ifs.read(packed.data(), static_cast<std::streamsize>(packed.size()))) {
+            throw BankingError("Archive block is truncated: " + dataPath(username).string());
+        }
+        std::vector<Transaction> out;
+        if (!schema::readColumns(decompress(packed), out) || out.size() != block.count) {
+            throw BankingError("Archive block is corrupted: " + dataPath(username).string());
+        }
+        return out;
+    }
+
+    // Операции с timestamp в [fromTs, toTs); разжимаются только пересекающиеся блоки
+    static std::vector<Transaction> range(const std::string &username, long long fromTs, long long toTs) {
+        std::vector<Transaction> out;
+        for (const auto &b : blocks(username)) {
+            if (b.maxTimestamp < fromTs || b.minTimestamp >= toTs) continue;
+            for (auto &t : readBlock(username, b)) {
+                if (t.timestamp >= fromTs && t.timestamp < toTs) out.push_back(std::move(t));
+            }
+        }
+        return out;
+    }
+
+    // Операция пользователя по id: по индексу id разжимается только ее блок
+    static bool find(const std::string &username, const std::string &transactionId, Transaction &out) {
+        std::string owner;
+        return find(transactionId, owner, out) && owner == username;
+    }
+
+    // Операция по id среди архивов всех пользователей; owner — чей архив
+    static bool find(const std::string &transactionId, std::string &owner, Transaction &out) {
+        Block block;
+        {
+            std::lock_guard<std::mutex> lock(mutex());
+            std::size_t number = 0;
+            if (!idIndex().locate(transactionId, owner, number)) return false;
+            auto all = readIndex(indexPath(owner));
+            if (number >= all.size()) return false;
+            block = all[number];
+        }
+        for (auto &t : readBlock(owner, block)) {
+            if (t.id == transactionId) {
+                out = std::move(t);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // fn(index, transaction) для архивных операций со сквозным номером >= fromIndex;
+    // блоки целиком раньше fromIndex не читаются
+    template <typename F>
+    static void forEach(const std::string &username, std::size_t fromIndex, F &&fn) {
+        std::size_t first = 0;
+        for (const auto &b : blocks(username)) {
+            std::size_t end = first + b.count;
+            if (end > fromIndex) {
+                auto items = readBlock(username, b);
+                for (std::size_t i = std::max(first, fromIndex); i < end; ++i) fn(i, items[i - first]);
+            }
+            first = end;
+        }
+    }
+
+    static void remove(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::error_code ec;
+        std::filesystem::remove(dataPath(username), ec);
+        std::filesystem::remove(indexPath(username), ec);
+        idIndex().removeOwner(username);
+    }
+
+    static void clearAll() {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::error_code ec;
+        std::filesystem::remove_all(archiveRoot(), ec);
+        idIndex().reset();
+    }
+
+    // Переносит data/receipts/*.txt в архив чеков и удаляет исходные файлы; возвращает число чеков
+    static std::size_t packReceipts() {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(receiptsRoot(), ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".txt") files.push_back(entry.path());
+        }
+        if (files.empty()) return 0;
+        std::sort(files.begin(), files.end());
+        std::filesystem::create_directories(archiveRoot());
+        auto dataFile = archiveRoot() / "receipts.arc";
+        std::ofstream data(dataFile, std::ios::binary | std::ios::app);
+        std::ofstream index(archiveRoot() / "receipts.idx", std::ios::app);
+        if (!data || !index) throw BankingError("Cannot write archive: " + dataFile.string());
+        auto offset = std::filesystem::file_size(dataFile, ec);
+        if (ec) offset = 0;
+        for (std::size_t start = 0; start < files.size(); start += kReceiptsPerBlock) {
+            std::string raw;
+            std::ostringstream entries;
+            for (std::size_t i = start; i < std::min(files.size(), start + kReceiptsPerBlock); ++i) {
+                std::ifstream ifs(files[i], std::ios::binary);
+                std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+                entries << "R," << files[i].stem().string() << "," << offset << "," << raw.size() << "," << text.size() << "\n";
+                raw += text;
+            }
+            auto packed = compress(raw);
+            data.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+            data.flush();
+            if (!data) throw BankingError("Cannot write archive: " + dataFile.string());
+            index << "B," << offset << "," << packed.size() << "\n" << entries.str();
+            index.flush();
+            offset += packed.size();
+        }
+        for (const auto &file : files) std::filesystem::remove(file, ec);
+        return files.size();
+    }
+
+    // name — имя файла чека без .txt (receipt_<id>); последняя запись с этим именем
+    static bool readReceipt(const std::string &name, std::string &out) {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::ifstream ifs(archiveRoot() / "receipts.idx");
+        std::map<std::uint64_t, std::uint64_t> blockBytes;
+        std::uint64_t blockOffset = 0, position = 0, length = 0;
+        bool found = false;
+        std::string line;
+        while (std::getline(ifs, line)) {
+            std::stringstream ss(line);
+            std::string kind, a, b, c, d;
+            std::getline(ss, kind, ',');
+            try {
+                if (kind == "B") {
+                    std::getline(ss, a, ',');
+                    std::getline(ss, b);
+                    blockBytes[std::stoull(a)] = std::stoull(b);
+                } else if (kind == "R") {
+                    std::getline(ss, a, ',');
+                    std::getline(ss, b, ',');
+                    std::getline(ss, c, ',');
+                    std::getline(ss, d);
+                    if (a != name) continue;
+                    blockOffset = std::stoull(b);
+                    position = std::stoull(c);
+                    length = std::stoull(d);
+                    found = true;
+                }
+            } catch (...) {
+            }
+        }
+        if (!found || !blockBytes.count(blockOffset)) return false;
+        std::ifstream data(archiveRoot() / "receipts.arc", std::ios::binary);
+        std::string packed(static_cast<std::size_t>(blockBytes[blockOffset]), '\0');
+        data.seekg(static_cast<std::streamoff>(blockOffset));
+        if (!data.read(packed.data(), static_cast<std::streamsize>(packed.size()))) return false;
+        auto raw = decompress(packed);
+        if (position + length > raw.size()) return false;
+        out = raw.substr(static_cast<std::size_t>(position), static_cast<std::size_t>(length));
+        return true;
+    }
+
+private:
+    // id операции -> (пользователь, номер блока). Загружается из ids.idx при первом обращении;
+    // если файла нет, а архивы есть (созданы до индекса), строится одним проходом по блокам
+    class IdIndex {
+    public:
+        // number — номер блока; ссылка на блок дальше committed (недописанный) не считается
+        bool locate(const std::string &id, std::string &owner, std::size_t &number) {
+            ensureLoaded();
+            auto it = locations.find(id);
+            if (it == locations.end()) return false;
+            owner = owners[it->second.first];
+            number = it->second.second;
+            return true;
+        }
+
+        bool locate(const std::string &id, const std::string &owner, std::size_t committed) {
+            std::string found;
+            std::size_t number = 0;
+            return locate(id, found, number) && found == owner && number < committed;
+        }
+
+        void add(const std::string &owner, std::size_t number, const std::vector<Transaction> &items) {
+            ensureLoaded();
+            std::ofstream ofs(path(), std::ios::app);
+            for (const auto &t : items) ofs << t.id << "," << owner << "," << number << "\n";
+            ofs.flush();
+            if (!ofs) throw BankingError("Cannot write archive: " + path().string());
+            for (const auto &t : items) locations[t.id] = {ownerId(owner), static_cast<std::uint32_t>(number)};
+        }
+
+        void removeOwner(const std::string &owner) {
+            ensureLoaded();
+            auto it = ownerIds.find(owner);
+            if (it == ownerIds.end()) return;
+            std::uint32_t id = it->second;
+            for (auto l = locations.begin(); l != locations.end();) {
+                l = l->second.first == id ? locations.erase(l) : std::next(l);
+            }
+            rewrite();
+        }
+
+        void reset() {
+            locations.clear();
+            owners.clear();
+            ownerIds.clear();
+            loaded = true;
+        }
+
+    private:
+        bool loaded = false;
+        std::unordered_map<std::string, std::pair<std::uint32_t, std::uint32_t>> locations;
+        std::vector<std::string> owners;
+        std::unordered_map<std::string, std::uint32_t> ownerIds;
+
+        static std::filesystem::path path() { return archiveRoot() / "ids.idx"; }
+
+        std::uint32_t ownerId(const std::string &owner) {
+            auto it = ownerIds.find(owner);
+            if (it != ownerIds.end()) return it->second;
+            auto id = static_cast<std::uint32_t>(owners.size());
+            owners.push_back(owner);
+            ownerIds.emplace(owner, id);
+            return id;
+        }
+
+        void ensureLoaded() {
+            if (loaded) return;
+            loaded = true;
+            if (!std::filesystem::exists(path())) {
+                build();
+                return;
+            }
+            std::ifstream ifs(path());
+            std::string line;
+            while (std::getline(ifs, line)) {
+                auto first = line.find(',');
+                auto last = line.rfind(',');
+                if (first == std::string::npos || first == last) continue;
+                try {
+                    auto number = static_cast<std::uint32_t>(std::stoul(line.substr(last + 1)));
+                    locations[line.substr(0, first)] = {ownerId(line.substr(first + 1, last - first - 1)), number};
+                } catch (...) {
+                }
+            }
+        }
+
+        void build() {
+            std::error_code ec;
+            for (const auto &entry : std::filesystem::directory_iterator(archiveRoot(), ec)) {
+                if (entry.path().extension() != ".idx" || entry.path() == path() || entry.path().stem() == "receipts") continue;
+                auto owner = entry.path().stem().string();
+                auto all = readIndex(entry.path());
+                for (std::size_t number = 0; number < all.size(); ++number) {
+                    for (const auto &t : readBlock(owner, all[number])) locations[t.id] = {ownerId(owner), static_cast<std::uint32_t>(number)};
+                }
+            }
+            if (!locations.empty()) rewrite();
+        }
+
+        void rewrite() {
+            std::filesystem::create_directories(archiveRoot());
+            auto tmp = path();
+            tmp += ".tmp";
+            {
+                std::ofstream ofs(tmp, std::ios::trunc);
+                if (!ofs) throw BankingError("Cannot write archive: " + path().string());
+                for (const auto &[id, location] : locations) ofs << id << "," << owners[location.first] << "," << location.second << "\n";
+            }
+            std::filesystem::rename(tmp, path());
+        }
+    };
+
+    static std::mutex &mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    static IdIndex &idIndex() {
+        static IdIndex index;
+        return index;
+    }
+
+    static std::filesystem::path dataPath(const std::string &username) { return archiveRoot() / (username + ".arc"); }
+    static std::filesystem::path indexPath(const std::string &username) { return archiveRoot() / (username + ".idx"); }
+
+    static std::vector<Block> readIndex(const std::filesystem::path &path) {
+        std::vector<Block> out;
+        std::ifstream ifs(path);
+        std::string line;
+        while (std::getline(ifs, line)) {
+            std::stringstream ss(line);
+            std::string offset, bytes, count, minTs, maxTs;
+            std::getline(ss, offset, ',');
+            std::getline(ss, bytes, ',');
+            std::getline(ss, count, ',');
+            std::getline(ss, minTs, ',');
+            std::getline(ss, maxTs);
+            try {
+                out.push_back({std::stoull(offset), std::stoull(bytes), static_cast<std::size_t>(std::stoull(count)), std::stoll(minTs), std::stoll(maxTs)});
+            } catch (...) {
+                // недописанная строка индекса — конец архива
+                break;
+            }
+        }
+        return out;
+    }
+
+    static std::string compress(const std::string &raw) {
+        QByteArray packed = qCompress(QByteArray(raw.data(), static_cast<qsizetype>(raw.size())), 9);
+        return std::string(packed.constData(), static_cast<std::size_t>(packed.size()));
+    }
+
+    static std::string decompress(const std::string &packed) {
+        QByteArray raw = qUncompress(reinterpret_cast<const uchar *>(packed.data()), static_cast<qsizetype>(packed.size()));
+        return std::string(raw.constData(), static_cast<std::size_t>(raw.size()));
+    }
+};
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "../models/Transaction.h"
+
+namespace storage {
+
+struct HistoryFilter {
+    long long fromTs = 0;       // включительно, 0 — без границы
+    long long toTs = 0;         // не включая, 0 — без границы
+    long long minCents = 0;
+    long long maxCents = 0;     // 0 — без границы
+    std::string category;
+    std::string status;
+    std::string counterparty;   // карта/счет получателя или счет отправителя зачисления
+    bool newestFirst = true;
+    std::string cursor;         // nextCursor прошлой страницы, пусто — с начала
+    std::size_t limit = 50;
+};
+
+// Индекс истории одного пользователя: операции в порядке времени (timestamps — для бинарного
+// поиска) и списки позиций по категориям. Диапазон дат сужается двумя lower_bound, фильтр по
+// категории идет только по ее списку, так что запрос "этот месяц, продукты" стоит столько,
+// сколько возвращает. Курсор — время и id последней выданной операции, он переживает
+// перестройку индекса после новых операций.
+class HistoryIndex {
+public:
+    struct Page {
+        std::vector<const Transaction *> items;  // действительны до следующей build
+        std::string nextCursor;                  // пусто — дальше ничего нет
+    };
+
+    void build(std::vector<Transaction> history) {
+        items = std::move(history);
+        std::stable_sort(items.begin(), items.end(), [](const Transaction &a, const Transaction &b){ return a.timestamp < b.timestamp; });
+        timestamps.clear();
+        timestamps.reserve(items.size());
+        categories.clear();
+        for (std::uint32_t i = 0; i < items.size(); ++i) {
+            timestamps.push_back(items[i].timestamp);
+            categories[items[i].category].push_back(i);
+        }
+    }
+
+    std::size_t size() const { return items.size(); }
+
+    Page query(const HistoryFilter &f) const {
+        Page page;
+        std::size_t lo = 0, hi = items.size();
+        if (f.fromTs) lo = lowerBound(f.fromTs);
+        if (f.toTs) hi = lowerBound(f.toTs);
+        if (!f.cursor.empty()) {
+            long long ts = 0;
+            std::string id;
+            if (!parseCursor(f.cursor, ts, id)) return page;
+            std::size_t first = lowerBound(ts), last = lowerBound(ts + 1), pos = first;
+            while (pos < last && items[pos].id != id) ++pos;
+            if (f.newestFirst) hi = std::min(hi, pos < last ? pos : first);
+            else lo = std::max(lo, pos < last ? pos + 1 : last);
+        }
+        if (lo >= hi) return page;
+
+        std::size_t limit = f.limit ? f.limit : 50;
+        // true — страница полна и найдена еще одна подходящая операция
+        auto take = [&](std::size_t i) {
+            if (!matches(items[i], f)) return false;
+            if (page.items.size() == limit) {
+                page.nextCursor = cursorOf(*page.items.back());
+                return true;
+            }
+            page.items.push_back(&items[i]);
+            return false;
+        };
+
+        if (!f.category.empty()) {
+            auto it = categories.find(f.category);
+            if (it == categories.end()) return page;
+            const auto &postings = it->second;
+            auto first = std::lower_bound(postings.begin(), postings.end(), lo);
+            auto last = std::lower_bound(first, postings.end(), hi);
+            if (f.newestFirst) {
+                for (auto p = last; p != first && !take(*--p);) {}
+            } else {
+                for (auto p = first; p != last && !take(*p); ++p) {}
+            }
+        } else if (f.newestFirst) {
+            for (std::size_t i = hi; i > lo && !take(i - 1); --i) {}
+        } else {
+            for (std::size_t i = lo; i < hi && !take(i); ++i) {}
+        }
+        return page;
+    }
+
+private:
+    std::vector<Transaction> items;
+    std::vector<long long> timestamps;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> categories;
+
+    std::size_t lowerBound(long long ts) const {
+        return static_cast<std::size_t>(std::lower_bound(timestamps.begin(), timestamps.end(), ts) - timestamps.begin());
+    }
+
+    static bool matches(const Transaction &t, const HistoryFilter &f) {
+        if (t.cents < f.minCents) return false;
+        if (f.maxCents && t.cents > f.maxCents) return false;
+        if (!f.status.empty() && t.status != f.status) return false;
+        if (!f.counterparty.empty() && t.toCard != f.counterparty && t.fromAccount != f.counterparty) return false;
+        return true;
+    }
+
+    static std::string cursorOf(const Transaction &t) {
+        return std::to_string(t.timestamp) + ":" + t.id;
+    }
+
+    static bool parseCursor(const std::string &cursor, long long &ts, std::string &id) {
+        auto colon = cursor.find(':');
+        if (colon == std::string::npos) return false;
+        try {
+            ts = std::stoll(cursor.substr(0, colon));
+        } catch (...) {
+            return false;
+        }
+        id = cursor.substr(colon + 1);
+        return true;
+    }
+};
+
+}
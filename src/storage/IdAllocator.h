@@ -0,0 +1,269 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <mutex>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+#include "UserStorage.h"
+#include "../utils/BloomFilter.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+enum class IdKind { Account = 0, Card = 1, Transaction = 2, Schedule = 3 };
+
+static inline std::filesystem::path idsRoot() {
+    return std::filesystem::path("data/ids");
+}
+
+// Выдача идентификаторов блоками из сохраненного счетчика.
+// Блок резервируется одной записью файла, дальше номера выдаются из памяти.
+// Номера счетчика уникальны сами по себе; в фильтр Блума попадают только старые id, которые
+// счетчик еще может выдать (того же формата и не меньше его значения) — их он пропускает.
+// Импорт вместо фильтра переносит счетчик за свои id (advancePast).
+class IdAllocator {
+public:
+    static constexpr unsigned long long kBlockSize = 64;
+
+    static IdAllocator &instance() {
+        static IdAllocator allocator;
+        return allocator;
+    }
+
+    // Счет: 40817 + цифровой код валюты + 12 цифр порядкового номера (20 знаков)
+    std::string nextAccountNumber(const std::string &currency) {
+        return next(IdKind::Account, [&](unsigned long long seq) {
+            return "40817" + currencyCode(currency) + pad(seq, 12);
+        });
+    }
+
+    // Карта: BIN 2200 + 11 цифр номера + контрольная цифра Луна (16 знаков)
+    std::string nextCardNumber() {
+        return next(IdKind::Card, [&](unsigned long long seq) {
+            std::string body = "2200" + pad(seq, 11);
+            return body + luhnDigit(body);
+        });
+    }
+
+    // Транзакция: 12 цифр порядкового номера
+    std::string nextTransactionId() {
+        return next(IdKind::Transaction, [&](unsigned long long seq) { return pad(seq, 12); });
+    }
+
+    // Плановый платеж: S + 9 цифр
+    std::string nextScheduleId() {
+        return next(IdKind::Schedule, [&](unsigned long long seq) { return "S" + pad(seq, 9); });
+    }
+
+    // Сообщить о id, созданном в обход аллокатора (например, при импорте)
+    void remember(IdKind kind, const std::string &id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureFilters();
+        add(kind, id);
+    }
+
+    // Импорт: счетчик переносится за наибольший из id его формата, так что ни один
+    // из них не будет выдан повторно и фильтру запоминать их не нужно
+    void advancePast(IdKind kind, const std::vector<std::string> &ids) {
+        std::optional<unsigned long long> top;
+        for (const auto &id : ids) {
+            auto seq = sequenceOf(kind, id);
+            if (seq && (!top || *seq > *top)) top = seq;
+        }
+        if (!top) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &block = blocks[index(kind)];
+        if (*top < floor(kind)) return;
+        if (*top < block.end) {
+            block.next = *top + 1;
+            return;
+        }
+        writeCounter(kind, *top + 1);
+        block = Block{};
+    }
+
+    static std::string luhnDigit(const std::string &body) {
+        int sum = 0;
+        bool doubleIt = true;
+        for (auto it = body.rbegin(); it != body.rend(); ++it) {
+            int d = *it - '0';
+            if (doubleIt) {
+                d *= 2;
+                if (d > 9) d -= 9;
+            }
+            sum += d;
+            doubleIt = !doubleIt;
+        }
+        return std::string(1, static_cast<char>('0' + (10 - sum % 10) % 10));
+    }
+
+    static bool luhnValid(const std::string &number) {
+        if (number.size() < 2) return false;
+        return luhnDigit(number.substr(0, number.size() - 1)) == number.substr(number.size() - 1);
+    }
+
+private:
+    struct Block {
+        unsigned long long next = 0;
+        unsigned long long end = 0;
+    };
+
+    std::mutex mutex;
+    std::array<Block, 4> blocks{};
+    std::array<std::optional<utils::BloomFilter>, 4> filters{};
+    std::array<std::vector<std::string>, 4> legacy{};   // содержимое фильтров, для перестройки
+    std::array<std::size_t, 4> capacity{};              // расчетный размер фильтров
+
+    IdAllocator() = default;
+
+    static std::size_t index(IdKind kind) { return static_cast<std::size_t>(kind); }
+
+    static const char *kindName(IdKind kind) {
+        switch (kind) {
+        case IdKind::Account: return "accounts";
+        case IdKind::Card: return "cards";
+        case IdKind::Transaction: return "transactions";
+        case IdKind::Schedule: return "schedules";
+        }
+        return "ids";
+    }
+
+    static std::string pad(unsigned long long value, std::size_t width) {
+        std::string digits = std::to_string(value);
+        if (digits.size() > width) throw BankingError("Исчерпан диапазон идентификаторов");
+        return std::string(width - digits.size(), '0') + digits;
+    }
+
+    static std::string currencyCode(const std::string &currency) {
+        if (currency == "USD") return "840";
+        if (currency == "EUR") return "978";
+        if (currency == "CNY") return "156";
+        return "810";
+    }
+
+    template <typename TFormat>
+    std::string next(IdKind kind, TFormat format) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureFilters();
+        auto &block = blocks[index(kind)];
+        const auto &filter = *filters[index(kind)];
+        for (;;) {
+            if (block.next >= block.end) reserveBlock(kind, block);
+            std::string id = format(block.next++);
+            if (!filter.mayContain(id)) return id;
+        }
+    }
+
+    // Порядковый номер, если id мог быть выдан счетчиком этого вида
+    static std::optional<unsigned long long> sequenceOf(IdKind kind, const std::string &id) {
+        auto digits = [&](std::size_t from, std::size_t count) -> std::optional<unsigned long long> {
+            if (from + count > id.size()) return std::nullopt;
+            for (std::size_t i = from; i < from + count; ++i) {
+                if (id[i] < '0' || id[i] > '9') return std::nullopt;
+            }
+            return std::stoull(id.substr(from, count));
+        };
+        switch (kind) {
+        case IdKind::Account:
+            if (id.size() != 20 || id.compare(0, 5, "40817") != 0 || !digits(5, 3)) return std::nullopt;
+            return digits(8, 12);
+        case IdKind::Card:
+            if (id.size() != 16 || id.compare(0, 4, "2200") != 0 || !digits(15, 1)) return std::nullopt;
+            return digits(4, 11);
+        case IdKind::Transaction:
+            if (id.size() != 12) return std::nullopt;
+            return digits(0, 12);
+        case IdKind::Schedule:
+            if (id.size() != 10 || id[0] != 'S') return std::nullopt;
+            return digits(1, 9);
+        }
+        return std::nullopt;
+    }
+
+    static std::filesystem::path counterPath(IdKind kind) {
+        return idsRoot() / (std::string(kindName(kind)) + ".seq");
+    }
+
+    static unsigned long long readCounter(IdKind kind) {
+        std::ifstream ifs(counterPath(kind));
+        std::string line;
+        if (ifs && std::getline(ifs, line) && !line.empty()) return std::stoull(line);
+        return 1;
+    }
+
+    // Первый номер, который счетчик еще может выдать
+    unsigned long long floor(IdKind kind) const {
+        const auto &block = blocks[index(kind)];
+        return block.end > 0 ? block.next : readCounter(kind);
+    }
+
+    void add(IdKind kind, const std::string &id) {
+        auto seq = sequenceOf(kind, id);
+        if (!seq || *seq < floor(kind)) return;
+        auto i = index(kind);
+        legacy[i].push_back(id);
+        filters[i]->add(id);
+        if (legacy[i].size() > capacity[i]) rebuild(kind);
+    }
+
+    // Фильтр переполнен: выданное счетчиком уже не нужно, остальное — в фильтр вдвое больше
+    void rebuild(IdKind kind) {
+        auto i = index(kind);
+        auto from = floor(kind);
+        auto &ids = legacy[i];
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [&](const std::string &id){ return *sequenceOf(kind, id) < from; }), ids.end());
+        capacity[i] = std::max<std::size_t>(kBlockSize, 2 * ids.size());
+        filters[i].emplace(capacity[i]);
+        for (const auto &id : ids) filters[i]->add(id);
+    }
+
+    static void writeCounter(IdKind kind, unsigned long long value) {
+        std::filesystem::create_directories(idsRoot());
+        auto path = counterPath(kind);
+        auto tmp = path;
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) throw BankingError("Cannot write id counter: " + path.string());
+            ofs << value << "\n";
+        }
+        std::filesystem::rename(tmp, path);
+    }
+
+    static void reserveBlock(IdKind kind, Block &block) {
+        unsigned long long start = readCounter(kind);
+        unsigned long long end = start + kBlockSize;
+        writeCounter(kind, end);
+        block.next = start;
+        block.end = end;
+    }
+
+    // Один проход по хранилищу при первой выдаче: в фильтры — id, с которыми счетчик еще может совпасть
+    void ensureFilters() {
+        if (filters[0]) return;
+        std::array<unsigned long long, 4> from{};
+        for (auto kind : {IdKind::Account, IdKind::Card, IdKind::Transaction, IdKind::Schedule}) from[index(kind)] = floor(kind);
+        auto keep = [&](IdKind kind, std::string_view id) {
+            std::string value(id);
+            auto seq = sequenceOf(kind, value);
+            if (seq && *seq >= from[index(kind)]) legacy[index(kind)].push_back(std::move(value));
+        };
+        UserStorage::forEachUser([&](const UserView &u) {
+            for (const auto &a : u.accounts) keep(IdKind::Account, a.accountNumber);
+            for (const auto &c : u.cards) keep(IdKind::Card, c.cardNumber);
+            for (const auto &t : u.history) keep(IdKind::Transaction, t.id);
+        }, SectionAccounts | SectionCards | SectionHistory);
+        for (std::size_t i = 0; i < filters.size(); ++i) {
+            capacity[i] = std::max<std::size_t>(kBlockSize, 2 * legacy[i].size());
+            filters[i].emplace(capacity[i]);
+            for (const auto &id : legacy[i]) filters[i]->add(id);
+        }
+    }
+};
+
+}
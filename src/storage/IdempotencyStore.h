@@ -0,0 +1,200 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <ctime>
+#include <cctype>
+#include <cstdint>
+#include <initializer_list>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+static inline std::filesystem::path idempotencyPath() {
+    return std::filesystem::path("data/idempotency.log");
+}
+
+// Результат операции, выполненной под ключом клиента
+struct IdempotencyRecord {
+    std::string kind;           // transfer / deposit
+    std::string fingerprint;    // параметры запроса: тот же ключ с другими параметрами — ошибка
+    std::string transactionId;
+    std::string message;        // то, что клиент увидел в первый раз
+    std::time_t expiresAt = 0;
+};
+
+// Обработанные ключи идемпотентности: хеш-таблица (владелец, ключ) -> результат и очередь
+// ключей в порядке истечения (срок у всех одинаковый, поэтому очередь уже отсортирована).
+// На диске — журнал, в который результат дописывается строкой; истекшие записи отбрасываются
+// при загрузке, а когда мертвых строк становится больше живых, журнал переписывается.
+class IdempotencyStore {
+public:
+    static constexpr std::time_t kTtlSeconds = 24 * 3600;
+    static constexpr std::size_t kMaxKeyLength = 64;
+
+    static IdempotencyStore &instance() {
+        static IdempotencyStore store;
+        return store;
+    }
+
+    // Ключ попадает в журнал как есть, поэтому алфавит ограничен
+    static void validateKey(const std::string &key) {
+        bool ok = !key.empty() && key.size() <= kMaxKeyLength &&
+                  std::all_of(key.begin(), key.end(), [](unsigned char c){
+                      return std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == ':';
+                  });
+        if (!ok) throw ValidationError("Некорректный ключ идемпотентности");
+    }
+
+    // FNV-1a от параметров запроса: стабилен между запусками, в отличие от std::hash
+    static std::string fingerprint(std::initializer_list<std::string> parts) {
+        std::uint64_t h = 1469598103934665603ULL;
+        for (const auto &part : parts) {
+            for (unsigned char c : part) h = (h ^ c) * 1099511628211ULL;
+            h = (h ^ 0x1f) * 1099511628211ULL;
+        }
+        std::ostringstream os;
+        os << std::hex << h;
+        return os.str();
+    }
+
+    // true — ключ уже обработан, out — исходный результат
+    bool find(const std::string &owner, const std::string &key, IdempotencyRecord &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        expire(std::time(nullptr));
+        auto it = records.find(slotKey(owner, key));
+        if (it == records.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    void remember(const std::string &owner, const std::string &key, IdempotencyRecord record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::time_t now = std::time(nullptr);
+        expire(now);
+        record.expiresAt = now + kTtlSeconds;
+        std::replace(record.message.begin(), record.message.end(), '\n', ' ');
+        {
+            std::filesystem::create_directories(idempotencyPath().parent_path());
+            std::ofstream ofs(idempotencyPath(), std::ios::app);
+            if (!ofs) throw BankingError("Cannot write idempotency log: " + idempotencyPath().string());
+            writeLine(ofs, owner, key, record);
+        }
+        ++lines;
+        auto slot = slotKey(owner, key);
+        order.push_back({record.expiresAt, slot});
+        records[slot] = std::move(record);
+        if (lines > 2 * records.size() + 64) compact();
+    }
+
+    // Удаление пользователя: его ключи не должны вернуть результат новому владельцу имени
+    void forgetOwner(const std::string &owner) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        auto prefix = slotKey(owner, std::string());
+        std::size_t before = records.size();
+        for (auto it = records.begin(); it != records.end();) {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? records.erase(it) : std::next(it);
+        }
+        if (records.size() != before) compact();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        records.clear();
+        order.clear();
+        lines = 0;
+        loaded = true;
+        std::error_code ec;
+        std::filesystem::remove(idempotencyPath(), ec);
+    }
+
+private:
+    std::mutex mutex;
+    bool loaded = false;
+    std::unordered_map<std::string, IdempotencyRecord> records;
+    std::deque<std::pair<std::time_t, std::string>> order;
+    std::size_t lines = 0;
+
+    IdempotencyStore() = default;
+
+    // Имена пользователей и ключи не содержат '/'
+    static std::string slotKey(const std::string &owner, const std::string &key) { return owner + "/" + key; }
+
+    static void writeLine(std::ostream &os, const std::string &owner, const std::string &key, const IdempotencyRecord &r) {
+        os << r.expiresAt << "," << owner << "," << key << "," << r.kind << "," << r.transactionId << ","
+           << r.fingerprint << "," << r.message << "\n";
+    }
+
+    void expire(std::time_t now) {
+        while (!order.empty() && order.front().first <= now) {
+            auto it = records.find(order.front().second);
+            // ключ мог быть перезаписан позже — удаляем только свою версию
+            if (it != records.end() && it->second.expiresAt == order.front().first) records.erase(it);
+            order.pop_front();
+        }
+    }
+
+    void ensureLoaded() {
+        if (loaded) return;
+        loaded = true;
+        std::ifstream ifs(idempotencyPath());
+        std::string line;
+        std::time_t now = std::time(nullptr);
+        while (std::getline(ifs, line)) {
+            ++lines;
+            std::stringstream ss(line);
+            std::string expires, owner, key;
+            IdempotencyRecord r;
+            if (!std::getline(ss, expires, ',') || !std::getline(ss, owner, ',') || !std::getline(ss, key, ',') ||
+                !std::getline(ss, r.kind, ',') || !std::getline(ss, r.transactionId, ',') || !std::getline(ss, r.fingerprint, ',')) {
+                continue;
+            }
+            std::getline(ss, r.message);
+            try {
+                r.expiresAt = static_cast<std::time_t>(std::stoll(expires));
+            } catch (...) {
+                continue;
+            }
+            if (r.expiresAt <= now) continue;
+            auto slot = slotKey(owner, key);
+            order.push_back({r.expiresAt, slot});
+            records[slot] = std::move(r);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto &a, const auto &b){ return a.first < b.first; });
+        if (lines > 2 * records.size() + 64) compact();
+    }
+
+    // Переписывает журнал только живыми записями через временный файл; очередь истечения
+    // при этом избавляется от повторов перезаписанных ключей
+    void compact() {
+        std::deque<std::pair<std::time_t, std::string>> live;
+        for (const auto &[slot, r] : records) live.push_back({r.expiresAt, slot});
+        std::sort(live.begin(), live.end());
+        auto tmp = idempotencyPath();
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) return;
+            for (const auto &[expiresAt, slot] : live) {
+                auto sep = slot.find('/');
+                writeLine(ofs, slot.substr(0, sep), slot.substr(sep + 1), records[slot]);
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, idempotencyPath(), ec);
+        if (ec) return;
+        order = std::move(live);
+        lines = records.size();
+    }
+};
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace storage {
+
+// Файл, целиком отображенный в память на чтение и запись. resize переотображает файл,
+// так что указатели в прежнее отображение после него недействительны
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    // Открывает файл, создавая его при необходимости; непустой файл сразу отображается
+    bool open(const std::filesystem::path &path) {
+        close();
+#ifdef _WIN32
+        handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER bytes;
+        if (!GetFileSizeEx(handle, &bytes)) {
+            close();
+            return false;
+        }
+        length = static_cast<std::uint64_t>(bytes.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            close();
+            return false;
+        }
+        length = static_cast<std::uint64_t>(st.st_size);
+#endif
+        if (length > 0 && !map()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // При неудаче остается прежний размер и прежнее (заново созданное) отображение
+    bool resize(std::uint64_t bytes) {
+        if (!isOpen()) return false;
+        unmap();
+#ifdef _WIN32
+        LARGE_INTEGER target;
+        target.QuadPart = static_cast<LONGLONG>(bytes);
+        bool ok = SetFilePointerEx(handle, target, nullptr, FILE_BEGIN) && SetEndOfFile(handle);
+#else
+        bool ok = ::ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+#endif
+        if (ok) length = bytes;
+        if (length > 0 && !map()) return false;
+        return ok;
+    }
+
+    void close() {
+        unmap();
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        length = 0;
+    }
+
+#ifdef _WIN32
+    bool isOpen() const { return handle != INVALID_HANDLE_VALUE; }
+#else
+    bool isOpen() const { return fd >= 0; }
+#endif
+    std::uint64_t size() const { return length; }
+    unsigned char *data() const { return base; }
+
+private:
+    unsigned char *base = nullptr;
+    std::uint64_t length = 0;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    bool map() {
+#ifdef _WIN32
+        mapping = CreateFileMappingW(handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (!mapping) return false;
+        base = static_cast<unsigned char *>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        if (!base) unmap();
+#else
+        void *view = ::mmap(nullptr, static_cast<std::size_t>(length), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        base = view == MAP_FAILED ? nullptr : static_cast<unsigned char *>(view);
+#endif
+        return base != nullptr;
+    }
+
+    void unmap() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (base) ::munmap(base, static_cast<std::size_t>(length));
+#endif
+        base = nullptr;
+    }
+};
+
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "../utils/Exceptions.h"
+#include "../utils/Utils.h"
+
+namespace storage {
+
+static inline std::filesystem::path notificationsRoot() {
+    return std::filesystem::path("data/notifications");
+}
+
+struct NotificationEntry {
+    long long id = 0;
+    std::time_t timestamp = 0;
+    std::string message;
+};
+
+// Уведомления пользователя отдельно от его файла: <user>.log дописывается строкой,
+// <user>.meta хранит nextId, курсор прочитанного и число строк в логе.
+// Когда строк становится вдвое больше лимита, лог ужимается до последних cap записей,
+// так что добавление — амортизированное O(1) и не трогает users/<user>.txt.
+class NotificationStore {
+public:
+    static constexpr std::size_t kDefaultCapacity = 200;
+
+    static NotificationStore &instance() {
+        static NotificationStore store;
+        return store;
+    }
+
+    std::size_t capacity() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cap();
+    }
+
+    void setCapacity(std::size_t value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacityValue = std::max<std::size_t>(value, 1);
+        std::filesystem::create_directories(notificationsRoot());
+        std::ofstream ofs(notificationsRoot() / "config.txt", std::ios::trunc);
+        ofs << "cap=" << capacityValue << "\n";
+    }
+
+    long long append(const std::string &username, const std::string &message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::filesystem::create_directories(notificationsRoot());
+        Meta meta = readMeta(username);
+        NotificationEntry entry;
+        entry.id = meta.nextId++;
+        entry.timestamp = std::time(nullptr);
+        entry.message = message;
+        std::replace(entry.message.begin(), entry.message.end(), '\n', ' ');
+        {
+            std::ofstream ofs(logPath(username), std::ios::app);
+            if (!ofs) throw BankingError("Cannot write notifications: " + logPath(username).string());
+            ofs << entry.id << "," << entry.timestamp << "," << entry.message << "\n";
+        }
+        ++meta.lines;
+        if (meta.lines >= 2 * cap()) compact(username, meta);
+        writeMeta(username, meta);
+        return entry.id;
+    }
+
+    // Страница от новых к старым: записи с id < beforeId (0 — с самой новой), не больше limit
+    std::vector<NotificationEntry> page(const std::string &username, long long beforeId, std::size_t limit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto all = readLog(username);
+        std::vector<NotificationEntry> out;
+        for (auto it = all.rbegin(); it != all.rend() && out.size() < limit; ++it) {
+            if (beforeId > 0 && it->id >= beforeId) continue;
+            out.push_back(*it);
+        }
+        return out;
+    }
+
+    // Записи с id > afterId в порядке поступления
+    std::vector<NotificationEntry> since(const std::string &username, long long afterId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<NotificationEntry> out;
+        for (auto &e : readLog(username)) {
+            if (e.id > afterId) out.push_back(std::move(e));
+        }
+        return out;
+    }
+
+    long long readCursor(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return readMeta(username).readId;
+    }
+
+    std::size_t unreadCount(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Meta meta = readMeta(username);
+        long long unread = meta.nextId - 1 - meta.readId;
+        return static_cast<std::size_t>(std::clamp<long long>(unread, 0, static_cast<long long>(std::min(meta.lines, cap()))));
+    }
+
+    std::size_t count(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::min(readMeta(username).lines, cap());
+    }
+
+    // upToId == 0 — отметить прочитанными все
+    void markRead(const std::string &username, long long upToId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Meta meta = readMeta(username);
+        long long target = upToId > 0 ? std::min(upToId, meta.nextId - 1) : meta.nextId - 1;
+        if (target <= meta.readId) return;
+        meta.readId = target;
+        std::filesystem::create_directories(notificationsRoot());
+        writeMeta(username, meta);
+    }
+
+    // Очистка не сбрасывает nextId: идентификаторы остаются монотонными
+    void clear(const std::string &username) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Meta meta = readMeta(username);
+        meta.readId = meta.nextId - 1;
+        meta.lines = 0;
+        std::error_code ec;
+        std::filesystem::remove(logPath(username), ec);
+        std::filesystem::create_directories(notificationsRoot());
+        writeMeta(username, meta);
+    }
+
+    void clearAll() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::error_code ec;
+        for (auto &entry : std::filesystem::directory_iterator(notificationsRoot(), ec)) {
+            if (entry.path().filename() != "config.txt") std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+private:
+    struct Meta {
+        long long nextId = 1;
+        long long readId = 0;
+        std::size_t lines = 0;
+    };
+
+    std::mutex mutex;
+    std::size_t capacityValue = 0;
+
+    NotificationStore() = default;
+
+    static std::filesystem::path logPath(const std::string &username) { return notificationsRoot() / (username + ".log"); }
+    static std::filesystem::path metaPath(const std::string &username) { return notificationsRoot() / (username + ".meta"); }
+
+    std::size_t cap() {
+        if (capacityValue == 0) {
+            capacityValue = kDefaultCapacity;
+            std::ifstream ifs(notificationsRoot() / "config.txt");
+            std::string line;
+            while (std::getline(ifs, line)) {
+                line = utils::trim(line);
+                if (line.rfind("cap=", 0) == 0) {
+                    try {
+                        capacityValue = std::max<std::size_t>(std::stoul(line.substr(4)), 1);
+                    } catch (...) {
+                    }
+                }
+            }
+        }
+        return capacityValue;
+    }
+
+    static Meta readMeta(const std::string &username) {
+        Meta meta;
+        std::ifstream ifs(metaPath(username));
+        if (ifs) ifs >> meta.nextId >> meta.readId >> meta.lines;
+        if (meta.nextId < 1) meta.nextId = 1;
+        return meta;
+    }
+
+    static void writeMeta(const std::string &username, const Meta &meta) {
+        std::ofstream ofs(metaPath(username), std::ios::trunc);
+        if (!ofs) throw BankingError("Cannot write notifications: " + metaPath(username).string());
+        ofs << meta.nextId << " " << meta.readId << " " << meta.lines << "\n";
+    }
+
+    std::vector<NotificationEntry> readLog(const std::string &username) {
+        std::deque<NotificationEntry> ring;
+        std::ifstream ifs(logPath(username));
+        std::string line;
+        std::size_t limit = cap();
+        while (std::getline(ifs, line)) {
+            std::stringstream ss(line);
+            std::string idField, tsField;
+            if (!std::getline(ss, idField, ',') || !std::getline(ss, tsField, ',')) continue;
+            NotificationEntry e;
+            try {
+                e.id = std::stoll(idField);
+                e.timestamp = static_cast<std::time_t>(std::stoll(tsField));
+            } catch (...) {
+                continue;
+            }
+            std::getline(ss, e.message);
+            ring.push_back(std::move(e));
+            if (ring.size() > limit) ring.pop_front();
+        }
+        return std::vector<NotificationEntry>(ring.begin(), ring.end());
+    }
+
+    void compact(const std::string &username, Meta &meta) {
+        auto kept = readLog(username);
+        auto tmp = logPath(username);
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) throw BankingError("Cannot write notifications: " + tmp.string());
+            for (const auto &e : kept) ofs << e.id << "," << e.timestamp << "," << e.message << "\n";
+        }
+        std::filesystem::rename(tmp, logPath(username));
+        meta.lines = kept.size();
+    }
+};
+
+}
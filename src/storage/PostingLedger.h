@@ -0,0 +1,444 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ctime>
+#include <algorithm>
+#include <initializer_list>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include "UserStorage.h"
+#include "UserScan.h"
+#include "BalanceTable.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+// Нога проводки в валюте счета: дебет — минус, кредит — плюс.
+// Служебные счета: "ext:<номер>" — внешний контрагент, "fx:<валюта>" — конвертация,
+// "equity:<валюта>" — входящие остатки, перенесенные из файлов пользователей.
+struct PostingLeg {
+    std::string account;
+    std::string currency;
+    long long cents = 0;
+};
+
+struct LedgerEntry {
+    long long seq = 0;
+    std::string transactionId;
+    std::string kind;  // "open", "deposit", "transfer", "cancel"
+    std::time_t timestamp = 0;
+    std::string category;
+    std::string note;
+    std::vector<PostingLeg> legs;
+};
+
+struct LedgerAccount {
+    std::string number;
+    std::string owner;
+    std::string currency;
+};
+
+// Двойная запись: каждая операция — одна неизменяемая строка в postings.log, сумма ног
+// по каждой валюте равна нулю. Балансы — накопленные суммы по счетам: клиентские в BalanceTable,
+// служебные (с ':' в имени) в памяти. Если таблица отстала от лога (сбой между записями),
+// она перестраивается проходом по логу при загрузке.
+// В том же логе справочник: счет -> владелец и валюта, карта -> счет, удаление владельца.
+// Если лога еще нет, справочник и входящие остатки переносятся из файлов пользователей.
+class PostingLedger {
+public:
+    static PostingLedger &instance() {
+        static PostingLedger ledger;
+        return ledger;
+    }
+
+    long long balance(const std::string &account) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        if (!isService(account)) return BalanceTable::instance().balance(account);
+        auto it = serviceBalances.find(account);
+        return it != serviceBalances.end() ? it->second : 0;
+    }
+
+    bool account(const std::string &number, LedgerAccount &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        auto it = accounts.find(number);
+        if (it == accounts.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    // Номер счета по карте или номеру счета; пусто — получатель вне банка
+    std::string resolve(const std::string &destination) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        if (accounts.count(destination)) return destination;
+        auto card = cards.find(destination);
+        return card != cards.end() && accounts.count(card->second) ? card->second : std::string();
+    }
+
+    void openAccount(const std::string &owner, const std::string &number, const std::string &currency, long long openingCents = 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        if (accounts.count(number)) return;
+        std::ofstream ofs = openLog();
+        writeOpen(ofs, owner, number, currency, openingCents);
+        ofs.flush();
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+    }
+
+    void linkCard(const std::string &card, const std::string &account) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        auto it = cards.find(card);
+        if (it != cards.end() && it->second == account) return;
+        std::ofstream ofs = openLog();
+        ofs << "C," << card << "," << account << "\n";
+        ofs.flush();
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+        cards[card] = account;
+    }
+
+    // Счета и карты пользователя, которых еще нет в справочнике (импорт, старые файлы)
+    void adopt(const RegularUser &user) {
+        adoptAll(std::vector<const RegularUser *>{&user});
+    }
+
+    void adoptAll(const std::vector<const RegularUser *> &users) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::ofstream ofs;
+        for (const auto *user : users) {
+            for (const auto &a : user->accounts) {
+                if (accounts.count(a.accountNumber)) continue;
+                if (!ofs.is_open()) ofs = openLog();
+                writeOpen(ofs, user->usernameValue, a.accountNumber, a.currency, a.balanceCents);
+            }
+            for (const auto &c : user->cards) {
+                if (cards.count(c.cardNumber)) continue;
+                if (!ofs.is_open()) ofs = openLog();
+                ofs << "C," << c.cardNumber << "," << c.linkedAccount << "\n";
+                cards[c.cardNumber] = c.linkedAccount;
+            }
+        }
+        if (ofs.is_open()) {
+            ofs.flush();
+            if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+        }
+    }
+
+    // Проводки удаленного пользователя остаются в логе, из справочника уходят его счета и карты,
+    // а записи таблицы балансов теряют владельца
+    void closeOwner(const std::string &owner) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::ofstream ofs = openLog();
+        ofs << "X," << owner << "\n";
+        ofs.flush();
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+        forget(owner);
+        BalanceTable::instance().releaseOwner(owner);
+    }
+
+    // Одна операция — одна дописанная строка; несбалансированная проводка не пишется
+    LedgerEntry post(const std::string &transactionId, const std::string &kind, std::vector<PostingLeg> legs,
+                     const std::string &note = std::string(), const std::string &category = std::string()) {
+        return write(transactionId, kind, std::move(legs), note, category, false);
+    }
+
+    // Для проводок, которые по операции бывают не больше одной (сторно): если такая уже
+    // в журнале, возвращается она и ничего не пишется. Повтор после сбоя записи файла
+    // пользователя не проводит операцию второй раз
+    LedgerEntry postOnce(const std::string &transactionId, const std::string &kind, std::vector<PostingLeg> legs,
+                         const std::string &note = std::string(), const std::string &category = std::string()) {
+        return write(transactionId, kind, std::move(legs), note, category, true);
+    }
+
+    // Последняя проводка операции данного вида; false — операции нет в журнале
+    bool find(const std::string &transactionId, const std::string &kind, LedgerEntry &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        const auto *e = last(transactionId, kind);
+        if (!e) return false;
+        out = *e;
+        return true;
+    }
+
+    // Проводки, затронувшие любой из счетов, в порядке записи
+    std::vector<LedgerEntry> entriesFor(const std::vector<std::string> &numbers) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        std::vector<std::size_t> indexes;
+        for (const auto &number : numbers) {
+            auto it = byAccount.find(number);
+            if (it != byAccount.end()) indexes.insert(indexes.end(), it->second.begin(), it->second.end());
+        }
+        std::sort(indexes.begin(), indexes.end());
+        indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+        std::vector<LedgerEntry> out;
+        out.reserve(indexes.size());
+        for (auto index : indexes) out.push_back(entries[index]);
+        return out;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        BalanceTable::instance().clear();
+        std::error_code ec;
+        std::filesystem::remove_all(ledgerRoot(), ec);
+        reset();
+        // пустой лог: после очистки перенос из файлов пользователей не нужен
+        std::filesystem::create_directories(ledgerRoot());
+        std::ofstream(logPath(), std::ios::trunc);
+        loaded = true;
+    }
+
+private:
+    std::mutex mutex;
+    bool loaded = false;
+    long long nextSeq = 1;
+    std::vector<LedgerEntry> entries;
+    std::unordered_map<std::string, long long> serviceBalances;
+    std::unordered_map<std::string, LedgerAccount> accounts;
+    std::unordered_map<std::string, std::string> cards;
+    std::unordered_map<std::string, std::vector<std::size_t>> byAccount;
+    std::unordered_map<std::string, std::vector<std::size_t>> byTransaction;
+
+    PostingLedger() = default;
+
+    static std::filesystem::path logPath() { return ledgerRoot() / "postings.log"; }
+
+    LedgerEntry write(const std::string &transactionId, const std::string &kind, std::vector<PostingLeg> legs,
+                      const std::string &note, const std::string &category, bool once) {
+        std::map<std::string, long long> perCurrency;
+        for (const auto &leg : legs) {
+            if (leg.account.empty()) throw ValidationError("Проводка без счета");
+            requirePlain(leg.account);
+            requirePlain(leg.currency);
+            perCurrency[leg.currency] += leg.cents;
+        }
+        for (const auto *field : {&transactionId, &kind, &category}) requirePlain(*field);
+        for (const auto &[currency, sum] : perCurrency) {
+            if (sum != 0) throw BankingError("Несбалансированная проводка " + transactionId + " (" + currency + ")");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        if (once) {
+            if (const auto *existing = last(transactionId, kind)) return *existing;
+        }
+        LedgerEntry e;
+        e.seq = nextSeq;
+        e.transactionId = transactionId;
+        e.kind = kind;
+        e.timestamp = std::time(nullptr);
+        e.category = category;
+        e.note = note;
+        std::replace(e.note.begin(), e.note.end(), '\n', ' ');
+        e.legs = std::move(legs);
+        std::ofstream ofs = openLog();
+        writeEntry(ofs, e);
+        ofs.flush();
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+        apply(e);
+        return e;
+    }
+
+    // Поля строки P идут через запятую без экранирования; только примечание — до конца строки
+    static void requirePlain(const std::string &field) {
+        if (field.find_first_of(",\r\n") != std::string::npos) throw ValidationError("Недопустимый символ в проводке: " + field);
+    }
+
+    const LedgerEntry *last(const std::string &transactionId, const std::string &kind) const {
+        auto it = byTransaction.find(transactionId);
+        if (it == byTransaction.end()) return nullptr;
+        for (auto index = it->second.rbegin(); index != it->second.rend(); ++index) {
+            if (entries[*index].kind == kind) return &entries[*index];
+        }
+        return nullptr;
+    }
+
+    std::ofstream openLog() {
+        std::filesystem::create_directories(ledgerRoot());
+        std::ofstream ofs(logPath(), std::ios::app);
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+        return ofs;
+    }
+
+    void reset() {
+        loaded = false;
+        nextSeq = 1;
+        entries.clear();
+        serviceBalances.clear();
+        accounts.clear();
+        cards.clear();
+        byAccount.clear();
+        byTransaction.clear();
+    }
+
+    void ensureLoaded() {
+        if (loaded) return;
+        reset();
+        loaded = true;
+        auto &table = BalanceTable::instance();
+        if (!std::filesystem::exists(logPath())) {
+            migrate();
+            return;
+        }
+        std::unordered_map<std::string, long long> replayed;
+        std::ifstream ifs(logPath());
+        std::string line;
+        std::size_t lineNo = 0;
+        while (std::getline(ifs, line)) {
+            ++lineNo;
+            if (line.size() < 2 || line[1] != ',') continue;
+            std::stringstream ss(line.substr(2));
+            std::string a, b, c;
+            switch (line[0]) {
+            case 'A':
+                std::getline(ss, a, ',');
+                std::getline(ss, b, ',');
+                std::getline(ss, c);
+                accounts[a] = {a, b, c};
+                table.ensure(a, b, c);
+                break;
+            case 'C':
+                std::getline(ss, a, ',');
+                std::getline(ss, b);
+                cards[a] = b;
+                break;
+            case 'X':
+                std::getline(ss, a);
+                forget(a);
+                table.releaseOwner(a);
+                break;
+            case 'P': {
+                LedgerEntry e;
+                if (readEntry(ss, e)) {
+                    apply(e, &replayed);
+                } else if (!ifs.eof()) {
+                    // пропуск проводки молча исказил бы балансы; недописанный хвост (без перевода
+                    // строки) — сбой посреди записи, операция не была подтверждена
+                    loaded = false;
+                    throw BankingError("Журнал проводок поврежден, строка " + std::to_string(lineNo) + ": " + logPath().string());
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        if (table.appliedSeq() != nextSeq - 1) {
+            for (const auto &[number, account] : accounts) table.set(number, 0);
+            for (const auto &[number, sum] : replayed) table.set(number, sum);
+            table.setAppliedSeq(nextSeq - 1);
+        }
+    }
+
+    // Первый запуск с журналом: входящие остатки всех счетов одной пачкой
+    void migrate() {
+        // таблица без лога — остаток прошлой установки
+        BalanceTable::instance().clear();
+        std::ofstream ofs = openLog();
+        UserStorage::forEachUser([&](const UserView &u) {
+            std::string owner(u.username);
+            for (const auto &a : u.accounts) {
+                if (!accounts.count(std::string(a.accountNumber))) {
+                    writeOpen(ofs, owner, std::string(a.accountNumber), std::string(a.currency), a.balanceCents);
+                }
+            }
+            for (const auto &c : u.cards) {
+                ofs << "C," << c.cardNumber << "," << c.linkedAccount << "\n";
+                cards[std::string(c.cardNumber)] = std::string(c.linkedAccount);
+            }
+        }, SectionAccounts | SectionCards);
+        ofs.flush();
+        if (!ofs) throw BankingError("Cannot write ledger: " + logPath().string());
+    }
+
+    void writeOpen(std::ofstream &ofs, const std::string &owner, const std::string &number, const std::string &currency, long long openingCents) {
+        ofs << "A," << number << "," << owner << "," << currency << "\n";
+        accounts[number] = {number, owner, currency};
+        BalanceTable::instance().ensure(number, owner, currency);
+        if (openingCents == 0) return;
+        LedgerEntry e;
+        e.seq = nextSeq;
+        e.kind = "open";
+        e.timestamp = std::time(nullptr);
+        e.legs = {{"equity:" + currency, currency, -openingCents}, {number, currency, openingCents}};
+        writeEntry(ofs, e);
+        apply(e);
+    }
+
+    void forget(const std::string &owner) {
+        for (auto it = accounts.begin(); it != accounts.end();) {
+            it = it->second.owner == owner ? accounts.erase(it) : std::next(it);
+        }
+        for (auto it = cards.begin(); it != cards.end();) {
+            it = accounts.count(it->second) ? std::next(it) : cards.erase(it);
+        }
+    }
+
+    static bool isService(const std::string &account) { return account.find(':') != std::string::npos; }
+
+    // replay — сумма при загрузке лога, без записи в таблицу
+    void apply(LedgerEntry e, std::unordered_map<std::string, long long> *replay = nullptr) {
+        std::size_t index = entries.size();
+        nextSeq = std::max(nextSeq, e.seq + 1);
+        for (const auto &leg : e.legs) {
+            if (isService(leg.account)) {
+                serviceBalances[leg.account] += leg.cents;
+            } else if (replay) {
+                (*replay)[leg.account] += leg.cents;
+            } else {
+                BalanceTable::instance().add(leg.account, leg.cents);
+            }
+            auto &list = byAccount[leg.account];
+            if (list.empty() || list.back() != index) list.push_back(index);
+        }
+        if (!e.transactionId.empty()) byTransaction[e.transactionId].push_back(index);
+        if (!replay) BalanceTable::instance().setAppliedSeq(e.seq);
+        entries.push_back(std::move(e));
+    }
+
+    // P,seq,timestamp,kind,txId,category,legs,(account,currency,cents)*legs,note — note до конца строки
+    static void writeEntry(std::ostream &os, const LedgerEntry &e) {
+        os << "P," << e.seq << "," << e.timestamp << "," << e.kind << "," << e.transactionId << "," << e.category << "," << e.legs.size();
+        for (const auto &leg : e.legs) os << "," << leg.account << "," << leg.currency << "," << leg.cents;
+        os << "," << e.note << "\n";
+    }
+
+    static bool readEntry(std::istream &is, LedgerEntry &e) {
+        std::string seq, ts, count;
+        try {
+            std::getline(is, seq, ',');
+            std::getline(is, ts, ',');
+            std::getline(is, e.kind, ',');
+            std::getline(is, e.transactionId, ',');
+            std::getline(is, e.category, ',');
+            std::getline(is, count, ',');
+            e.seq = std::stoll(seq);
+            e.timestamp = static_cast<std::time_t>(std::stoll(ts));
+            std::size_t n = std::stoul(count);
+            for (std::size_t i = 0; i < n; ++i) {
+                PostingLeg leg;
+                std::string cents;
+                std::getline(is, leg.account, ',');
+                std::getline(is, leg.currency, ',');
+                if (!std::getline(is, cents, ',')) return false;
+                leg.cents = std::stoll(cents);
+                e.legs.push_back(std::move(leg));
+            }
+            std::getline(is, e.note);
+        } catch (...) {
+            return false;
+        }
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "../utils/Exceptions.h"
+#include "../utils/Utils.h"
+
+namespace storage {
+
+// Курс хранится в фиксированной точке: 1.000000 == kRateScale.
+static constexpr long long kRateScale = 1000000;
+
+static inline std::filesystem::path ratesPath() {
+    return std::filesystem::path("data/rates.txt");
+}
+
+// Неизменяемый снимок разобранного файла курсов.
+struct RatesSnapshot {
+    std::string rawText;
+    std::map<std::string, long long> pairs;  // "USD/RUB" -> цена 1 USD в RUB * kRateScale
+    std::filesystem::file_time_type mtime{};
+    std::uintmax_t size = 0;
+
+    // Дробь num/den для пересчета from -> to: прямая пара, обратная или через общую валюту.
+    bool fraction(const std::string &from, const std::string &to, long long &num, long long &den) const {
+        if (from == to) { num = den = 1; return true; }
+        auto direct = pairs.find(from + "/" + to);
+        if (direct != pairs.end()) { num = direct->second; den = kRateScale; return true; }
+        auto inverse = pairs.find(to + "/" + from);
+        if (inverse != pairs.end()) { num = kRateScale; den = inverse->second; return true; }
+        for (const auto &[key, rate] : pairs) {
+            auto slash = key.find('/');
+            if (key.compare(0, slash, from) != 0 || slash != from.size()) continue;
+            auto quote = key.substr(slash + 1);
+            auto other = pairs.find(to + "/" + quote);
+            if (other != pairs.end()) { num = rate; den = other->second; return true; }
+        }
+        return false;
+    }
+};
+
+// Кэш курсов: файл перечитывается только при смене mtime/размера,
+// читатели получают целостный снимок через atomic shared_ptr без блокировок.
+class RatesTable {
+public:
+    static RatesTable &instance() {
+        static RatesTable table;
+        return table;
+    }
+
+    std::shared_ptr<const RatesSnapshot> snapshot() {
+        refreshIfChanged();
+        return std::atomic_load(&current);
+    }
+
+    // Пересчет суммы в копейках; округление до ближайшей копейки, половина — от нуля.
+    // rateOut — примененный курс from->to в фиксированной точке.
+    long long convert(long long cents, const std::string &from, const std::string &to, long long *rateOut = nullptr) {
+        if (from.empty() || to.empty() || from == to) {
+            if (rateOut) *rateOut = kRateScale;
+            return cents;
+        }
+        auto snap = snapshot();
+        long long num = 0, den = 1;
+        if (!snap || !snap->fraction(from, to, num, den)) {
+            throw ValidationError("Нет курса для " + from + "/" + to);
+        }
+        if (rateOut) *rateOut = utils::mulDivRound(kRateScale, num, den);
+        return utils::mulDivRound(cents, num, den);
+    }
+
+    // "100.25" -> 100250000; не более 6 знаков после точки, лишние округляются.
+    static long long parseFixed(const std::string &text) {
+        std::string s = utils::trim(text);
+        if (s.empty()) throw ValidationError("Пустой курс");
+        std::size_t dot = s.find_first_of(".,");
+        std::string whole = s.substr(0, dot);
+        std::string frac = dot == std::string::npos ? "" : s.substr(dot + 1);
+        if (whole.empty() && frac.empty()) throw ValidationError("Неверный курс: " + text);
+        for (char ch : whole + frac) {
+            if (ch < '0' || ch > '9') throw ValidationError("Неверный курс: " + text);
+        }
+        long long value = whole.empty() ? 0 : std::stoll(whole) * kRateScale;
+        long long unit = kRateScale / 10;
+        for (std::size_t i = 0; i < frac.size(); ++i) {
+            if (unit == 0) {
+                if (frac[i] >= '5') ++value;
+                break;
+            }
+            value += (frac[i] - '0') * unit;
+            unit /= 10;
+        }
+        return value;
+    }
+
+private:
+    std::shared_ptr<const RatesSnapshot> current;
+    std::atomic_flag reloading = ATOMIC_FLAG_INIT;
+    std::atomic<long long> lastCheckMs{0};
+
+    RatesTable() = default;
+
+    void refreshIfChanged() {
+        // stat не чаще раза в секунду; при гонке перечитывает только один поток
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        auto snap = std::atomic_load(&current);
+        if (snap && now - lastCheckMs.load(std::memory_order_relaxed) < 1000) return;
+        if (reloading.test_and_set(std::memory_order_acquire)) return;
+        try {
+            lastCheckMs.store(now, std::memory_order_relaxed);
+            auto path = ratesPath();
+            std::error_code ec;
+            if (!std::filesystem::exists(path, ec)) {
+                std::filesystem::create_directories(path.parent_path());
+                std::ofstream ofs(path);
+                ofs << "USD/RUB=100.00\nEUR/RUB=110.00\n";
+            }
+            auto mtime = std::filesystem::last_write_time(path);
+            auto size = std::filesystem::file_size(path);
+            if (!snap || snap->mtime != mtime || snap->size != size) {
+                std::atomic_store(&current, std::shared_ptr<const RatesSnapshot>(load(path, mtime, size)));
+            }
+        } catch (...) {
+            // оставляем прежний снимок
+        }
+        reloading.clear(std::memory_order_release);
+    }
+
+    static std::shared_ptr<RatesSnapshot> load(const std::filesystem::path &path, std::filesystem::file_time_type mtime, std::uintmax_t size) {
+        auto snap = std::make_shared<RatesSnapshot>();
+        snap->mtime = mtime;
+        snap->size = size;
+        std::ifstream ifs(path);
+        snap->rawText.assign((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::istringstream lines(snap->rawText);
+        std::string line;
+        while (std::getline(lines, line)) {
+            line = utils::trim(line);
+            auto eq = line.find('=');
+            if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+            auto pair = utils::trim(line.substr(0, eq));
+            if (pair.find('/') == std::string::npos) continue;
+            try {
+                long long rate = parseFixed(line.substr(eq + 1));
+                if (rate > 0) snap->pairs[pair] = rate;
+            } catch (...) {
+                // пропускаем битую строку
+            }
+        }
+        return snap;
+    }
+};
+
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "UserStorage.h"
+#include "UserScan.h"
+#include "HistoryArchive.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+static inline std::filesystem::path reconcileRoot() {
+    return std::filesystem::path("data/reconcile");
+}
+
+struct Discrepancy {
+    std::string account;
+    std::string owner;
+    long long expectedCents = 0;
+    long long actualCents = 0;
+    std::string reason;
+    std::vector<std::string> transactionIds;  // операции окна, затронувшие счет
+};
+
+struct ReconcileReport {
+    bool full = false;
+    std::time_t from = 0;  // время прошлой контрольной точки, 0 — сверка с нуля
+    std::time_t to = 0;
+    std::size_t usersChecked = 0;
+    std::size_t accountsChecked = 0;
+    std::size_t postings = 0;
+    double seconds = 0;
+    std::vector<Discrepancy> discrepancies;
+};
+
+// Сверка балансов с историей. Каждая операция раскладывается на проводки по счетам:
+//   перевод — списание cents со счета отправителя и зачисление creditedCents
+//             (для старых записей — cents) на счет получателя, найденный по карте или номеру;
+//   пополнение — зачисление на свой счет;
+//   отмена — обратные проводки.
+// Контрольная точка хранит балансы счетов, карты -> счета, число разобранных записей истории
+// каждого пользователя (сквозное, вместе с архивом) и id уже учтенных отмен. Инкрементальный прогон разбирает только файлы,
+// измененные после нее, берет новые записи истории и новые отмены и проверяет, что изменение
+// баланса каждого затронутого счета равно сумме его проводок.
+// Зачисление, которое не дошло до получателя, видно как расхождение на его счете.
+class Reconciler {
+public:
+    static ReconcileReport run(bool full = false, unsigned threads = 0) {
+        auto started = std::chrono::steady_clock::now();
+        std::filesystem::create_directories(reconcileRoot());
+        ReconcileReport report;
+        report.to = std::time(nullptr);
+
+        Checkpoint prev;
+        bool havePrev = !full && loadCheckpoint(prev);
+        report.full = !havePrev;
+        report.from = havePrev ? prev.time : 0;
+        if (!havePrev) prev = Checkpoint();
+
+        // отметка начала прогона: ее mtime станет границей для следующего
+        {
+            std::ofstream marker(startedPath(), std::ios::trunc);
+            marker << report.to << "\n";
+        }
+
+        std::vector<std::string> changed;
+        std::unordered_set<std::string> present;
+        std::error_code ec;
+        auto since = havePrev ? std::filesystem::last_write_time(markerPath(), ec) : std::filesystem::file_time_type::min();
+        if (ec) since = std::filesystem::file_time_type::min();
+        for (const auto &name : UserStorage::listUsernames()) {
+            present.insert(name);
+            auto mtime = std::filesystem::last_write_time(UserStorage::userPath(name), ec);
+            if (ec || !havePrev || mtime >= since) changed.push_back(name);
+        }
+        report.usersChecked = changed.size();
+
+        // параллельный разбор измененных пользователей
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(changed.size(), 1)));
+        std::vector<Partial> partials(threads);
+        std::atomic<std::size_t> next{0};
+        std::mutex failureMutex;
+        std::exception_ptr failure;
+        auto worker = [&](Partial &out) {
+            UserArena arena;
+            try {
+                for (std::size_t i = next++; i < changed.size(); i = next++) {
+                    UserView u(arena.resource());
+                    if (!UserScanner::parseFile(UserStorage::userPath(changed[i]), arena.resource(), u)) continue;
+                    collect(u, prev, out);
+                    arena.release();
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (!failure) failure = std::current_exception();
+                next = changed.size();
+            }
+        };
+        {
+            std::vector<std::thread> pool;
+            for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, std::ref(partials[t]));
+            worker(partials[0]);
+            for (auto &t : pool) t.join();
+        }
+        if (failure) std::rethrow_exception(failure);
+
+        // новое состояние: прошлая точка минус удаленные пользователи, плюс измененные
+        Checkpoint cur;
+        cur.time = report.to;
+        for (const auto &[number, state] : prev.accounts) {
+            if (present.count(state.owner)) cur.accounts[number] = state;
+        }
+        cur.cards = prev.cards;
+        cur.historySeen = prev.historySeen;
+        cur.cancelled = prev.cancelled;
+        for (auto it = cur.historySeen.begin(); it != cur.historySeen.end();) {
+            it = present.count(it->first) ? std::next(it) : cur.historySeen.erase(it);
+        }
+        std::unordered_set<std::string> changedSet(changed.begin(), changed.end());
+        for (auto it = cur.accounts.begin(); it != cur.accounts.end();) {
+            it = changedSet.count(it->second.owner) ? cur.accounts.erase(it) : std::next(it);
+        }
+        for (const auto &part : partials) {
+            for (const auto &state : part.accounts) cur.accounts[state.number] = state;
+            for (const auto &[card, account] : part.cards) cur.cards[card] = account;
+            for (const auto &[user, seen] : part.historySeen) cur.historySeen[user] = seen;
+            cur.cancelled.insert(part.cancelled.begin(), part.cancelled.end());
+        }
+
+        // проводки окна по счетам
+        std::unordered_map<std::string, long long> delta;
+        std::unordered_map<std::string, std::vector<std::string>> touched;
+        auto resolve = [&](const std::string &destination) -> std::string {
+            if (cur.accounts.count(destination)) return destination;
+            auto card = cur.cards.find(destination);
+            return card != cur.cards.end() && cur.accounts.count(card->second) ? card->second : std::string();
+        };
+        for (const auto &part : partials) {
+            report.postings += part.postings.size();
+            for (const auto &p : part.postings) {
+                std::string account = p.resolveDestination ? resolve(p.account) : p.account;
+                if (account.empty()) continue;  // внешний получатель
+                delta[account] += p.cents;
+                auto &ids = touched[account];
+                if (ids.empty() || ids.back() != p.transactionId) ids.push_back(p.transactionId);
+            }
+        }
+
+        // сверка: изменение баланса == сумма проводок
+        auto check = [&](const std::string &number, const AccountState &state) {
+            long long before = 0;
+            auto old = prev.accounts.find(number);
+            if (old != prev.accounts.end()) before = old->second.balance;
+            long long expected = before + (delta.count(number) ? delta[number] : 0);
+            if (expected != state.balance) {
+                Discrepancy d;
+                d.account = number;
+                d.owner = state.owner;
+                d.expectedCents = expected;
+                d.actualCents = state.balance;
+                d.reason = changedSet.count(state.owner) ? "баланс не сходится с историей" : "проводки не применены к файлу получателя";
+                d.transactionIds = touched[number];
+                report.discrepancies.push_back(std::move(d));
+            } else if (state.balance < 0) {
+                Discrepancy d;
+                d.account = number;
+                d.owner = state.owner;
+                d.expectedCents = d.actualCents = state.balance;
+                d.reason = "отрицательный баланс";
+                d.transactionIds = touched[number];
+                report.discrepancies.push_back(std::move(d));
+            }
+        };
+        for (const auto &[number, state] : cur.accounts) {
+            if (!changedSet.count(state.owner) && !delta.count(number)) continue;
+            ++report.accountsChecked;
+            check(number, state);
+        }
+
+        saveCheckpoint(cur);
+        std::filesystem::rename(startedPath(), markerPath(), ec);
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        saveReport(report);
+        return report;
+    }
+
+private:
+    struct AccountState {
+        std::string number;
+        std::string owner;
+        long long balance = 0;
+    };
+
+    struct Posting {
+        std::string transactionId;
+        std::string account;      // номер счета или, при resolveDestination, карта/счет получателя
+        bool resolveDestination = false;
+        long long cents = 0;
+    };
+
+    struct Seen {
+        std::size_t total = 0;     // разобрано записей истории, считая архив
+        std::size_t archived = 0;  // из них в архиве на момент разбора
+    };
+
+    struct Partial {
+        std::vector<AccountState> accounts;
+        std::vector<std::pair<std::string, std::string>> cards;
+        std::vector<std::pair<std::string, Seen>> historySeen;
+        std::vector<std::string> cancelled;
+        std::vector<Posting> postings;
+    };
+
+    struct Checkpoint {
+        std::time_t time = 0;
+        std::map<std::string, AccountState> accounts;
+        std::map<std::string, std::string> cards;
+        std::map<std::string, Seen> historySeen;
+        std::unordered_set<std::string> cancelled;        // id отмен, уже вошедших в балансы
+    };
+
+    static std::filesystem::path checkpointPath() { return reconcileRoot() / "checkpoint.txt"; }
+    static std::filesystem::path markerPath() { return reconcileRoot() / "checkpoint.marker"; }
+    static std::filesystem::path startedPath() { return reconcileRoot() / "running.marker"; }
+    static std::filesystem::path reportPath() { return reconcileRoot() / "report.txt"; }
+
+    // prev только читается, поэтому потоки разделяют его без блокировок
+    static void collect(const UserView &u, const Checkpoint &prev, Partial &out) {
+        std::string owner(u.username);
+        std::unordered_set<std::string_view> own;
+        for (const auto &a : u.accounts) {
+            own.insert(a.accountNumber);
+            out.accounts.push_back({std::string(a.accountNumber), owner, a.balanceCents});
+        }
+        for (const auto &c : u.cards) out.cards.emplace_back(std::string(c.cardNumber), std::string(c.linkedAccount));
+        std::size_t archived = HistoryArchive::archivedCount(owner);
+        std::size_t total = archived + u.history.size();
+        auto seen = prev.historySeen.find(owner);
+        bool known = seen != prev.historySeen.end() && seen->second.total <= total;
+        std::size_t first = known ? seen->second.total : 0;
+        std::size_t archivedBefore = known ? std::min(seen->second.archived, archived) : 0;
+        out.historySeen.push_back({owner, {total, archived}});
+
+        auto visit = [&](std::size_t index, const auto &t) {
+            bool outgoing = own.count(t.fromAccount) > 0;
+            long long credited = t.creditedCents ? t.creditedCents : t.cents;
+            std::string id(t.id);
+            if (index >= first) {
+                if (outgoing) {
+                    out.postings.push_back({id, std::string(t.fromAccount), false, -t.cents});
+                    out.postings.push_back({id, std::string(t.toCard), true, credited});
+                } else {
+                    out.postings.push_back({id, std::string(t.toCard), true, t.cents});
+                }
+            }
+            if (t.status == "cancelled" && !prev.cancelled.count(id)) {
+                if (outgoing) out.postings.push_back({id, std::string(t.fromAccount), false, t.cents});
+                out.postings.push_back({id, std::string(t.toCard), true, -(outgoing ? credited : t.cents)});
+                out.cancelled.push_back(id);
+            }
+        };
+        // из архива — новые записи и те, что ушли в него после прошлой точки: их отмены могли еще не войти в балансы
+        std::size_t archiveFrom = std::min(first, archivedBefore);
+        if (archived > archiveFrom) HistoryArchive::forEach(owner, archiveFrom, visit);
+        for (std::size_t i = 0; i < u.history.size(); ++i) visit(archived + i, u.history[i]);
+    }
+
+    static bool loadCheckpoint(Checkpoint &cp) {
+        std::ifstream ifs(checkpointPath());
+        if (!ifs || !std::filesystem::exists(markerPath())) return false;
+        std::string line;
+        if (!std::getline(ifs, line)) return false;
+        try {
+            cp.time = static_cast<std::time_t>(std::stoll(line));
+            while (std::getline(ifs, line)) {
+                std::stringstream ss(line);
+                std::string kind, a, b, c;
+                std::getline(ss, kind, ',');
+                std::getline(ss, a, ',');
+                std::getline(ss, b, ',');
+                if (kind == "A") {
+                    std::getline(ss, c);
+                    cp.accounts[a] = {a, b, std::stoll(c)};
+                } else if (kind == "C") {
+                    cp.cards[a] = b;
+                } else if (kind == "U") {
+                    std::getline(ss, c);
+                    cp.historySeen[a] = {static_cast<std::size_t>(std::stoull(b)), c.empty() ? 0 : static_cast<std::size_t>(std::stoull(c))};
+                } else if (kind == "X") {
+                    cp.cancelled.insert(a);
+                }
+            }
+        } catch (...) {
+            return false;
+        }
+        return true;
+    }
+
+    static void saveCheckpoint(const Checkpoint &cp) {
+        auto tmp = checkpointPath();
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) throw BankingError("Cannot write checkpoint: " + tmp.string());
+            ofs << cp.time << "\n";
+            for (const auto &[number, state] : cp.accounts) ofs << "A," << number << "," << state.owner << "," << state.balance << "\n";
+            for (const auto &[card, account] : cp.cards) ofs << "C," << card << "," << account << "\n";
+            for (const auto &[user, seen] : cp.historySeen) ofs << "U," << user << "," << seen.total << "," << seen.archived << "\n";
+            for (const auto &id : cp.cancelled) ofs << "X," << id << ",\n";
+        }
+        std::filesystem::rename(tmp, checkpointPath());
+    }
+
+    static void saveReport(const ReconcileReport &r) {
+        std::ofstream ofs(reportPath(), std::ios::trunc);
+        ofs << "сверка: " << r.from << " - " << r.to << (r.full ? " (полная)" : "") << "\n";
+        ofs << "пользователей: " << r.usersChecked << ", счетов: " << r.accountsChecked << ", проводок: " << r.postings << "\n";
+        for (const auto &d : r.discrepancies) {
+            ofs << d.account << "," << d.owner << "," << d.expectedCents << "," << d.actualCents << "," << d.reason << ",";
+            for (std::size_t i = 0; i < d.transactionIds.size(); ++i) ofs << (i ? " " : "") << d.transactionIds[i];
+            ofs << "\n";
+        }
+    }
+};
+
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include "../models/ScheduledPayment.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+static inline std::filesystem::path schedulesPath() {
+    return std::filesystem::path("data/schedules.txt");
+}
+
+// Поручения в памяти + min-heap по nextRun. Удаленные/перенесенные записи
+// остаются в куче и отбрасываются при извлечении (ленивое удаление).
+class ScheduleStore {
+public:
+    static ScheduleStore &instance() {
+        static ScheduleStore store;
+        return store;
+    }
+
+    void add(const ScheduledPayment &p) {
+        ensureLoaded();
+        items[p.id] = p;
+        heap.push({p.nextRun, p.id});
+        save();
+    }
+
+    bool remove(const std::string &id, const std::string &owner) {
+        ensureLoaded();
+        auto it = items.find(id);
+        if (it == items.end() || it->second.owner != owner) return false;
+        items.erase(it);
+        save();
+        return true;
+    }
+
+    // Удаление пользователя: все его поручения; записи кучи отбросятся при извлечении
+    void removeOwner(const std::string &owner) {
+        ensureLoaded();
+        std::size_t before = items.size();
+        for (auto it = items.begin(); it != items.end();) {
+            it = it->second.owner == owner ? items.erase(it) : std::next(it);
+        }
+        if (items.size() != before) save();
+    }
+
+    std::vector<ScheduledPayment> forOwner(const std::string &owner) {
+        ensureLoaded();
+        std::vector<ScheduledPayment> out;
+        for (const auto &[id, p] : items) {
+            if (p.owner == owner) out.push_back(p);
+        }
+        return out;
+    }
+
+    // Ближайший запуск; 0 — поручений нет
+    std::time_t nextDue() {
+        ensureLoaded();
+        dropStale();
+        return heap.empty() ? 0 : heap.top().first;
+    }
+
+    // Извлекает поручения с nextRun <= now (копии на момент извлечения)
+    std::vector<ScheduledPayment> takeDue(std::time_t now) {
+        ensureLoaded();
+        std::vector<ScheduledPayment> due;
+        for (;;) {
+            dropStale();
+            if (heap.empty() || heap.top().first > now) break;
+            auto id = heap.top().second;
+            heap.pop();
+            due.push_back(items[id]);
+        }
+        return due;
+    }
+
+    // Переназначить поручение после исполнения; nextRun == 0 — удалить
+    void reschedule(const std::string &id, std::time_t nextRun) {
+        auto it = items.find(id);
+        if (it == items.end()) return;
+        if (nextRun == 0) {
+            items.erase(it);
+            return;
+        }
+        it->second.nextRun = nextRun;
+        heap.push({nextRun, id});
+    }
+
+    void save() {
+        std::filesystem::create_directories(schedulesPath().parent_path());
+        auto tmp = schedulesPath();
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) throw BankingError("Cannot write schedules: " + schedulesPath().string());
+            for (const auto &[id, p] : items) ofs << p << "\n";
+        }
+        std::filesystem::rename(tmp, schedulesPath());
+    }
+
+    void clear() {
+        items.clear();
+        heap = {};
+        loaded = true;
+        save();
+    }
+
+private:
+    using Entry = std::pair<std::time_t, std::string>;
+
+    bool loaded = false;
+    std::map<std::string, ScheduledPayment> items;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+
+    ScheduleStore() = default;
+
+    void ensureLoaded() {
+        if (loaded) return;
+        loaded = true;
+        std::ifstream ifs(schedulesPath());
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (line.empty()) continue;
+            std::istringstream ls(line);
+            ScheduledPayment p;
+            try {
+                ls >> p;
+            } catch (...) {
+                continue;
+            }
+            items[p.id] = p;
+            heap.push({p.nextRun, p.id});
+        }
+    }
+
+    void dropStale() {
+        while (!heap.empty()) {
+            auto it = items.find(heap.top().second);
+            if (it != items.end() && it->second.nextRun == heap.top().first) break;
+            heap.pop();
+        }
+    }
+};
+
+}
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include "UserScan.h"
+#include "../utils/Exceptions.h"
+
+namespace storage {
+
+// Словарь строковой колонки: код — номер значения в values
+struct ColumnDictionary {
+    std::vector<std::string_view> values;
+    std::unordered_map<std::string_view, std::uint32_t> codes;
+
+    std::uint32_t code(std::string_view value) {
+        auto [it, inserted] = codes.emplace(value, static_cast<std::uint32_t>(values.size()));
+        if (inserted) values.push_back(value);
+        return it->second;
+    }
+
+    // values.size(), если значения нет
+    std::uint32_t find(std::string_view value) const {
+        auto it = codes.find(value);
+        return it != codes.end() ? it->second : static_cast<std::uint32_t>(values.size());
+    }
+};
+
+// Переводы всех пользователей по колонкам. Строки — string_view в арену scanAll,
+// поэтому колонки живут не дольше арены.
+struct TransferColumns {
+    std::vector<std::int64_t> cents;
+    std::vector<std::int64_t> timestamps;
+    std::vector<std::int64_t> rates;
+    std::vector<std::int64_t> credited;
+    std::vector<std::uint32_t> users;
+    std::vector<std::uint32_t> categories;
+    std::vector<std::uint32_t> statuses;
+    std::vector<std::string_view> ids;
+    std::vector<std::string_view> fromAccounts;
+    std::vector<std::string_view> toCards;
+    std::vector<std::string_view> notes;
+    std::vector<std::string_view> reasons;
+    std::vector<const TransactionView *> rows;
+    ColumnDictionary userNames;
+    ColumnDictionary categoryNames;
+    ColumnDictionary statusNames;
+
+    std::size_t size() const { return rows.size(); }
+
+    static TransferColumns build(const std::pmr::vector<UserView> &all) {
+        TransferColumns c;
+        std::size_t total = 0;
+        for (const auto &u : all) total += u.history.size();
+        c.reserve(total);
+        for (const auto &u : all) {
+            std::uint32_t user = c.userNames.code(u.username);
+            for (const auto &t : u.history) {
+                c.cents.push_back(t.cents);
+                c.timestamps.push_back(t.timestamp);
+                c.rates.push_back(t.rate);
+                c.credited.push_back(t.creditedCents);
+                c.users.push_back(user);
+                c.categories.push_back(c.categoryNames.code(t.category));
+                c.statuses.push_back(c.statusNames.code(t.status));
+                c.ids.push_back(t.id);
+                c.fromAccounts.push_back(t.fromAccount);
+                c.toCards.push_back(t.toCard);
+                c.notes.push_back(t.note);
+                c.reasons.push_back(t.cancelReason);
+                c.rows.push_back(&t);
+            }
+        }
+        return c;
+    }
+
+private:
+    void reserve(std::size_t n) {
+        for (auto *v : {&cents, &timestamps, &rates, &credited}) v->reserve(n);
+        for (auto *v : {&users, &categories, &statuses}) v->reserve(n);
+        for (auto *v : {&ids, &fromAccounts, &toCards, &notes, &reasons}) v->reserve(n);
+        rows.reserve(n);
+    }
+};
+
+struct TransferQueryResult {
+    std::size_t count = 0;
+    long long sumCents = 0;
+    std::vector<std::uint32_t> top;  // номера строк TransferColumns, первые limit по порядку
+};
+
+// Язык запросов администратора:
+//   cents > 100000 AND status = cancelled AND timestamp >= 2026-01-01 AND user ~ "ivan"
+// Поля: cents, amount (в рублях), timestamp/date, rate, credited — числа (= != < <= > >=);
+// user, category, status — словарные; id, from, to, note, reason — строки (= != ~ !~).
+// Связки AND, OR, NOT и скобки; даты — ГГГГ-ММ-ДД[THH:MM[:SS]] в UTC.
+// План вычисляется по колонкам целиком: каждое сравнение — плотный цикл, дающий маску
+// строк, словарные поля сравниваются по кодам, маски объединяются побайтно. QVariantMap
+// строится только для строк, попавших в top.
+class TransferQuery {
+public:
+    static TransferQuery compile(const std::string &text) {
+        TransferQuery q;
+        Parser p{text};
+        p.skipSpace();
+        if (p.pos == text.size()) return q;  // пустой запрос — все переводы
+        q.root = p.parseOr();
+        p.skipSpace();
+        if (p.pos != text.size()) p.fail("лишний текст");
+        q.empty = false;
+        return q;
+    }
+
+    // orderBy — поле и необязательное asc/desc (по умолчанию desc)
+    TransferQueryResult run(const TransferColumns &c, const std::string &orderBy, std::size_t limit) const {
+        TransferQueryResult r;
+        const std::size_t n = c.size();
+        std::vector<std::uint8_t> mask = empty ? std::vector<std::uint8_t>(n, 1) : eval(root, c);
+        const std::uint8_t *m = mask.data();
+        const std::int64_t *cents = c.cents.data();
+        std::size_t count = 0;
+        long long sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            count += m[i];
+            sum += cents[i] & -static_cast<std::int64_t>(m[i]);
+        }
+        r.count = count;
+        r.sumCents = sum;
+        if (limit == 0 || count == 0) return r;
+
+        std::vector<std::uint32_t> hits;
+        hits.reserve(count);
+        for (std::uint32_t i = 0; i < n; ++i) {
+            if (m[i]) hits.push_back(i);
+        }
+        auto less = orderLess(c, orderBy);
+        auto middle = hits.begin() + static_cast<std::ptrdiff_t>(std::min(limit, hits.size()));
+        std::partial_sort(hits.begin(), middle, hits.end(), less);
+        hits.erase(middle, hits.end());
+        r.top = std::move(hits);
+        return r;
+    }
+
+private:
+    enum class Field { Cents, Timestamp, Rate, Credited, User, Category, Status, Id, From, To, Note, Reason };
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge, Contains, NotContains };
+
+    struct Node {
+        enum class Kind { And, Or, Not, Compare } kind = Kind::Compare;
+        Field field = Field::Cents;
+        Op op = Op::Eq;
+        long long number = 0;
+        std::string text;
+        std::vector<Node> children;
+    };
+
+    Node root;
+    bool empty = true;
+
+    static bool numeric(Field f) { return f == Field::Cents || f == Field::Timestamp || f == Field::Rate || f == Field::Credited; }
+    static bool dictionary(Field f) { return f == Field::User || f == Field::Category || f == Field::Status; }
+
+    static bool fieldByName(std::string name, Field &field, bool &rubles) {
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch){ return static_cast<char>(std::tolower(ch)); });
+        static const std::unordered_map<std::string, Field> names{
+            {"cents", Field::Cents}, {"amount", Field::Cents}, {"timestamp", Field::Timestamp}, {"date", Field::Timestamp},
+            {"rate", Field::Rate}, {"credited", Field::Credited}, {"creditedcents", Field::Credited},
+            {"user", Field::User}, {"category", Field::Category}, {"status", Field::Status},
+            {"id", Field::Id}, {"from", Field::From}, {"fromaccount", Field::From}, {"to", Field::To}, {"tocard", Field::To},
+            {"note", Field::Note}, {"reason", Field::Reason}, {"cancelreason", Field::Reason}};
+        auto it = names.find(name);
+        if (it == names.end()) return false;
+        field = it->second;
+        rubles = name == "amount";
+        return true;
+    }
+
+    struct Parser {
+        const std::string &text;
+        std::size_t pos = 0;
+
+        [[noreturn]] void fail(const std::string &what) const {
+            throw ValidationError("Ошибка в запросе (позиция " + std::to_string(pos + 1) + "): " + what);
+        }
+
+        void skipSpace() {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+        }
+
+        static bool wordChar(char ch) {
+            return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '.' || ch == '-' || ch == ':' || ch == '+' || ch == '@'
+                   || static_cast<unsigned char>(ch) >= 0x80;
+        }
+
+        std::string word() {
+            skipSpace();
+            std::size_t start = pos;
+            while (pos < text.size() && wordChar(text[pos])) ++pos;
+            return text.substr(start, pos - start);
+        }
+
+        bool keyword(const char *kw) {
+            skipSpace();
+            std::size_t len = std::char_traits<char>::length(kw), end = pos + len;
+            if (end > text.size() || (end < text.size() && wordChar(text[end]))) return false;
+            for (std::size_t i = 0; i < len; ++i) {
+                if (std::toupper(static_cast<unsigned char>(text[pos + i])) != kw[i]) return false;
+            }
+            pos = end;
+            return true;
+        }
+
+        bool symbol(char ch) {
+            skipSpace();
+            if (pos < text.size() && text[pos] == ch) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        Node parseOr() {
+            Node left = parseAnd();
+            if (!keyword("OR")) return left;
+            Node node;
+            node.kind = Node::Kind::Or;
+            node.children.push_back(std::move(left));
+            do node.children.push_back(parseAnd()); while (keyword("OR"));
+            return node;
+        }
+
+        Node parseAnd() {
+            Node left = parseNot();
+            if (!keyword("AND")) return left;
+            Node node;
+            node.kind = Node::Kind::And;
+            node.children.push_back(std::move(left));
+            do node.children.push_back(parseNot()); while (keyword("AND"));
+            return node;
+        }
+
+        Node parseNot() {
+            if (keyword("NOT")) {
+                Node node;
+                node.kind = Node::Kind::Not;
+                node.children.push_back(parseNot());
+                return node;
+            }
+            if (symbol('(')) {
+                Node inner = parseOr();
+                if (!symbol(')')) fail("ожидалась ')'");
+                return inner;
+            }
+            return parseCompare();
+        }
+
+        Node parseCompare() {
+            Node node;
+            std::string name = word();
+            bool rubles = false;
+            if (name.empty()) fail("ожидалось поле");
+            if (!fieldByName(name, node.field, rubles)) fail("неизвестное поле " + name);
+            node.op = parseOp();
+            skipSpace();
+            std::string value = pos < text.size() && text[pos] == '"' ? quoted() : word();
+            if (numeric(node.field)) {
+                if (node.op == Op::Contains || node.op == Op::NotContains) fail("~ неприменим к числовому полю " + name);
+                if (!toNumber(value, node.field, rubles, node.number)) fail("ожидалось число или дата: " + value);
+            } else {
+                if (node.op != Op::Eq && node.op != Op::Ne && node.op != Op::Contains && node.op != Op::NotContains) {
+                    fail("поле " + name + " сравнивается только через = != ~ !~");
+                }
+                node.text = value;
+            }
+            return node;
+        }
+
+        Op parseOp() {
+            skipSpace();
+            auto next = [&](const char *op) {
+                std::size_t len = std::char_traits<char>::length(op);
+                if (text.compare(pos, len, op) != 0) return false;
+                pos += len;
+                return true;
+            };
+            if (next("!=")) return Op::Ne;
+            if (next("!~")) return Op::NotContains;
+            if (next("<=")) return Op::Le;
+            if (next(">=")) return Op::Ge;
+            if (next("=")) return Op::Eq;
+            if (next("<")) return Op::Lt;
+            if (next(">")) return Op::Gt;
+            if (next("~")) return Op::Contains;
+            fail("ожидался оператор сравнения");
+        }
+
+        std::string quoted() {
+            std::string out;
+            ++pos;
+            while (pos < text.size() && text[pos] != '"') {
+                if (text[pos] == '\\' && pos + 1 < text.size()) ++pos;
+                out.push_back(text[pos++]);
+            }
+            if (pos == text.size()) fail("незакрытая кавычка");
+            ++pos;
+            return out;
+        }
+    };
+
+    static bool digits(const std::string &s, std::size_t from, std::size_t count, long long &out) {
+        if (from + count > s.size()) return false;
+        out = 0;
+        for (std::size_t i = from; i < from + count; ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(s[i]))) return false;
+            out = out * 10 + (s[i] - '0');
+        }
+        return true;
+    }
+
+    // Дни от 1970-01-01 по григорианскому календарю
+    static long long daysFromCivil(long long y, long long m, long long d) {
+        y -= m <= 2;
+        long long era = (y >= 0 ? y : y - 399) / 400;
+        long long yoe = y - era * 400;
+        long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    static bool toNumber(const std::string &value, Field field, bool rubles, long long &out) {
+        if (value.empty()) return false;
+        if (field == Field::Timestamp && value.size() >= 10 && value[4] == '-') {
+            long long y, mo, d, h = 0, mi = 0, s = 0;
+            if (!digits(value, 0, 4, y) || value[7] != '-' || !digits(value, 5, 2, mo) || !digits(value, 8, 2, d)) return false;
+            if (value.size() > 10) {
+                if ((value[10] != 'T' && value[10] != ' ') || !digits(value, 11, 2, h) || value.size() < 16 || value[13] != ':' || !digits(value, 14, 2, mi)) return false;
+                if (value.size() > 16 && (value[16] != ':' || !digits(value, 17, 2, s) || value.size() != 19)) return false;
+            }
+            if (mo < 1 || mo > 12 || d < 1 || d > 31) return false;
+            out = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+            return true;
+        }
+        std::size_t i = value[0] == '-' ? 1 : 0;
+        long long whole = 0, fraction = 0, scale = 1;
+        bool any = false, dot = false;
+        for (; i < value.size(); ++i) {
+            char ch = value[i];
+            if (ch == '.' && rubles && !dot) {
+                dot = true;
+            } else if (std::isdigit(static_cast<unsigned char>(ch))) {
+                any = true;
+                if (!dot) whole = whole * 10 + (ch - '0');
+                else if (scale < 100) fraction = fraction * 10 + (ch - '0'), scale *= 10;
+            } else {
+                return false;
+            }
+        }
+        if (!any) return false;
+        out = rubles ? whole * 100 + fraction * (100 / scale) : whole;
+        if (value[0] == '-') out = -out;
+        return true;
+    }
+
+    static const std::vector<std::int64_t> &numberColumn(const TransferColumns &c, Field f) {
+        switch (f) {
+        case Field::Timestamp: return c.timestamps;
+        case Field::Rate: return c.rates;
+        case Field::Credited: return c.credited;
+        default: return c.cents;
+        }
+    }
+
+    static const ColumnDictionary &dictionaryOf(const TransferColumns &c, Field f, const std::vector<std::uint32_t> *&codes) {
+        switch (f) {
+        case Field::User: codes = &c.users; return c.userNames;
+        case Field::Category: codes = &c.categories; return c.categoryNames;
+        default: codes = &c.statuses; return c.statusNames;
+        }
+    }
+
+    static const std::vector<std::string_view> &textColumn(const TransferColumns &c, Field f) {
+        switch (f) {
+        case Field::Id: return c.ids;
+        case Field::From: return c.fromAccounts;
+        case Field::To: return c.toCards;
+        case Field::Reason: return c.reasons;
+        default: return c.notes;
+        }
+    }
+
+    template <typename Cmp>
+    static void compareColumn(const std::int64_t *col, std::size_t n, std::int64_t value, std::uint8_t *out, Cmp cmp) {
+        for (std::size_t i = 0; i < n; ++i) out[i] = cmp(col[i], value);
+    }
+
+    static std::vector<std::uint8_t> eval(const Node &node, const TransferColumns &c) {
+        const std::size_t n = c.size();
+        if (node.kind != Node::Kind::Compare) {
+            std::vector<std::uint8_t> mask = eval(node.children.front(), c);
+            std::uint8_t *m = mask.data();
+            if (node.kind == Node::Kind::Not) {
+                for (std::size_t i = 0; i < n; ++i) m[i] ^= 1;
+            }
+            for (std::size_t k = 1; k < node.children.size(); ++k) {
+                auto other = eval(node.children[k], c);
+                const std::uint8_t *o = other.data();
+                if (node.kind == Node::Kind::And) {
+                    for (std::size_t i = 0; i < n; ++i) m[i] &= o[i];
+                } else {
+                    for (std::size_t i = 0; i < n; ++i) m[i] |= o[i];
+                }
+            }
+            return mask;
+        }
+
+        std::vector<std::uint8_t> mask(n, 0);
+        std::uint8_t *m = mask.data();
+        if (numeric(node.field)) {
+            const std::int64_t *col = numberColumn(c, node.field).data();
+            const std::int64_t v = node.number;
+            switch (node.op) {
+            case Op::Eq: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a == b; }); break;
+            case Op::Ne: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a != b; }); break;
+            case Op::Lt: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a < b; }); break;
+            case Op::Le: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a <= b; }); break;
+            case Op::Gt: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a > b; }); break;
+            default: compareColumn(col, n, v, m, [](std::int64_t a, std::int64_t b){ return a >= b; }); break;
+            }
+            return mask;
+        }
+
+        const bool negate = node.op == Op::Ne || node.op == Op::NotContains;
+        const bool contains = node.op == Op::Contains || node.op == Op::NotContains;
+        if (dictionary(node.field)) {
+            // условие проверяется один раз на значение словаря, по строкам идет только код
+            const std::vector<std::uint32_t> *codes = nullptr;
+            const auto &dict = dictionaryOf(c, node.field, codes);
+            std::vector<std::uint8_t> hit(dict.values.size() + 1, 0);
+            if (contains) {
+                for (std::size_t k = 0; k < dict.values.size(); ++k) hit[k] = dict.values[k].find(node.text) != std::string_view::npos;
+            } else {
+                hit[dict.find(node.text)] = 1;
+            }
+            if (negate) {
+                for (auto &h : hit) h ^= 1;
+            }
+            const std::uint32_t *col = codes->data();
+            const std::uint8_t *h = hit.data();
+            for (std::size_t i = 0; i < n; ++i) m[i] = h[col[i]];
+            return mask;
+        }
+
+        const auto &col = textColumn(c, node.field);
+        const std::string_view needle(node.text);
+        for (std::size_t i = 0; i < n; ++i) {
+            bool match = contains ? col[i].find(needle) != std::string_view::npos : col[i] == needle;
+            m[i] = match != negate;
+        }
+        return mask;
+    }
+
+    static std::function<bool(std::uint32_t, std::uint32_t)> orderLess(const TransferColumns &c, const std::string &orderBy) {
+        Parser p{orderBy};
+        std::string name = p.word();
+        bool ascending = p.keyword("ASC");
+        if (!ascending) p.keyword("DESC");
+        p.skipSpace();
+        Field field = Field::Timestamp;
+        bool rubles = false;
+        if (!name.empty() && !fieldByName(name, field, rubles)) throw ValidationError("Неизвестное поле сортировки: " + name);
+        if (p.pos != orderBy.size()) throw ValidationError("Сортировка задается как \"поле [asc|desc]\"");
+
+        // при равенстве — более новые раньше
+        const auto *ts = &c.timestamps;
+        auto tie = [ts](std::uint32_t a, std::uint32_t b){ return (*ts)[a] > (*ts)[b]; };
+        if (numeric(field)) {
+            const auto *col = &numberColumn(c, field);
+            return [col, ascending, tie](std::uint32_t a, std::uint32_t b){
+                if ((*col)[a] != (*col)[b]) return ascending ? (*col)[a] < (*col)[b] : (*col)[a] > (*col)[b];
+                return tie(a, b);
+            };
+        }
+        const std::vector<std::uint32_t> *codes = nullptr;
+        const std::vector<std::string_view> *values = nullptr;
+        const std::vector<std::string_view> *col = nullptr;
+        if (dictionary(field)) values = &dictionaryOf(c, field, codes).values;
+        else col = &textColumn(c, field);
+        return [codes, values, col, ascending, tie](std::uint32_t a, std::uint32_t b){
+            std::string_view x = col ? (*col)[a] : (*values)[(*codes)[a]];
+            std::string_view y = col ? (*col)[b] : (*values)[(*codes)[b]];
+            if (x != y) return ascending ? x < y : x > y;
+            return tie(a, b);
+        };
+    }
+};
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include "UserStorage.h"
+
+namespace storage {
+
+// Поиск подстроки по переводам всех пользователей, рассчитанный на набор с клавиатуры.
+// Разобранные файлы (корпус) живут между запросами и разбираются по мере надобности.
+// Поиск идет порциями step до дедлайна, так что первые строки готовы раньше остальных,
+// а новый start просто заменяет незаконченный поиск. Если новый запрос содержит прежний
+// ("iva" -> "ivan"), все, что ему подходит, уже среди найденного или еще не просмотрено:
+// проверяются только прежние совпадения, затем просмотр корпуса продолжается с того же места.
+class TransferSearch {
+public:
+    struct Hit {
+        std::uint32_t user;
+        std::uint32_t tx;
+        bool operator<(const Hit &o) const { return user != o.user ? user < o.user : tx < o.tx; }
+    };
+
+    void start(std::string query) {
+        bool refinement = started && corpus && query.find(current) != std::string::npos;
+        if (refinement) {
+            // найденное и еще не перепроверенное — обе части в порядке корпуса
+            std::vector<Hit> candidates;
+            candidates.reserve(matches.size() + inherited.size() - inheritedPos);
+            std::merge(matches.begin(), matches.end(), inherited.begin() + static_cast<std::ptrdiff_t>(inheritedPos), inherited.end(),
+                       std::back_inserter(candidates));
+            inherited = std::move(candidates);
+        } else {
+            inherited.clear();
+            cursor = {0, 0};
+        }
+        inheritedPos = 0;
+        matches.clear();
+        current = std::move(query);
+        started = true;
+        finished = false;
+    }
+
+    // Файлы пользователей изменились: корпус разбирается заново, поиск начинается сначала
+    void reset() {
+        corpus.reset();
+        inherited.clear();
+        inheritedPos = 0;
+        matches.clear();
+        cursor = {0, 0};
+        finished = false;
+    }
+
+    // Ищет до дедлайна или до maxFound новых совпадений, добавляя их в found. true — поиск завершен
+    bool step(std::chrono::steady_clock::time_point deadline, std::size_t maxFound, std::vector<Hit> &found) {
+        if (!started || finished) return true;
+        if (!corpus) {
+            corpus = std::make_unique<Corpus>();
+            corpus->names = UserStorage::listUsernames();
+            corpus->users.reserve(corpus->names.size());
+        }
+        std::size_t limit = found.size() + maxFound;
+        for (unsigned n = 0; found.size() < limit; ++n) {
+            // часы опрашиваются раз в 256 проверок
+            if ((n & 255) == 255 && std::chrono::steady_clock::now() >= deadline) return false;
+            if (inheritedPos < inherited.size()) {
+                test(inherited[inheritedPos++], found);
+                continue;
+            }
+            if (cursor.user >= corpus->users.size()) {
+                if (!parseNext()) {
+                    finished = true;
+                    return true;
+                }
+                n |= 255;  // разбор файла дороже проверки
+                continue;
+            }
+            if (cursor.tx >= corpus->users[cursor.user].history.size()) {
+                ++cursor.user;
+                cursor.tx = 0;
+                continue;
+            }
+            test(cursor, found);
+            ++cursor.tx;
+        }
+        return false;
+    }
+
+    const std::string &query() const { return current; }
+    const UserView &user(const Hit &h) const { return corpus->users[h.user]; }
+    const TransactionView &transaction(const Hit &h) const { return corpus->users[h.user].history[h.tx]; }
+
+private:
+    // Порядок полей важен: вектор представлений освобождается раньше арены
+    struct Corpus {
+        UserArena arena{1 << 20};
+        std::pmr::vector<UserView> users{arena.resource()};
+        std::vector<std::string> names;
+    };
+
+    std::unique_ptr<Corpus> corpus;
+    std::string current;
+    bool started = false;
+    bool finished = false;
+    std::vector<Hit> inherited;     // кандидаты от прежнего запроса
+    std::size_t inheritedPos = 0;
+    std::vector<Hit> matches;       // найденное текущим запросом, в порядке корпуса
+    Hit cursor{0, 0};               // следующая непросмотренная операция корпуса
+
+    // Разбирает следующий файл; удаленный пользователь остается в корпусе пустым местом
+    bool parseNext() {
+        if (corpus->users.size() == corpus->names.size()) return false;
+        const auto &name = corpus->names[corpus->users.size()];
+        corpus->users.emplace_back();
+        UserScanner::parseFile(UserStorage::userPath(name), corpus->arena.resource(), corpus->users.back());
+        return true;
+    }
+
+    void test(const Hit &h, std::vector<Hit> &found) {
+        const auto &u = corpus->users[h.user];
+        const auto &t = u.history[h.tx];
+        auto has = [&](std::string_view s){ return s.find(current) != std::string_view::npos; };
+        if (current.empty() || has(u.username) || has(t.id) || has(t.fromAccount) || has(t.toCard) || has(t.note) || has(t.status) ||
+            has(t.cancelReason)) {
+            matches.push_back(h);
+            found.push_back(h);
+        }
+    }
+};
+
+}
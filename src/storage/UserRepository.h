@@ -0,0 +1,359 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include "UserStorage.h"
+
+namespace storage {
+
+using UserSnapshot = std::shared_ptr<const RegularUser>;
+
+static inline std::filesystem::path writeBehindPath() {
+    return std::filesystem::path("data/writebehind.txt");
+}
+
+// Счетчики записи файлов
+struct WriteStats {
+    std::uint64_t requested = 0;    // изменений, требовавших записи файла
+    std::uint64_t written = 0;      // фактически записанных файлов (повтор после сбоя — еще одна)
+    std::uint64_t coalesced = 0;    // изменений, поглощенных более поздними до записи
+    std::uint64_t flushes = 0;      // проходов отложенной записи
+    std::uint64_t failed = 0;       // неудачных записей (пользователь остается грязным)
+    long long maxLagMs = 0;         // наибольшая задержка от первого изменения до записи
+    std::size_t dirty = 0;          // ждут записи сейчас
+};
+
+// Живые пользователи процесса, общие для всех сессий (окна пользователя и администратора).
+// Чтение — атомарная загрузка указателя на неизменяемый снимок, без блокировок. Запись
+// копирует текущую версию, меняет копию, сохраняет файл и атомарно публикует новую
+// версию; старый снимок живет, пока его держит читатель. Писатели одного пользователя
+// упорядочены мьютексом его слота. Подписчики узнают об изменении после публикации.
+//
+// Отложенная запись (интервал в data/writebehind.txt, 0 — выключена, по умолчанию): update
+// только помечает пользователя грязным, фоновый поток раз в интервал пишет каждого грязного
+// один раз — последнюю версию, так что файл отстает не больше чем на интервал. flush() пишет
+// все немедленно и возвращается, когда записи на диске; его зовут при выходе из сессии,
+// перед обходами файлов пользователей и из деструктора хранилища.
+class UserRepository {
+public:
+    using Listener = std::function<void(const std::string &username)>;
+
+    static UserRepository &instance() {
+        static UserRepository repo;
+        return repo;
+    }
+
+    // Текущая версия; при первом обращении читается с диска. NotFoundError — нет пользователя
+    UserSnapshot get(const std::string &username) {
+        auto slot = slotOf(username);
+        if (auto snapshot = std::atomic_load(&slot->current)) return snapshot;
+        std::lock_guard<std::mutex> lock(slot->writer);
+        return loadLocked(*slot, username);
+    }
+
+    // Как get, но незагруженный пользователь читается с диска без закрепления в памяти —
+    // для обходов всех пользователей
+    UserSnapshot peek(const std::string &username) const {
+        auto all = std::atomic_load(&slotMap);
+        auto it = all->find(username);
+        if (it != all->end()) {
+            if (auto snapshot = std::atomic_load(&it->second->current)) return snapshot;
+        }
+        return std::make_shared<const RegularUser>(UserStorage::loadUser(username));
+    }
+
+    // Загружен ли пользователь в память (его снимки могут держать сессии)
+    bool cached(const std::string &username) const {
+        auto all = std::atomic_load(&slotMap);
+        auto it = all->find(username);
+        return it != all->end() && std::atomic_load(&it->second->current) != nullptr;
+    }
+
+    // fn(RegularUser &) меняет копию текущей версии; исключение из fn или из записи файла
+    // не публикует новую версию, но то, что fn успела сделать вне копии (проводки журнала),
+    // остается — такие действия должны переживать повтор (см. PostingLedger::postOnce).
+    // persist = false — только публикация, без записи файла; при отложенной записи файл
+    // пишет фоновый поток
+    template <typename F>
+    UserSnapshot update(const std::string &username, F &&fn, bool persist = true) {
+        auto slot = slotOf(username);
+        UserSnapshot published;
+        {
+            std::lock_guard<std::mutex> lock(slot->writer);
+            auto next = std::make_shared<RegularUser>(*loadLocked(*slot, username));
+            fn(*next);
+            bool deferred = persist && writeBehindEnabled();
+            if (persist && !deferred) UserStorage::saveUser(*next);
+            published = std::move(next);
+            std::atomic_store(&slot->current, published);
+            if (persist) countWrite(username, deferred);
+        }
+        notify(username);
+        return published;
+    }
+
+    // Файл изменен в обход хранилища (импорт): следующее чтение перечитает его. Отложенная
+    // версия сначала пишется — иначе изменение пропало бы вместе со снимком; если запись
+    // не удалась, пользователь остается загруженным и грязным до следующего flush
+    void evict(const std::string &username) {
+        auto slot = findSlot(username);
+        if (!slot) return;
+        {
+            std::lock_guard<std::mutex> lock(slot->writer);
+            Clock::time_point since;
+            if (takeDirty(username, since) && !save(username, *slot, since)) return;
+            std::atomic_store(&slot->current, UserSnapshot());
+        }
+        notify(username);
+    }
+
+    // Пользователь удален: выгрузка без записи и слот из справочника
+    void remove(const std::string &username) {
+        if (auto slot = findSlot(username)) {
+            {
+                std::lock_guard<std::mutex> lock(slot->writer);
+                Clock::time_point since;
+                takeDirty(username, since);
+                std::atomic_store(&slot->current, UserSnapshot());
+            }
+            notify(username);
+        }
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        auto all = std::atomic_load(&slotMap);
+        if (!all->count(username)) return;
+        auto copy = std::make_shared<SlotMap>(*all);
+        copy->erase(username);
+        std::atomic_store(&slotMap, std::shared_ptr<const SlotMap>(std::move(copy)));
+    }
+
+    void clear() {
+        auto all = std::atomic_load(&slotMap);
+        for (const auto &[name, slot] : *all) evict(name);
+    }
+
+    int subscribe(Listener listener) {
+        std::lock_guard<std::mutex> lock(listenersMutex);
+        listeners.emplace(++lastListener, std::move(listener));
+        return lastListener;
+    }
+
+    void unsubscribe(int id) {
+        std::lock_guard<std::mutex> lock(listenersMutex);
+        listeners.erase(id);
+    }
+
+    // interval == 0 — синхронная запись; перед выключением отложенной записи все пишется
+    void setWriteBehind(std::chrono::milliseconds interval) {
+        interval = std::max(interval, std::chrono::milliseconds(0));
+        {
+            std::filesystem::create_directories(writeBehindPath().parent_path());
+            std::ofstream ofs(writeBehindPath(), std::ios::trunc);
+            ofs << "interval_ms=" << interval.count() << "\n";
+        }
+        startFlusher(interval);
+    }
+
+    std::chrono::milliseconds writeBehind() const { return std::chrono::milliseconds(intervalMs.load()); }
+
+    void flush() {
+        std::lock_guard<std::mutex> serial(flushMutex);
+        std::unordered_map<std::string, Clock::time_point> batch;
+        {
+            std::lock_guard<std::mutex> lock(dirtyMutex);
+            if (dirty.empty()) return;
+            batch.swap(dirty);
+            ++stats.flushes;
+        }
+        auto all = std::atomic_load(&slotMap);
+        for (const auto &[name, since] : batch) {
+            auto it = all->find(name);
+            if (it == all->end()) continue;
+            // под мьютексом слота: выгрузка и удаление пользователя не пересекаются с записью
+            std::lock_guard<std::mutex> lock(it->second->writer);
+            save(name, *it->second, since);
+        }
+    }
+
+    WriteStats writeStats() {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        WriteStats out = stats;
+        out.dirty = dirty.size();
+        return out;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot {
+        UserSnapshot current;  // только через atomic_load/atomic_store
+        std::mutex writer;
+    };
+    using SlotMap = std::unordered_map<std::string, std::shared_ptr<Slot>>;
+
+    std::shared_ptr<const SlotMap> slotMap = std::make_shared<const SlotMap>();  // сам справочник — тоже снимок
+    std::mutex slotsMutex;
+    std::mutex listenersMutex;
+    std::unordered_map<int, Listener> listeners;
+    int lastListener = 0;
+
+    std::mutex dirtyMutex;
+    std::unordered_map<std::string, Clock::time_point> dirty;  // пользователь -> первое незаписанное изменение
+    WriteStats stats;
+    std::mutex flushMutex;
+    std::atomic<long long> intervalMs{0};
+    std::mutex flusherMutex;
+    std::condition_variable flusherWake;
+    bool flusherStop = false;
+    std::thread flusher;
+
+    UserRepository() {
+        UserStorage::retainIndex();
+        long long interval = 0;
+        std::ifstream ifs(writeBehindPath());
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (line.rfind("interval_ms=", 0) != 0) continue;
+            try {
+                interval = std::stoll(line.substr(12));
+            } catch (...) {
+            }
+        }
+        if (interval > 0) startFlusher(std::chrono::milliseconds(interval));
+    }
+
+    // Поток останавливается, оставшиеся грязные пользователи пишутся здесь же: индекс
+    // UserStorage создан в конструкторе раньше хранилища и еще жив
+    ~UserRepository() {
+        stopFlusher();
+        flush();
+    }
+
+    bool writeBehindEnabled() const { return intervalMs.load() > 0; }
+
+    void countWrite(const std::string &username, bool deferred) {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        ++stats.requested;
+        if (!deferred) ++stats.written;
+        else if (!dirty.emplace(username, Clock::now()).second) ++stats.coalesced;
+    }
+
+    bool takeDirty(const std::string &username, Clock::time_point &since) {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        auto it = dirty.find(username);
+        if (it == dirty.end()) return false;
+        since = it->second;
+        dirty.erase(it);
+        return true;
+    }
+
+    // Пишет текущую версию под мьютексом слота; при сбое пользователь снова грязный
+    bool save(const std::string &username, Slot &slot, Clock::time_point since) {
+        auto snapshot = std::atomic_load(&slot.current);
+        if (!snapshot) return true;
+        bool ok = true;
+        try {
+            UserStorage::saveUser(*snapshot);
+        } catch (...) {
+            ok = false;
+        }
+        long long lag = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - since).count();
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        if (ok) {
+            ++stats.written;
+            stats.maxLagMs = std::max(stats.maxLagMs, lag);
+        } else {
+            ++stats.failed;
+            // более позднее изменение уже ждет записи: эта запишется вместе с ним
+            if (!dirty.emplace(username, since).second) ++stats.coalesced;
+        }
+        return ok;
+    }
+
+    void startFlusher(std::chrono::milliseconds interval) {
+        stopFlusher();
+        intervalMs = interval.count();
+        if (interval.count() == 0) {
+            flush();
+            return;
+        }
+        flusherStop = false;
+        flusher = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(flusherMutex);
+            while (!flusherStop) {
+                if (flusherWake.wait_for(lock, std::chrono::milliseconds(intervalMs.load()), [this]() { return flusherStop; })) break;
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+        });
+    }
+
+    void stopFlusher() {
+        if (!flusher.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(flusherMutex);
+            flusherStop = true;
+        }
+        flusherWake.notify_all();
+        flusher.join();
+    }
+
+    std::shared_ptr<Slot> findSlot(const std::string &username) const {
+        auto all = std::atomic_load(&slotMap);
+        auto it = all->find(username);
+        return it != all->end() ? it->second : nullptr;
+    }
+
+    // Слот существующего пользователя. Без слота пользователь сначала читается с диска:
+    // NotFoundError вылетает до вставки, и несуществующие имена справочник не засоряют
+    std::shared_ptr<Slot> slotOf(const std::string &username) {
+        if (auto slot = findSlot(username)) return slot;
+        UserSnapshot loaded = std::make_shared<const RegularUser>(UserStorage::loadUser(username));
+        auto slot = slotFor(username);
+        std::lock_guard<std::mutex> lock(slot->writer);
+        if (!std::atomic_load(&slot->current)) std::atomic_store(&slot->current, loaded);
+        return slot;
+    }
+
+    std::shared_ptr<Slot> slotFor(const std::string &username) {
+        if (auto slot = findSlot(username)) return slot;
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        auto all = std::atomic_load(&slotMap);
+        auto it = all->find(username);
+        if (it != all->end()) return it->second;
+        auto copy = std::make_shared<SlotMap>(*all);
+        auto slot = std::make_shared<Slot>();
+        copy->emplace(username, slot);
+        std::atomic_store(&slotMap, std::shared_ptr<const SlotMap>(std::move(copy)));
+        return slot;
+    }
+
+    UserSnapshot loadLocked(Slot &slot, const std::string &username) {
+        if (auto snapshot = std::atomic_load(&slot.current)) return snapshot;
+        UserSnapshot snapshot = std::make_shared<const RegularUser>(UserStorage::loadUser(username));
+        std::atomic_store(&slot.current, snapshot);
+        return snapshot;
+    }
+
+    void notify(const std::string &username) {
+        std::vector<Listener> copy;
+        {
+            std::lock_guard<std::mutex> lock(listenersMutex);
+            for (const auto &[id, listener] : listeners) copy.push_back(listener);
+        }
+        for (const auto &listener : copy) listener(username);
+    }
+};
+
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <filesystem>
+#include <fstream>
+#include <cstddef>
+#include <charconv>
+#include <algorithm>
+#include "../models/Schema.h"
+#include "BalanceTable.h"
+
+namespace storage {
+
+// Арена для массовых просмотров: всё, что разобрано в ней, освобождается разом.
+class UserArena {
+public:
+    explicit UserArena(std::size_t initialBytes = 1 << 16)
+        : resourceValue(initialBytes) {}
+
+    std::pmr::memory_resource *resource() { return &resourceValue; }
+    void release() { resourceValue.release(); }
+
+private:
+    std::pmr::monotonic_buffer_resource resourceValue;
+};
+
+// Представления моделей только для чтения. Строки — string_view в текст файла,
+// скопированный в арену; поля ';' -> ',' раскодируются на месте.
+struct AccountView {
+    std::string_view accountNumber;
+    std::string_view currency;
+    long long balanceCents = 0;
+};
+
+struct CardView {
+    std::string_view cardNumber;
+    std::string_view holderName;
+    std::string_view expiry;
+    std::string_view linkedAccount;
+};
+
+struct TransactionView {
+    std::string_view id;
+    std::string_view fromAccount;
+    std::string_view toCard;
+    long long cents = 0;
+    long long timestamp = 0;
+    std::string_view note;
+    std::string_view category = "other";
+    std::string_view status = "completed";
+    std::string_view cancelReason;
+    long long rate = 0;
+    long long creditedCents = 0;
+};
+
+struct FavoriteView {
+    std::string_view name;
+    std::string_view toCard;
+    std::string_view note;
+};
+
+// Разделы файла пользователя для выборочного разбора
+enum UserSection : unsigned {
+    SectionNone = 0,
+    SectionAccounts = 1u << 0,
+    SectionCards = 1u << 1,
+    SectionHistory = 1u << 2,
+    SectionFavorites = 1u << 3,
+    SectionAll = SectionAccounts | SectionCards | SectionHistory | SectionFavorites,
+};
+
+// Число записей в разделах файла — известно и для разделов, которые не разбирались
+struct SectionSizes {
+    std::size_t accounts = 0;
+    std::size_t cards = 0;
+    std::size_t history = 0;
+    std::size_t favorites = 0;
+};
+
+struct UserView {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    std::string_view username;
+    std::string_view passwordHash;
+    std::pmr::vector<AccountView> accounts;
+    std::pmr::vector<CardView> cards;
+    std::pmr::vector<TransactionView> history;
+    std::pmr::vector<FavoriteView> favorites;
+    std::size_t notifications = 0;  // устаревшие уведомления в файле пользователя
+    SectionSizes sizes;
+
+    explicit UserView(const allocator_type &alloc = {})
+        : accounts(alloc), cards(alloc), history(alloc), favorites(alloc) {}
+    UserView(const UserView &other, const allocator_type &alloc)
+        : username(other.username), passwordHash(other.passwordHash), accounts(other.accounts, alloc), cards(other.cards, alloc),
+          history(other.history, alloc), favorites(other.favorites, alloc), notifications(other.notifications), sizes(other.sizes) {}
+    UserView(UserView &&other, const allocator_type &alloc)
+        : username(other.username), passwordHash(other.passwordHash), accounts(std::move(other.accounts), alloc), cards(std::move(other.cards), alloc),
+          history(std::move(other.history), alloc), favorites(std::move(other.favorites), alloc), notifications(other.notifications),
+          sizes(other.sizes) {}
+    UserView(const UserView &) = default;
+    UserView(UserView &&) = default;
+    UserView &operator=(const UserView &) = default;
+    UserView &operator=(UserView &&) = default;
+};
+
+}
+
+template <>
+struct Schema<storage::AccountView> {
+    static constexpr auto fields = std::make_tuple(
+        field("accountNumber", &storage::AccountView::accountNumber),
+        field("currency", &storage::AccountView::currency),
+        field("balanceCents", &storage::AccountView::balanceCents));
+};
+
+template <>
+struct Schema<storage::CardView> {
+    static constexpr auto fields = std::make_tuple(
+        field("cardNumber", &storage::CardView::cardNumber),
+        field("holderName", &storage::CardView::holderName),
+        field("expiry", &storage::CardView::expiry),
+        field("linkedAccount", &storage::CardView::linkedAccount));
+};
+
+template <>
+struct Schema<storage::TransactionView> {
+    static constexpr bool escapeCommas = true;
+    static constexpr auto fields = std::make_tuple(
+        field("id", &storage::TransactionView::id),
+        field("fromAccount", &storage::TransactionView::fromAccount),
+        field("toCard", &storage::TransactionView::toCard),
+        field("cents", &storage::TransactionView::cents),
+        field("timestamp", &storage::TransactionView::timestamp),
+        field("note", &storage::TransactionView::note),
+        field("category", &storage::TransactionView::category, "other"),
+        field("status", &storage::TransactionView::status, "completed"),
+        field("cancelReason", &storage::TransactionView::cancelReason),
+        field("rate", &storage::TransactionView::rate),
+        field("creditedCents", &storage::TransactionView::creditedCents));
+};
+
+template <>
+struct Schema<storage::FavoriteView> {
+    static constexpr auto fields = std::make_tuple(
+        field("name", &storage::FavoriteView::name),
+        field("toCard", &storage::FavoriteView::toCard),
+        field("note", &storage::FavoriteView::note));
+};
+
+namespace storage {
+
+// Разбор файла пользователя (формат RegularUser::operator<<) прямо в арену:
+// один буфер на файл, без отдельной строки на каждое поле.
+class UserScanner {
+public:
+    // sections — какие разделы разбирать в представления; остальные только пропускаются
+    static bool parseFile(const std::filesystem::path &path, std::pmr::memory_resource *arena, UserView &out,
+                          unsigned sections = SectionAll) {
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (!ifs) return false;
+        auto size = static_cast<std::size_t>(ifs.tellg());
+        char *buffer = static_cast<char *>(arena->allocate(size + 1, 1));
+        ifs.seekg(0);
+        ifs.read(buffer, static_cast<std::streamsize>(size));
+        buffer[size] = '\n';
+        parse(buffer, size, out, sections);
+        BalanceTable::instance().overlay(out.accounts);
+        return true;
+    }
+
+    static void parse(char *data, std::size_t size, UserView &u, unsigned sections = SectionAll) {
+        Cursor c{data, data + size};
+        u.username = c.line();
+        u.passwordHash = c.line();
+
+        u.sizes.accounts = readAll(c, u.accounts, sections & SectionAccounts);
+        u.sizes.cards = readAll(c, u.cards, sections & SectionCards);
+        u.sizes.history = readAll(c, u.history, sections & SectionHistory);
+        u.sizes.favorites = readAll(c, u.favorites, sections & SectionFavorites);
+        u.notifications = c.count();
+    }
+
+private:
+    struct Cursor {
+        char *pos;
+        char *end;
+
+        bool done() const { return pos >= end; }
+
+        std::string_view line() {
+            if (pos >= end) return {};
+            char *start = pos;
+            char *nl = std::find(pos, end, '\n');
+            pos = nl + 1;
+            return std::string_view(start, static_cast<std::size_t>(nl - start));
+        }
+
+        std::size_t count() { return static_cast<std::size_t>(std::max(0LL, toNumber(line()))); }
+    };
+
+    // Возвращает число записей раздела; keep == false — строки пропускаются без разбора
+    template <typename T>
+    static std::size_t readAll(Cursor &c, std::pmr::vector<T> &out, bool keep) {
+        std::size_t n = c.count();
+        if (keep) out.reserve(n);
+        for (std::size_t i = 0; i < n && !c.done(); ++i) {
+            auto line = c.line();
+            if (!keep) continue;
+            T item;
+            schema::readView(const_cast<char *>(line.data()), line.size(), item);
+            out.push_back(item);
+        }
+        return n;
+    }
+
+    static long long toNumber(std::string_view s) {
+        long long value = 0;
+        std::from_chars(s.data(), s.data() + s.size(), value);
+        return value;
+    }
+};
+
+}
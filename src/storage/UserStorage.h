@@ -6,9 +6,18 @@
 #include <fstream>
 #include <optional>
 #include <algorithm>
+#include <mutex>
+#include <cstdint>
+#include <unordered_set>
+#include <thread>
+#include <type_traits>
+#include <atomic>
 #include "../models/User.h"
 #include "../utils/Exceptions.h"
 #include "../utils/Utils.h"
+#include "UsernameIndex.h"
+#include "UserScan.h"
+#include "BalanceTable.h"
 
 namespace storage {
 
@@ -25,56 +34,313 @@ void writeVector(std::ostream &os, const TContainer &container, TItemWriter writ
     }
 }
 
+// Файлы пользователей разложены по 256 подкаталогам users/<xx>/<name>.txt,
+// список имен ведется в users/manifest.txt (дописывается при регистрации).
+// Листинг и проверка существования идут по манифесту в памяти, каталог не перечисляется.
+// Старая плоская раскладка users/<name>.txt переносится при первом обращении.
 class UserStorage {
 public:
     static void ensureDataDirs() {
         std::filesystem::create_directories(usersRoot());
     }
 
+    // Создает индекс заранее: одиночка, вызвавшая это в конструкторе, разрушается раньше
+    // индекса и может писать файлы пользователей из своего деструктора
+    static void retainIndex() { index(); }
+
+    static std::filesystem::path userPath(const std::string &username) {
+        return usersRoot() / bucketOf(username) / (username + ".txt");
+    }
+
     static void saveUser(const RegularUser &user) {
-        ensureDataDirs();
-        auto path = usersRoot() / (user.usernameValue + ".txt");
-        std::ofstream ofs(path);
-        if (!ofs) throw BankingError("Cannot write user file: " + path.string());
-        ofs << user;
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        auto path = userPath(user.usernameValue);
+        std::filesystem::create_directories(path.parent_path());
+        // через временный файл: сбой посреди записи не оставляет обрезанного пользователя
+        auto tmp = path;
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (ofs) ofs << user;
+            if (!ofs) throw BankingError("Cannot write user file: " + path.string());
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) throw BankingError("Cannot write user file: " + path.string());
+        if (idx.members.insert(user.usernameValue).second) {
+            auto pos = std::lower_bound(idx.sorted.begin(), idx.sorted.end(), user.usernameValue);
+            idx.sorted.insert(pos, user.usernameValue);
+            std::ofstream manifest(manifestPath(), std::ios::app);
+            if (!manifest) throw BankingError("Cannot write manifest: " + manifestPath().string());
+            manifest << user.usernameValue << "\n";
+            if (idx.searchBuilt) idx.search.add(user.usernameValue);
+        }
+    }
+
+    // Пакетная запись (импорт): файлы пишутся параллельно, манифест — один раз в конце
+    static void saveUsers(const std::vector<RegularUser> &users, unsigned threads = 0) {
+        auto &idx = index();
+        {
+            std::lock_guard<std::mutex> lock(idx.mutex);
+            ensureIndex(idx);
+        }
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(users.size(), 1)));
+        std::atomic<std::size_t> nextUser{0};
+        std::mutex errorMutex;
+        std::string firstError;
+        auto worker = [&]() {
+            for (std::size_t i = nextUser++; i < users.size(); i = nextUser++) {
+                auto path = userPath(users[i].usernameValue);
+                std::error_code ec;
+                std::filesystem::create_directories(path.parent_path(), ec);
+                auto tmp = path;
+                tmp += ".tmp";
+                bool ok = false;
+                {
+                    std::ofstream ofs(tmp, std::ios::trunc);
+                    if (ofs) ofs << users[i];
+                    ok = static_cast<bool>(ofs);
+                }
+                if (ok) std::filesystem::rename(tmp, path, ec);
+                if (!ok || ec) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (firstError.empty()) firstError = "Cannot write user file: " + path.string();
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool) t.join();
+
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        bool added = false;
+        for (const auto &u : users) {
+            if (!idx.members.insert(u.usernameValue).second) continue;
+            idx.sorted.push_back(u.usernameValue);
+            added = true;
+        }
+        if (added) {
+            std::sort(idx.sorted.begin(), idx.sorted.end());
+            writeManifest(idx);
+            if (idx.searchBuilt) idx.search.build(idx.sorted);  // одна пересборка вместо вставок по одному
+        }
+        if (!firstError.empty()) throw BankingError(firstError);
+    }
+
+    static void removeUser(const std::string &username) {
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        if (!idx.members.erase(username)) throw NotFoundError("User not found: " + username);
+        std::filesystem::remove(userPath(username));
+        auto pos = std::lower_bound(idx.sorted.begin(), idx.sorted.end(), username);
+        if (pos != idx.sorted.end() && *pos == username) idx.sorted.erase(pos);
+        if (idx.searchBuilt) idx.search.remove(username);
+        writeManifest(idx);
+    }
+
+    // Поиск по подстроке с ранжированием (см. UsernameIndex); индекс строится при первом запросе
+    static UsernameIndex::Page searchUsernames(const std::string &query, std::size_t offset, std::size_t limit) {
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        if (!idx.searchBuilt) {
+            idx.search.build(idx.sorted);
+            idx.searchBuilt = true;
+        }
+        return idx.search.search(query, offset, limit);
     }
 
     static RegularUser loadUser(const std::string &username) {
-        auto path = usersRoot() / (username + ".txt");
+        {
+            auto &idx = index();
+            std::lock_guard<std::mutex> lock(idx.mutex);
+            ensureIndex(idx);
+        }
+        auto path = userPath(username);
         std::ifstream ifs(path);
         if (!ifs) throw NotFoundError("User not found: " + username);
         RegularUser u;
         ifs >> u;
+        BalanceTable::instance().overlay(u.accounts);
         return u;
     }
 
     static bool exists(const std::string &username) {
-        auto path = usersRoot() / (username + ".txt");
-        return std::filesystem::exists(path);
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        return idx.members.count(username) > 0;
     }
 
     static std::vector<std::string> listUsernames() {
-        ensureDataDirs();
-        std::vector<std::string> names;
-        for (auto &entry : std::filesystem::directory_iterator(usersRoot())) {
-            if (!entry.is_regular_file()) continue;
-            auto name = entry.path().stem().string();
-            names.push_back(name);
-        }
-        std::sort(names.begin(), names.end());
-        return names;
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        return idx.sorted;
     }
 
-    static std::vector<RegularUser> loadAll() {
-        std::vector<RegularUser> out;
+    static std::size_t userCount() {
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        ensureIndex(idx);
+        return idx.sorted.size();
+    }
+
+    // Потоковый обход: пользователи разбираются по одному в общую арену, которая освобождается
+    // после каждого visit, так что память ограничена самым большим файлом, а не всей базой.
+    // visit(const UserView &) может вернуть false — обход прекращается (тогда и результат false).
+    // sections — разбираемые разделы; размеры остальных есть в UserView::sizes
+    template <typename F>
+    static bool forEachUser(F &&visit, unsigned sections = SectionAll) {
+        UserArena arena;
         for (const auto &name : listUsernames()) {
-            try {
-                out.push_back(loadUser(name));
-            } catch (...) {
+            bool more = true;
+            {
+                UserView u(arena.resource());
+                if (UserScanner::parseFile(userPath(name), arena.resource(), u, sections)) more = keepGoing(visit, u);
             }
+            arena.release();
+            if (!more) return false;
+        }
+        return true;
+    }
+
+    // visit(const UserView &, const TransactionView &) по всем операциям; из прочих разделов
+    // разбираются только перечисленные в sections
+    template <typename F>
+    static bool forEachTransaction(F &&visit, unsigned sections = SectionNone) {
+        return forEachUser([&](const UserView &u) {
+            for (const auto &t : u.history) {
+                if (!keepGoing(visit, u, t)) return false;
+            }
+            return true;
+        }, sections | SectionHistory);
+    }
+
+    // Массовый просмотр без копий в куче: все пользователи разбираются в арену вызывающего
+    // и освобождаются вместе с ней. Для чтения; изменения — через loadUser/saveUser.
+    static std::pmr::vector<UserView> scanAll(UserArena &arena) {
+        auto names = listUsernames();
+        std::pmr::vector<UserView> out(arena.resource());
+        out.reserve(names.size());
+        for (const auto &name : names) {
+            out.emplace_back();
+            if (!UserScanner::parseFile(userPath(name), arena.resource(), out.back())) out.pop_back();
         }
         return out;
     }
+
+    static void clearAll() {
+        auto &idx = index();
+        std::lock_guard<std::mutex> lock(idx.mutex);
+        auto root = usersRoot();
+        if (std::filesystem::exists(root)) {
+            for (auto &entry : std::filesystem::directory_iterator(root)) {
+                std::filesystem::remove_all(entry.path());
+            }
+        }
+        idx.sorted.clear();
+        idx.members.clear();
+        idx.search.clear();
+        idx.searchBuilt = false;
+        idx.loaded = false;
+    }
+
+    static std::string bucketOf(const std::string &username) {
+        std::uint32_t h = 2166136261u;
+        for (unsigned char ch : username) {
+            h ^= ch;
+            h *= 16777619u;
+        }
+        static const char *hex = "0123456789abcdef";
+        return std::string{hex[(h >> 4) & 0xF], hex[h & 0xF]};
+    }
+
+private:
+    template <typename F, typename... Args>
+    static bool keepGoing(F &visit, const Args &...args) {
+        if constexpr (std::is_void_v<std::invoke_result_t<F &, const Args &...>>) {
+            visit(args...);
+            return true;
+        } else {
+            return static_cast<bool>(visit(args...));
+        }
+    }
+
+    struct Index {
+        std::mutex mutex;
+        bool loaded = false;
+        std::vector<std::string> sorted;
+        std::unordered_set<std::string> members;
+        UsernameIndex search;
+        bool searchBuilt = false;
+    };
+
+    static Index &index() {
+        static Index idx;
+        return idx;
+    }
+
+    static std::filesystem::path manifestPath() {
+        return usersRoot() / "manifest.txt";
+    }
+
+    static void ensureIndex(Index &idx) {
+        if (idx.loaded) return;
+        ensureDataDirs();
+        idx.sorted.clear();
+        idx.members.clear();
+        bool haveManifest = std::filesystem::exists(manifestPath());
+        if (haveManifest) {
+            std::ifstream ifs(manifestPath());
+            std::string line;
+            while (std::getline(ifs, line)) {
+                if (!line.empty() && idx.members.insert(line).second) idx.sorted.push_back(line);
+            }
+        }
+
+        // перенос плоской раскладки; без манифеста — одноразовая пересборка по подкаталогам
+        bool rewrite = !haveManifest;
+        std::vector<std::filesystem::path> flat;
+        for (auto &entry : std::filesystem::directory_iterator(usersRoot())) {
+            if (entry.is_regular_file() && entry.path().extension() == ".txt" && entry.path().filename() != "manifest.txt") {
+                flat.push_back(entry.path());
+            } else if (!haveManifest && entry.is_directory()) {
+                for (auto &file : std::filesystem::directory_iterator(entry.path())) {
+                    if (!file.is_regular_file() || file.path().extension() != ".txt") continue;
+                    auto name = file.path().stem().string();
+                    if (idx.members.insert(name).second) idx.sorted.push_back(name);
+                }
+            }
+        }
+        for (const auto &path : flat) {
+            auto name = path.stem().string();
+            auto target = usersRoot() / bucketOf(name) / (name + ".txt");
+            std::filesystem::create_directories(target.parent_path());
+            std::filesystem::rename(path, target);
+            if (idx.members.insert(name).second) idx.sorted.push_back(name);
+            rewrite = true;
+        }
+        std::sort(idx.sorted.begin(), idx.sorted.end());
+        if (rewrite) writeManifest(idx);
+        idx.loaded = true;
+    }
+
+    static void writeManifest(const Index &idx) {
+        auto tmp = manifestPath();
+        tmp += ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::trunc);
+            if (!ofs) throw BankingError("Cannot write manifest: " + manifestPath().string());
+            for (const auto &name : idx.sorted) ofs << name << "\n";
+        }
+        std::filesystem::rename(tmp, manifestPath());
+    }
 };
 
 }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+namespace storage {
+
+// Индекс имен пользователей: отсортированный массив всех суффиксов.
+// Подстрока q — это префикс какого-то суффикса, поэтому поиск сводится
+// к lower_bound и проходу по совпавшему диапазону.
+class UsernameIndex {
+public:
+    struct Page {
+        std::vector<std::string> names;
+        std::size_t total = 0;
+    };
+
+    void build(const std::vector<std::string> &all) {
+        clear();
+        std::size_t total = 0;
+        for (const auto &name : all) {
+            if (name.empty() || ids.count(name)) continue;
+            assign(name);
+            total += name.size();
+        }
+        suffixes.reserve(total);
+        for (std::uint32_t id = 0; id < names.size(); ++id) {
+            for (std::uint32_t off = 0; off < names[id].size(); ++off) suffixes.push_back({id, off});
+        }
+        std::sort(suffixes.begin(), suffixes.end(), [this](const Entry &a, const Entry &b){ return view(a) < view(b); });
+    }
+
+    void add(const std::string &name) {
+        if (name.empty() || ids.count(name)) return;
+        std::uint32_t id = assign(name);
+        for (std::uint32_t off = 0; off < name.size(); ++off) {
+            Entry e{id, off};
+            auto pos = std::lower_bound(suffixes.begin(), suffixes.end(), e, [this](const Entry &a, const Entry &b){ return view(a) < view(b); });
+            suffixes.insert(pos, e);
+        }
+    }
+
+    void remove(const std::string &name) {
+        auto it = ids.find(name);
+        if (it == ids.end()) return;
+        std::uint32_t id = it->second;
+        suffixes.erase(std::remove_if(suffixes.begin(), suffixes.end(), [id](const Entry &e){ return e.id == id; }), suffixes.end());
+        names[id].clear();
+        freeIds.push_back(id);
+        ids.erase(it);
+    }
+
+    void clear() {
+        names.clear();
+        freeIds.clear();
+        ids.clear();
+        suffixes.clear();
+    }
+
+    // Порядок: точное совпадение, затем совпадение с начала имени, затем подстрока; внутри — по алфавиту
+    Page search(const std::string &query, std::size_t offset, std::size_t limit) const {
+        Page page;
+        std::vector<std::pair<int, std::uint32_t>> hits;
+        if (query.empty()) {
+            for (const auto &[name, id] : ids) hits.push_back({1, id});
+        } else {
+            // стоимость пропорциональна числу совпавших суффиксов, а не размеру индекса
+            std::vector<std::pair<std::uint32_t, int>> matched;
+            auto lo = std::lower_bound(suffixes.begin(), suffixes.end(), std::string_view(query),
+                                       [this](const Entry &e, std::string_view q){ return view(e) < q; });
+            for (auto it = lo; it != suffixes.end(); ++it) {
+                auto suffix = view(*it);
+                if (suffix.compare(0, query.size(), query) != 0) break;
+                int r = it->offset == 0 ? (suffix.size() == query.size() ? 0 : 1) : 2;
+                matched.push_back({it->id, r});
+            }
+            std::sort(matched.begin(), matched.end());
+            for (std::size_t i = 0; i < matched.size(); ++i) {
+                if (i > 0 && matched[i].first == matched[i - 1].first) continue;
+                hits.push_back({matched[i].second, matched[i].first});
+            }
+        }
+        page.total = hits.size();
+        if (offset >= hits.size()) return page;
+        auto less = [this](const std::pair<int, std::uint32_t> &a, const std::pair<int, std::uint32_t> &b){
+            if (a.first != b.first) return a.first < b.first;
+            return names[a.second] < names[b.second];
+        };
+        std::size_t end = std::min(hits.size(), offset + limit);
+        std::partial_sort(hits.begin(), hits.begin() + static_cast<std::ptrdiff_t>(end), hits.end(), less);
+        for (std::size_t i = offset; i < end; ++i) page.names.push_back(names[hits[i].second]);
+        return page;
+    }
+
+    std::size_t size() const { return ids.size(); }
+
+private:
+    struct Entry {
+        std::uint32_t id;
+        std::uint32_t offset;
+    };
+
+    std::vector<std::string> names;
+    std::vector<std::uint32_t> freeIds;
+    std::unordered_map<std::string, std::uint32_t> ids;
+    std::vector<Entry> suffixes;
+
+    std::string_view view(const Entry &e) const {
+        return std::string_view(names[e.id]).substr(e.offset);
+    }
+
+    std::uint32_t assign(const std::string &name) {
+        std::uint32_t id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+            names[id] = name;
+        } else {
+            id = static_cast<std::uint32_t>(names.size());
+            names.push_back(name);
+        }
+        ids.emplace(name, id);
+        return id;
+    }
+};
+
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "../models/Transaction.h"
+#include "../utils/Exceptions.h"
+#include "../utils/Utils.h"
+
+namespace storage {
+
+static inline std::filesystem::path limitsPath() {
+    return std::filesystem::path("data/limits.txt");
+}
+
+static inline std::filesystem::path flaggedPath() {
+    return std::filesystem::path("data/flagged.txt");
+}
+
+// Скользящее окно из kBuckets корзин: при сдвиге обнуляются только
+// устаревшие корзины, итоги по окну поддерживаются инкрементально.
+class SlidingWindow {
+public:
+    static constexpr std::int64_t kBuckets = 60;
+
+    explicit SlidingWindow(std::int64_t windowSeconds = 60)
+        : width(std::max<std::int64_t>(windowSeconds / kBuckets, 1)) {}
+
+    void add(std::int64_t now, std::int64_t cents) {
+        advance(now);
+        auto slot = static_cast<std::size_t>(lastEpoch % kBuckets);
+        ++counts[slot];
+        sums[slot] += cents;
+        ++totalCount;
+        totalSum += cents;
+    }
+
+    std::int64_t count(std::int64_t now) { advance(now); return totalCount; }
+    std::int64_t sum(std::int64_t now) { advance(now); return totalSum; }
+
+private:
+    std::int64_t width;
+    std::int64_t lastEpoch = -1;
+    std::array<std::int64_t, kBuckets> counts{};
+    std::array<std::int64_t, kBuckets> sums{};
+    std::int64_t totalCount = 0;
+    std::int64_t totalSum = 0;
+
+    void advance(std::int64_t now) {
+        std::int64_t epoch = now / width;
+        if (lastEpoch < 0) { lastEpoch = epoch; return; }
+        if (epoch <= lastEpoch) return;
+        std::int64_t steps = std::min(epoch - lastEpoch, kBuckets);
+        for (std::int64_t i = 1; i <= steps; ++i) {
+            auto slot = static_cast<std::size_t>((lastEpoch + i) % kBuckets);
+            totalCount -= counts[slot];
+            totalSum -= sums[slot];
+            counts[slot] = 0;
+            sums[slot] = 0;
+        }
+        lastEpoch = epoch;
+    }
+};
+
+struct FlaggedTransfer {
+    std::time_t timestamp = 0;
+    std::string transactionId;
+    std::string username;
+    std::string fromAccount;
+    std::string toCard;
+    long long cents = 0;
+    std::string code;
+};
+
+struct VelocityVerdict {
+    std::vector<std::string> flags;  // коды сработавших правил с действием flag
+};
+
+// Правила из data/limits.txt, строка: <scope>.<metric>.<window>=<limit> [reject|flag]
+//   scope: account (исходящие со счета) или recipient (входящие на карту/счет)
+//   metric: count или cents; window: minute, hour, day или число секунд
+//   new_recipient.cents=<limit> — порог первого перевода новому получателю
+// Проверка стоит O(числа правил) и не просматривает историю.
+class VelocityRules {
+public:
+    static VelocityRules &instance() {
+        static VelocityRules rules;
+        return rules;
+    }
+
+    // Однократно для счета: окна заполняются недавними переводами из истории,
+    // а известные получатели — всеми прошлыми адресатами
+    void prime(const std::string &account, const std::vector<Transaction> &history) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        if (!primed.insert(account).second) return;
+        auto now = static_cast<std::int64_t>(std::time(nullptr));
+        auto &seen = knownRecipients[account];
+        for (const auto &t : history) {
+            if (t.fromAccount != account || t.status == "cancelled") continue;
+            seen.insert(t.toCard);
+            for (std::size_t i = 0; i < rules.size(); ++i) {
+                if (rules[i].scope != Scope::Account) continue;
+                if (now - static_cast<std::int64_t>(t.timestamp) >= rules[i].window) continue;
+                window(i, account).add(static_cast<std::int64_t>(t.timestamp), t.cents);
+            }
+        }
+    }
+
+    // Бросает LimitExceededError для правил reject; правила flag возвращаются в вердикте
+    VelocityVerdict check(const std::string &account, const std::string &recipient, long long cents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        auto now = static_cast<std::int64_t>(std::time(nullptr));
+        VelocityVerdict verdict;
+        for (std::size_t i = 0; i < rules.size(); ++i) {
+            const auto &rule = rules[i];
+            bool hit = false;
+            if (rule.scope == Scope::NewRecipient) {
+                hit = cents > rule.limit && !knownRecipients[account].count(recipient);
+            } else {
+                auto &w = window(i, rule.scope == Scope::Account ? account : recipient);
+                hit = rule.countMetric ? w.count(now) + 1 > rule.limit : w.sum(now) + cents > rule.limit;
+            }
+            if (!hit) continue;
+            if (rule.reject) throw LimitExceededError(rule.code, "Превышен лимит операций (" + rule.code + ")");
+            verdict.flags.push_back(rule.code);
+        }
+        return verdict;
+    }
+
+    void record(const std::string &account, const std::string &recipient, long long cents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureLoaded();
+        auto now = static_cast<std::int64_t>(std::time(nullptr));
+        for (std::size_t i = 0; i < rules.size(); ++i) {
+            if (rules[i].scope == Scope::NewRecipient) continue;
+            window(i, rules[i].scope == Scope::Account ? account : recipient).add(now, cents);
+        }
+        knownRecipients[account].insert(recipient);
+    }
+
+    void flag(const Transaction &t, const std::string &username, const std::vector<std::string> &codes) {
+        if (codes.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::filesystem::create_directories(flaggedPath().parent_path());
+        std::ofstream ofs(flaggedPath(), std::ios::app);
+        for (const auto &code : codes) {
+            ofs << t.timestamp << "," << t.id << "," << username << "," << t.fromAccount << "," << t.toCard << "," << t.cents << "," << code << "\n";
+        }
+    }
+
+    std::vector<FlaggedTransfer> flagged() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<FlaggedTransfer> out;
+        std::ifstream ifs(flaggedPath());
+        std::string line;
+        while (std::getline(ifs, line)) {
+            std::stringstream ss(line);
+            FlaggedTransfer f;
+            std::string ts, cents;
+            if (!std::getline(ss, ts, ',') || !std::getline(ss, f.transactionId, ',') || !std::getline(ss, f.username, ',')
+                || !std::getline(ss, f.fromAccount, ',') || !std::getline(ss, f.toCard, ',') || !std::getline(ss, cents, ',')) continue;
+            std::getline(ss, f.code);
+            try {
+                f.timestamp = static_cast<std::time_t>(std::stoll(ts));
+                f.cents = std::stoll(cents);
+            } catch (...) {
+                continue;
+            }
+            out.push_back(std::move(f));
+        }
+        return out;
+    }
+
+    // Удаление пользователя: окна и известные получатели его счетов
+    void forget(const std::vector<std::string> &accounts) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &account : accounts) {
+            primed.erase(account);
+            knownRecipients.erase(account);
+            for (auto &byKey : windows) byKey.erase(account);
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::error_code ec;
+        std::filesystem::remove(flaggedPath(), ec);
+        loaded = false;
+    }
+
+    void reload() {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded = false;
+        ensureLoaded();
+    }
+
+private:
+    enum class Scope { Account, Recipient, NewRecipient };
+
+    struct Rule {
+        std::string code;
+        Scope scope = Scope::Account;
+        bool countMetric = true;
+        std::int64_t window = 60;
+        long long limit = 0;
+        bool reject = true;
+    };
+
+    std::mutex mutex;
+    bool loaded = false;
+    std::vector<Rule> rules;
+    std::vector<std::unordered_map<std::string, SlidingWindow>> windows;  // по индексу правила
+    std::unordered_map<std::string, std::unordered_set<std::string>> knownRecipients;
+    std::unordered_set<std::string> primed;
+
+    VelocityRules() = default;
+
+    SlidingWindow &window(std::size_t rule, const std::string &key) {
+        auto &byKey = windows[rule];
+        auto it = byKey.find(key);
+        if (it == byKey.end()) it = byKey.emplace(key, SlidingWindow(rules[rule].window)).first;
+        return it->second;
+    }
+
+    static std::int64_t windowSeconds(const std::string &name) {
+        if (name == "minute") return 60;
+        if (name == "hour") return 3600;
+        if (name == "day") return 86400;
+        return std::stoll(name);
+    }
+
+    void ensureLoaded() {
+        if (loaded) return;
+        loaded = true;
+        rules.clear();
+        windows.clear();
+        primed.clear();
+        knownRecipients.clear();
+        // Правила по умолчанию только помечают переводы; отклонять — решение оператора
+        // (заменить flag на reject в файле)
+        if (!std::filesystem::exists(limitsPath())) {
+            std::filesystem::create_directories(limitsPath().parent_path());
+            std::ofstream ofs(limitsPath());
+            ofs << "account.count.minute=10 flag\n"
+                << "account.cents.day=50000000 flag\n"
+                << "recipient.count.hour=30 flag\n"
+                << "new_recipient.cents=1000000 flag\n";
+        }
+        std::ifstream ifs(limitsPath());
+        std::string line;
+        while (std::getline(ifs, line)) {
+            line = utils::trim(line);
+            auto eq = line.find('=');
+            if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+            try {
+                Rule rule;
+                rule.code = utils::trim(line.substr(0, eq));
+                std::istringstream value(line.substr(eq + 1));
+                std::string action;
+                value >> rule.limit >> action;
+                rule.reject = action != "flag";
+                std::vector<std::string> parts;
+                std::stringstream key(rule.code);
+                for (std::string part; std::getline(key, part, '.');) parts.push_back(part);
+                if (parts.size() == 2 && parts[0] == "new_recipient") {
+                    rule.scope = Scope::NewRecipient;
+                } else if (parts.size() == 3 && (parts[0] == "account" || parts[0] == "recipient")) {
+                    rule.scope = parts[0] == "account" ? Scope::Account : Scope::Recipient;
+                    rule.countMetric = parts[1] == "count";
+                    rule.window = windowSeconds(parts[2]);
+                } else {
+                    continue;
+                }
+                rules.push_back(rule);
+            } catch (...) {
+                // пропускаем битую строку
+            }
+        }
+        windows.resize(rules.size());
+    }
+};
+
+}
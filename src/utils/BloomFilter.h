@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+namespace utils {
+
+// Фильтр Блума: ложноположительные ответы возможны, ложноотрицательные — нет.
+class BloomFilter {
+public:
+    explicit BloomFilter(std::size_t expectedItems = 1024, std::size_t bitsPerItem = 10, std::size_t hashes = 7)
+        : bits(std::max<std::size_t>(expectedItems * bitsPerItem, 1024), false), hashCount(hashes) {}
+
+    void add(const std::string &key) {
+        auto [h1, h2] = hashPair(key);
+        for (std::size_t i = 0; i < hashCount; ++i) bits[(h1 + i * h2) % bits.size()] = true;
+        ++itemCount;
+    }
+
+    bool mayContain(const std::string &key) const {
+        auto [h1, h2] = hashPair(key);
+        for (std::size_t i = 0; i < hashCount; ++i) {
+            if (!bits[(h1 + i * h2) % bits.size()]) return false;
+        }
+        return true;
+    }
+
+    std::size_t size() const { return itemCount; }
+    std::size_t capacityBits() const { return bits.size(); }
+
+private:
+    std::vector<bool> bits;
+    std::size_t hashCount;
+    std::size_t itemCount = 0;
+
+    static std::pair<std::uint64_t, std::uint64_t> hashPair(const std::string &key) {
+        std::uint64_t h1 = std::hash<std::string>{}(key);
+        // второй хеш — FNV-1a, нечетный шаг для двойного хеширования
+        std::uint64_t h2 = 1469598103934665603ULL;
+        for (unsigned char ch : key) {
+            h2 ^= ch;
+            h2 *= 1099511628211ULL;
+        }
+        return {h1, h2 | 1};
+    }
+};
+
+}
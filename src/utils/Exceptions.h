@@ -29,4 +29,13 @@ public:
     explicit CardExpiredError(const std::string &message) : BankingError(message) {}
 };
 
+class LimitExceededError : public BankingError {
+public:
+    LimitExceededError(const std::string &code, const std::string &message) : BankingError(message), reasonCode(code) {}
+    const std::string &code() const { return reasonCode; }
+
+private:
+    std::string reasonCode;
+};
+
 
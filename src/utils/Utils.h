@@ -4,6 +4,7 @@
 #include <random>
 #include <sstream>
 #include <iomanip>
+#include <stdexcept>
 
 namespace utils {
 
@@ -25,6 +26,22 @@ inline std::string trim(const std::string &s) {
     return s.substr(start, end - start + 1);
 }
 
+// Умножение на дробь num/den с округлением до ближайшего (половина — от нуля).
+// Разложение a = q*den + r не дает переполниться промежуточному произведению.
+inline long long mulDivRound(long long value, long long num, long long den) {
+    if (den <= 0) throw std::invalid_argument("mulDivRound: den must be positive");
+    bool negative = (value < 0) != (num < 0);
+    unsigned long long a = static_cast<unsigned long long>(value < 0 ? -value : value);
+    unsigned long long b = static_cast<unsigned long long>(num < 0 ? -num : num);
+    unsigned long long d = static_cast<unsigned long long>(den);
+    unsigned long long q = a / d, r = a % d;
+    unsigned long long whole = q * b + (r * b) / d;
+    unsigned long long rem = (r * b) % d;
+    if (rem * 2 >= d) ++whole;
+    long long out = static_cast<long long>(whole);
+    return negative ? -out : out;
+}
+
 inline std::string weakHash(const std::string &input) {
     std::hash<std::string> hasher;
     auto h = hasher(input);